@@ -8,8 +8,12 @@
 #ifndef BACKEND_ASYNC_WRITER_HPP_
 #define BACKEND_ASYNC_WRITER_HPP_
 
+#include <errno.h>
+
 #include <mutex>
+#include <atomic>
 #include <memory>
+#include <deque>
 #include <unordered_map>
 #include <vector>
 #include <functional>
@@ -20,6 +24,7 @@
 
 struct AsyncData {
 	std::function<void(void)> callback;
+	std::function<void(int e_code)> fail; //线程池停止时仍未执行，以 ESHUTDOWN 调用
 };
 
 class AsyncWriter: public std::enable_shared_from_this<AsyncWriter> {
@@ -27,8 +32,10 @@ private:
 	mtsafe::thread_safe_queue_sync<std::shared_ptr<AsyncData> > * pAsyncDatas { NULL };
 	std::string prefix;
 	std::shared_ptr<ThreadTimer> oThreadTimer;
+	std::function<void(void)> fDone; //每完成一项后调用，放行等待的数据
 public:
-	AsyncWriter(mtsafe::thread_safe_queue_sync<std::shared_ptr<AsyncData> > * pAsyncDatas_, const std::string & prefix_);
+	AsyncWriter(mtsafe::thread_safe_queue_sync<std::shared_ptr<AsyncData> > * pAsyncDatas_, const std::string & prefix_,
+			const std::function<void(void)> & fDone_);
 
 	void Start();
 
@@ -37,6 +44,11 @@ public:
 	void notify_one();
 };
 
+/**
+ * 后端异步写入队列，队列中（含正在执行）的数据不超过 max_pending
+ * 超过时数据暂存在等待列表，Put 立即返回，不阻塞调用线程，每完成一项放行一项
+ * Stop 时队列和等待列表中未执行的数据调用 fail(ESHUTDOWN)，没有 fail 的在停止线程中执行
+ */
 class AsyncWriters {
 private:
 	int workers_ { 1 };
@@ -45,18 +57,50 @@ private:
 	std::mutex mtx;
 	bool f_terminated { false };
 
+	size_t max_pending { 1024 };
+	size_t nPending { 0 }; //队列中和正在执行的数据数，mtx 保护
+	std::deque<std::shared_ptr<AsyncData> > oWaitings; //等待放行的数据，mtx 保护
+
 	mtsafe::thread_safe_queue_sync<std::shared_ptr<AsyncData> > oAsyncDatas;
 	std::vector<std::shared_ptr<AsyncWriter> > oAsyncWriters;
+protected:
+	void Done();
+
 public:
+	std::atomic<uint64_t> nParked { 0 }; //进入等待列表的次数
+	std::atomic<uint64_t> nShutdowns { 0 }; //停止时未执行的数据数
+	std::atomic<uint64_t> nCompleted { 0 }; //已执行完成的数据数
 
 	void Start();
 
 	void Stop();
 
+	/**
+	 * nowait == true 为同步调用，放在队列顶端，不受 max_pending 限制
+	 * 已停止返回 false
+	 */
 	bool Put(const std::shared_ptr<AsyncData> & oAsyncData, bool nowait);
 
 	void notify_one();
 
+	void setMaxPending(size_t max_pending_) {
+		max_pending = std::max<size_t>(1, max_pending_);
+	}
+
+	size_t getPending() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return nPending;
+	}
+
+	size_t getWaiting() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return oWaitings.size();
+	}
+
+	int getWorkers() const {
+		return workers_;
+	}
+
 	void setWorkers(int workers) {
 		workers_ = std::max<int>(1, workers);
 		workers_ = std::min<int>(64, workers_);
@@ -72,11 +116,16 @@ inline void AsyncWriters::Start() {
 		return;
 	}
 	f_started = true;
-	f_terminated = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		f_terminated = false;
+	}
 	LOGGER_TRACE("#" << __LINE__ << ", AsyncWriters::Start, " << prefix << ", Backend Workers: " << workers_);
 
 	for (int i = 0; i < workers_; i++) {
-		std::shared_ptr<AsyncWriter> aWriter = std::make_shared<AsyncWriter>(&oAsyncDatas, prefix);
+		std::shared_ptr<AsyncWriter> aWriter = std::make_shared<AsyncWriter>(&oAsyncDatas, prefix, [ this ]() {
+			this->Done();
+		});
 		oAsyncWriters.push_back(aWriter);
 	}
 
@@ -90,38 +139,96 @@ inline void AsyncWriters::Stop() {
 		return;
 	}
 	f_started = false;
-	f_terminated = true;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		f_terminated = true;
+	}
 	LOGGER_TRACE("#" << __LINE__ << ", AsyncWriters::Stop, " << prefix << ", Backend Workers: " << workers_);
 
 	for (const std::shared_ptr<AsyncWriter> & aWriter : oAsyncWriters) {
 		aWriter->Stop();
 	}
 	oAsyncWriters.clear();
-}
 
-inline bool AsyncWriters::Put(const std::shared_ptr<AsyncData>& oAsyncData, bool nowait) {
-	if (f_terminated == true) {
-		return false;
+	/**
+	 * 写入线程已退出，队列中的先于等待列表中的
+	 */
+	std::deque<std::shared_ptr<AsyncData> > oDropped;
+	std::shared_ptr<AsyncData> oAsyncData;
+	while (oAsyncDatas.pop_front(oAsyncData) == true) {
+		oDropped.push_back(oAsyncData);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		oDropped.insert(oDropped.end(), oWaitings.begin(), oWaitings.end());
+		oWaitings.clear();
+		nPending = 0;
+	}
+
+	if (oDropped.empty() == false) {
+		LOGGER_WARN("#" << __LINE__ << ", AsyncWriters::Stop, " << prefix << ", Not executed: " << oDropped.size());
 	}
-	size_t nitems = 0;
-	if (nowait == false) { //异步模式，按先后顺序执行，置于底部
-		nitems = oAsyncDatas.push_back(oAsyncData);
-	} else { //同步调用，放在任务顶端
-		nitems = oAsyncDatas.push_front(oAsyncData);
+
+	for (const std::shared_ptr<AsyncData> & oDroppedData : oDropped) {
+		nShutdowns++;
+		if (oDroppedData->fail != nullptr) {
+			oDroppedData->fail(ESHUTDOWN);
+		} else if (oDroppedData->callback != nullptr) {
+			oDroppedData->callback();
+		}
 	}
+}
+
+inline bool AsyncWriters::Put(const std::shared_ptr<AsyncData>& oAsyncData, bool nowait) {
+	{
+		/**
+		 * 和 Stop 的清空互斥，停止后不再进入队列
+		 */
+		std::lock_guard<std::mutex> lock(mtx);
+		if (f_terminated == true) {
+			return false;
+		}
+
+		if (nowait == false && nPending >= max_pending) {
+			/**
+			 * 待刷新的数据过多，暂存等待，写入线程完成一项后放行
+			 */
+			oWaitings.push_back(oAsyncData);
+			nParked++;
+			return true;
+		}
+		nPending++;
 
-	int nms = nitems / 10; //待刷新的数据过多，需要降低 put 速度，以方便 flush 线程持久化写入
-	if (nms > 0) {
-		//slow down put
-		LOGGER_TRACE(
-				"#" << __LINE__ << ", AsyncWriters::Put, "<< prefix << ", " << nitems << " items, Slow down " << nms << " ms")
-		std::this_thread::sleep_for(std::chrono::milliseconds(nms));
+		if (nowait == false) { //异步模式，按先后顺序执行，置于底部
+			oAsyncDatas.push_back(oAsyncData);
+		} else { //同步调用，放在任务顶端
+			oAsyncDatas.push_front(oAsyncData);
+		}
 	}
 
 	notify_one();
 	return true;
 }
 
+inline void AsyncWriters::Done() {
+	nCompleted++;
+
+	std::shared_ptr<AsyncData> oAsyncData;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (oWaitings.empty() == true) {
+			nPending--;
+			return;
+		}
+		oAsyncData = oWaitings.front();
+		oWaitings.pop_front();
+	}
+
+	oAsyncDatas.push_back(oAsyncData);
+	notify_one();
+}
+
 inline void AsyncWriters::notify_one() {
 	for (auto & aWriter : oAsyncWriters) {
 		aWriter->notify_one();
@@ -129,8 +236,8 @@ inline void AsyncWriters::notify_one() {
 }
 
 inline AsyncWriter::AsyncWriter(mtsafe::thread_safe_queue_sync<std::shared_ptr<AsyncData> > * pAsyncDatas_,
-		const std::string & prefix_) :
-		pAsyncDatas(pAsyncDatas_), prefix(prefix_) {
+		const std::string & prefix_, const std::function<void(void)> & fDone_) :
+		pAsyncDatas(pAsyncDatas_), prefix(prefix_), fDone(fDone_) {
 }
 
 inline void AsyncWriter::Start() {
@@ -152,11 +259,13 @@ inline void AsyncWriter::Start() {
 				break;
 			}
 
-			if( oAsyncData->callback == nullptr ) {
-				continue;
+			if( oAsyncData->callback != nullptr ) {
+				oAsyncData->callback( );
 			}
 
-			oAsyncData->callback( );
+			if( fDone != nullptr ) {
+				fDone( );
+			}
 		}
 
 		return true;
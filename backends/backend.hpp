@@ -8,16 +8,25 @@
 #ifndef BACKEND_HPP_
 #define BACKEND_HPP_
 
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 #include <stdexcept>
 #include <string>
+#include <map>
 #include <memory>
+#include <atomic>
+#include <algorithm>
+#include <functional>
 
 #include <databox/cpl_debug.h>
 #include <databox/cpl_conf.hpp>
 
+#include <async_writer.hpp>
+
 //#define STATIC_BACKEND_PLUGINS
 
 class BackendFactory;
@@ -32,6 +41,11 @@ public:
 	std::string message;
 	int code { 0 };
 
+	/**
+	 * 异步读写完成回调，bytes < 0 时 code 和 message 为错误信息
+	 */
+	typedef std::function<void(int bytes, int code, const std::string & message)> IOCallback;
+
 	virtual ~Backend() {
 	}
 
@@ -39,7 +53,51 @@ public:
 
 	virtual int Write(void * buffer, size_t size, off_t offset) = 0;
 
-//	virtual int Flush() = 0;
+	/**
+	 * 同 Read/Write，失败时错误码写入 e_code，不经过多个请求共用的 code 和 message
+	 * 默认调用 Read/Write 后读取 code，并发调用时可能读到其他请求的错误，后端线程中并发读写的后端应重载
+	 */
+	virtual int Read(void * buffer, size_t size, off_t offset, int & e_code) {
+		int bytes = Read(buffer, size, offset);
+		e_code = bytes < 0 ? (code == 0 ? EIO : code) : 0;
+		return bytes;
+	}
+
+	virtual int Write(void * buffer, size_t size, off_t offset, int & e_code) {
+		int bytes = Write(buffer, size, offset);
+		e_code = bytes < 0 ? (code == 0 ? EIO : code) : 0;
+		return bytes;
+	}
+
+	/**
+	 * 异步读取，callback 在后端线程中调用，回调前调用者需保持 Backend 和 buffer 有效
+	 * 默认把同步 Read 交给工厂的后端线程池执行，不占用网络线程
+	 */
+	virtual void ReadAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	/**
+	 * 异步写入，要求同 ReadAsync
+	 */
+	virtual void WriteAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	/**
+	 * 读写缓存要求的对齐字节数，0 为不要求（如 O_DIRECT 的本地后端）
+	 */
+	virtual size_t getAlignment() const {
+		return 0;
+	}
+
+	/**
+	 * 分配按 alignment 对齐的读写缓存，失败时返回空
+	 */
+	static std::shared_ptr<char> AllocBuffer(size_t size, size_t alignment);
+
+	/**
+	 * 已写入的数据落盘，默认后端写入返回时已经持久，直接返回 true
+	 */
+	virtual bool Flush() {
+		return true;
+	}
 
 	virtual bool isValid(bool create_if_not_exists) = 0;
 
@@ -65,15 +123,28 @@ private:
 	std::string prefix;
 	bool bReadOnly { false };
 
+	uint32_t nNegativeTtl { 2 }; //否定缓存有效时间，秒，0 为关闭
+	uint32_t nNegativeSize { 64 * 1024 }; //否定缓存最大条目数
+
+	uint32_t nFlushConcurrency { 4 }; //一个文件刷新脏块时同时进行的后端写入数
+	uint32_t nQueueLimit { 32 }; //该前缀所有文件同时进行的刷新写入数，超过后排队等待，0 为不限制
+
+	uint32_t nWorkers { 4 }; //后端线程数，执行阻塞的后端调用，与网络服务线程分开配置
+	uint32_t nWorkerQueueLimit { 1024 }; //后端线程池中排队和执行的调用数，超过后暂存等待，不阻塞提交线程
+
+	std::atomic<bool> bStarted { false };
+	std::atomic<bool> bStopped { false }; //已停止，不再同步执行提交的调用
+	AsyncWriters oAsyncWriters; //该前缀的后端线程池
+
 public:
 	virtual ~BackendFactory() {
 	}
 
 	virtual std::shared_ptr<Backend> Open(const std::string & filename) = 0;
 
-	void Start();
+	virtual void Start();
 
-	void Stop();
+	virtual void Stop();
 
 	std::string Prefix() {
 		return prefix;
@@ -91,12 +162,88 @@ public:
 	bool isReadOnly() const {
 		return bReadOnly;
 	}
+
+	uint32_t getNegativeTtl() const {
+		return nNegativeTtl;
+	}
+
+	uint32_t getNegativeSize() const {
+		return nNegativeSize;
+	}
+
+	uint32_t getFlushConcurrency() const {
+		return nFlushConcurrency;
+	}
+
+	uint32_t getQueueLimit() const {
+		return nQueueLimit;
+	}
+
+	uint32_t getWorkers() const {
+		return nWorkers;
+	}
+
+	uint32_t getWorkerQueueLimit() const {
+		return nWorkerQueueLimit;
+	}
+
+	AsyncWriters & getWorkerPool() {
+		return oAsyncWriters;
+	}
+
+	/**
+	 * 在后端线程池中执行，超过 worker_queue_limit 时暂存等待，完成一项放行一项
+	 * 线程池未启动时返回 false，由调用者同步执行
+	 * 已停止或停止时仍未执行的调用 fail(ESHUTDOWN)，没有 fail 时返回 false 或在停止线程中执行
+	 */
+	bool Submit(const std::function<void(void)> & callback, const std::function<void(int e_code)> & fail = nullptr);
+
+	/**
+	 * 插件自己的计数器，加入状态汇报
+	 */
+	virtual void GetMetrics(std::map<std::string, uint64_t> & metrics) {
+	}
 };
 
 inline void BackendFactory::Start() {
+	if (bStarted.exchange(true) == true) {
+		return;
+	}
+
+	oAsyncWriters.setPrefix(prefix);
+	oAsyncWriters.setWorkers(nWorkers);
+	oAsyncWriters.setMaxPending(nWorkerQueueLimit);
+	bStopped = false;
+	oAsyncWriters.Start();
 }
 
 inline void BackendFactory::Stop() {
+	if (bStarted.exchange(false) == false) {
+		return;
+	}
+
+	bStopped = true;
+	oAsyncWriters.Stop();
+}
+
+inline bool BackendFactory::Submit(const std::function<void(void)> & callback,
+		const std::function<void(int e_code)> & fail) {
+	if (bStarted == false && bStopped == false) {
+		return false;
+	}
+
+	std::shared_ptr<AsyncData> oAsyncData = std::make_shared<AsyncData>();
+	oAsyncData->callback = callback;
+	oAsyncData->fail = fail;
+	if (oAsyncWriters.Put(oAsyncData, false) == true) {
+		return true;
+	}
+
+	if (fail == nullptr) {
+		return false;
+	}
+	fail(ESHUTDOWN);
+	return true;
 }
 
 inline void BackendFactory::Load(const ConfReader& cr) {
@@ -107,6 +254,65 @@ inline void BackendFactory::Load(const ConfReader& cr) {
 	}
 
 	bReadOnly = cr.get_int("readonly", 0) != 0;
+
+	nNegativeTtl = cr.get_int("negative_ttl", nNegativeTtl);
+	nNegativeSize = cr.get_int("negative_size", nNegativeSize);
+
+	nFlushConcurrency = std::max<int>(1, cr.get_int("flush_concurrency", nFlushConcurrency));
+	nQueueLimit = std::max<int>(0, cr.get_int("queue_limit", nQueueLimit));
+	nWorkers = std::max<int>(1, cr.get_int("workers", nWorkers));
+	nWorkerQueueLimit = std::max<int>(1, cr.get_int("worker_queue_limit", nWorkerQueueLimit));
+}
+
+inline std::shared_ptr<char> Backend::AllocBuffer(size_t size, size_t alignment) {
+	void * ptr = NULL;
+	if (alignment > 0) {
+		if (posix_memalign(&ptr, alignment, size) != 0) {
+			ptr = NULL;
+		}
+	} else {
+		ptr = malloc(size);
+	}
+
+	if (ptr == NULL) {
+		return std::shared_ptr<char>();
+	}
+	return std::shared_ptr<char>((char *) ptr, free);
+}
+
+/**
+ * 后端线程池未启动时在调用线程中同步执行，已停止时以 ESHUTDOWN 回调，不在网络线程中执行
+ */
+inline void Backend::ReadAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback) {
+	const auto & fRead = [ this, buffer, size, offset, callback ]() {
+		int e_code = 0;
+		int bytes = this->Read( buffer, size, offset, e_code );
+		callback( bytes, bytes < 0 ? e_code : 0, bytes < 0 ? strerror( e_code ) : std::string() );
+	};
+
+	const auto & fFail = [ callback ]( int e_code ) {
+		callback( -1, e_code, strerror( e_code ) );
+	};
+
+	if (oBackendFactory.get() == NULL || oBackendFactory->Submit(fRead, fFail) == false) {
+		fRead();
+	}
+}
+
+inline void Backend::WriteAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback) {
+	const auto & fWrite = [ this, buffer, size, offset, callback ]() {
+		int e_code = 0;
+		int bytes = this->Write( buffer, size, offset, e_code );
+		callback( bytes, bytes < 0 ? e_code : 0, bytes < 0 ? strerror( e_code ) : std::string() );
+	};
+
+	const auto & fFail = [ callback ]( int e_code ) {
+		callback( -1, e_code, strerror( e_code ) );
+	};
+
+	if (oBackendFactory.get() == NULL || oBackendFactory->Submit(fWrite, fFail) == false) {
+		fWrite();
+	}
 }
 
 #endif /* BACKEND_HPP_ */
@@ -11,38 +11,79 @@
 #include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 #include <string>
 #include <memory>
 #include <atomic>
+#include <mutex>
 
 #include <backend.hpp>
 
+#include "local_uring.hpp"
+
 #include <databox/cpl_debug.h>
 #include <databox/cpl_conf.hpp>
 #include <databox/filesystemutils.hpp>
 
+class LocalUring;
+
 class LocalBackend: public Backend {
 private:
 	int fd { -1 };
+	int slot { -1 }; //fd 在 io_uring 固定文件表中的序号
+
+	std::shared_ptr<LocalUring> oUring; //io_uring 引擎，为空时使用后端线程池
 
-	std::atomic<int> iOpenWrite { 0 };
-	std::atomic<int> iOpenFlag { 0 };
+	size_t nDirectAlign { 0 }; //O_DIRECT 对齐字节数，0 为不使用 O_DIRECT
+	std::mutex mtx_direct; //O_DIRECT 下同一文件的写入串行
+
+	/**
+	 * 打开一次：并发的 Open 在 mtx_open 上等待第一个完成，fd 打开后不再改变
+	 */
+	std::mutex mtx_open;
+	std::atomic<bool> bOpened { false };
+	bool bOpenTried { false }; //mtx_open 保护
+	bool bCreateTried { false }; //已经以 O_CREAT 尝试过，mtx_open 保护
+	int nOpenError { 0 }; //打开失败的错误码，EMFILE/ENFILE/EINTR 不记录，mtx_open 保护
 
 	std::string root;
 	std::string filename;
 
 protected:
+	/**
+	 * 失败时返回 false 和 e_code
+	 */
+	bool Open(bool create_if_not_exists, int & e_code);
+
+	/**
+	 * 同上，错误写入 code 和 message
+	 */
 	bool Open(bool create_if_not_exists);
 
 	std::string Normalize(const std::string & rel_path);
 
+	bool IsAligned(const void * buffer, size_t size, off_t offset) const;
+
+	/**
+	 * 读写已打开的 fd，O_DIRECT 下处理不对齐的缓存、位置和长度，失败时返回 -1 和 e_code
+	 */
+	int PRead(void * buffer, size_t size, off_t offset, int & e_code);
+
+	int PWrite(void * buffer, size_t size, off_t offset, int & e_code);
+
+	/**
+	 * 路径在 root 之下且不含 .. 和 ~
+	 */
+	bool IsSafePath(const std::string & abs_path) const;
+
 	bool Validate(const std::string & abs_path);
 
 public:
-	LocalBackend(const std::string & root, const std::string & filename);
+	LocalBackend(const std::string & root, const std::string & filename, const std::shared_ptr<LocalUring> & oUring,
+			size_t direct_align);
 
 	~LocalBackend();
 
@@ -50,6 +91,19 @@ public:
 
 	int Write(void * buffer, size_t size, off_t offset);
 
+	int Read(void * buffer, size_t size, off_t offset, int & e_code);
+
+	int Write(void * buffer, size_t size, off_t offset, int & e_code);
+
+	void ReadAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	void WriteAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	/**
+	 * fdatasync 已打开的 fd，O_DIRECT 不保证落盘
+	 */
+	bool Flush();
+
 	bool Truncate(const std::string& filename, off_t length);
 
 	bool Unlink(const std::string& filename);
@@ -63,16 +117,35 @@ public:
 	bool isValid(bool create_if_not_exists) {
 		return Open(create_if_not_exists) == true;
 	}
+
+	size_t getAlignment() const {
+		return nDirectAlign;
+	}
 };
 
 class LocalBackendFactory: public BackendFactory {
 private:
 	std::string root { "/tmp" };
+
+	/**
+	 * 异步读写引擎: sync 为后端线程池中的 pread/pwrite，uring 为 io_uring（需要 HAVE_LIBURING 编译）
+	 */
+	std::string engine { "sync" };
+	uint32_t nUringDepth { 256 };
+	uint32_t nUringFiles { 1024 };
+
+	std::shared_ptr<LocalUring> oUring;
+
+	size_t nDirectAlign { 0 }; //direct = 1 时为 direct_align，打开文件使用 O_DIRECT
 public:
 	LocalBackendFactory(const std::string & conf);
 
 	std::shared_ptr<Backend> Open(const std::string & filename);
 
+	void Start();
+
+	void Stop();
+
 };
 
 #include "local_backend.inc"
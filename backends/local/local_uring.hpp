@@ -0,0 +1,423 @@
+/*
+ * local_uring.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#ifndef LOCAL_URING_HPP_
+#define LOCAL_URING_HPP_
+
+#ifdef HAVE_LIBURING
+
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <liburing.h>
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
+
+#include <backend.hpp>
+
+#include <databox/cpl_debug.h>
+
+/**
+ * 一次 io_uring 读写请求，写入不完整时继续提交剩余部分
+ */
+struct LocalUringRequest {
+	bool write { false };
+	int fd { -1 };
+	int slot { -1 }; //注册文件序号，-1 为未注册，直接使用 fd
+	char * buffer { NULL };
+	size_t size { 0 };
+	off_t offset { 0 };
+	size_t done { 0 }; //已完成字节数
+	Backend::IOCallback callback;
+};
+
+/**
+ * 本地后端的 io_uring 引擎，一个前缀一个环和一个收割线程
+ *
+ * 提交线程只把请求放入等待列表，列表由空变为非空时写 eventfd 唤醒收割线程；
+ * 收割线程把等待的请求一次性填入 SQ，与上一轮的完成一起通过一次 io_uring_enter 批量提交和等待。
+ * 文件描述符注册到固定文件表，读写使用 IOSQE_FIXED_FILE，表满时退回普通 fd
+ */
+class LocalUring {
+private:
+	struct io_uring ring;
+	bool bInited { false };
+
+	uint32_t nDepth { 256 };
+	uint32_t nFiles { 1024 };
+
+	int wake_fd { -1 };
+
+	std::mutex mtx;
+	std::deque<LocalUringRequest *> oPendings; //等待提交的请求，mtx 保护
+	bool bTerminated { false }; //mtx 保护
+
+	std::mutex mtx_files;
+	std::vector<int> oFreeSlots; //空闲的注册文件序号，mtx_files 保护
+
+	std::thread oReaper;
+	uint32_t nInflight { 0 }; //已提交未完成的读写，只在收割线程中使用
+	bool bWakeArmed { false }; //eventfd 的 POLL 已经提交，只在收割线程中使用
+	uint32_t nErrors { 0 }; //连续提交失败次数，只在收割线程中使用
+
+	static const uint32_t MAX_SUBMIT_ERRORS = 8; //连续失败达到该次数后，等待提交的请求直接返回失败
+	static const uint32_t MAX_SUBMIT_BACKOFF_MS = 100; //提交失败后的最大退避时间
+
+protected:
+	void Run();
+
+	/**
+	 * 把等待的请求填入 SQ，SQ 满时剩余请求留到下一轮
+	 */
+	void Prepare();
+
+	void Complete(struct io_uring_cqe * cqe);
+
+	/**
+	 * 收割完成队列中已有的完成，返回收割数
+	 */
+	unsigned Reap();
+
+	/**
+	 * 提交持续失败时，让等待列表中尚未进入 SQ 的请求返回失败
+	 */
+	void FailPendings(int e_code);
+
+	bool PrepareOne(LocalUringRequest * request);
+
+public:
+	std::atomic<uint64_t> nSubmits { 0 }; //io_uring_enter 提交次数
+	std::atomic<uint64_t> nRequests { 0 }; //提交的读写数
+
+	LocalUring(uint32_t depth, uint32_t files) :
+			nDepth(depth), nFiles(files) {
+	}
+
+	~LocalUring() {
+		Stop();
+	}
+
+	bool Start();
+
+	void Stop();
+
+	/**
+	 * 注册文件描述符，返回注册序号，表满或失败时返回 -1
+	 */
+	int RegisterFile(int fd);
+
+	void UnregisterFile(int slot);
+
+	/**
+	 * 提交读写，callback 在收割线程中调用，buffer 在回调前必须保持有效
+	 */
+	void Submit(bool write, int fd, int slot, void * buffer, size_t size, off_t offset,
+			const Backend::IOCallback & callback);
+};
+
+inline bool LocalUring::Start() {
+	if (bInited == true) {
+		return true;
+	}
+
+	int state = io_uring_queue_init(nDepth, &ring, 0);
+	if (state < 0) {
+		LOGGER_WARN("#" << __LINE__ << ", LocalUring::Start, io_uring_queue_init, Error: " << strerror(-state));
+		return false;
+	}
+
+	/**
+	 * 先注册全部为空的文件表，打开文件时再逐个更新
+	 */
+	std::vector<int> fds(nFiles, -1);
+	if (nFiles > 0 && io_uring_register_files(&ring, &fds[0], nFiles) == 0) {
+		for (int slot = nFiles - 1; slot >= 0; slot--) {
+			oFreeSlots.push_back(slot);
+		}
+	} else {
+		LOGGER_WARN("#" << __LINE__ << ", LocalUring::Start, io_uring_register_files, Disabled");
+	}
+
+	wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (wake_fd < 0) {
+		LOGGER_WARN("#" << __LINE__ << ", LocalUring::Start, eventfd, Error: " << strerror(errno));
+		io_uring_queue_exit(&ring);
+		return false;
+	}
+
+	bInited = true;
+	bTerminated = false;
+	oReaper = std::thread([ this ]() {
+		this->Run();
+	});
+
+	LOGGER_INFO("#" << __LINE__ << ", LocalUring::Start, Depth: " << nDepth << ", Files: " << oFreeSlots.size());
+	return true;
+}
+
+inline void LocalUring::Stop() {
+	if (bInited == false) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		bTerminated = true;
+	}
+
+	uint64_t value = 1;
+	if (write(wake_fd, &value, sizeof(value)) < 0) {
+		LOGGER_WARN("#" << __LINE__ << ", LocalUring::Stop, eventfd, Error: " << strerror(errno));
+	}
+
+	if (oReaper.joinable() == true) {
+		oReaper.join();
+	}
+
+	io_uring_queue_exit(&ring);
+	close(wake_fd);
+	wake_fd = -1;
+	bInited = false;
+
+	LOGGER_INFO("#" << __LINE__ << ", LocalUring::Stop, Submits: " << nSubmits << ", Requests: " << nRequests);
+}
+
+inline int LocalUring::RegisterFile(int fd) {
+	int slot = -1;
+	{
+		std::lock_guard<std::mutex> lock(mtx_files);
+		if (oFreeSlots.empty() == true) {
+			return -1;
+		}
+		slot = oFreeSlots.back();
+		oFreeSlots.pop_back();
+	}
+
+	if (io_uring_register_files_update(&ring, slot, &fd, 1) != 1) {
+		std::lock_guard<std::mutex> lock(mtx_files);
+		oFreeSlots.push_back(slot);
+		return -1;
+	}
+	return slot;
+}
+
+inline void LocalUring::UnregisterFile(int slot) {
+	if (slot < 0) {
+		return;
+	}
+
+	int fd = -1;
+	io_uring_register_files_update(&ring, slot, &fd, 1);
+
+	std::lock_guard<std::mutex> lock(mtx_files);
+	oFreeSlots.push_back(slot);
+}
+
+inline void LocalUring::Submit(bool write, int fd, int slot, void * buffer, size_t size, off_t offset,
+		const Backend::IOCallback & callback) {
+
+	LocalUringRequest * request = new LocalUringRequest();
+	request->write = write;
+	request->fd = fd;
+	request->slot = slot;
+	request->buffer = (char *) buffer;
+	request->size = size;
+	request->offset = offset;
+	request->callback = callback;
+
+	bool bWake = false;
+	bool bTerminate = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		bTerminate = bTerminated;
+		if (bTerminate == false) {
+			bWake = oPendings.empty();
+			oPendings.push_back(request);
+		}
+	}
+
+	if (bTerminate == true) {
+		delete request;
+		callback(-1, ESHUTDOWN, strerror(ESHUTDOWN));
+		return;
+	}
+
+	/**
+	 * 只在列表由空变为非空时唤醒，之后到达的请求在同一轮中批量提交
+	 */
+	if (bWake == true) {
+		uint64_t value = 1;
+		if (::write(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+			LOGGER_WARN("#" << __LINE__ << ", LocalUring::Submit, eventfd, Error: " << strerror(errno));
+		}
+	}
+}
+
+inline bool LocalUring::PrepareOne(LocalUringRequest * request) {
+	struct io_uring_sqe * sqe = io_uring_get_sqe(&ring);
+	if (sqe == NULL) {
+		return false;
+	}
+
+	int fd = request->slot >= 0 ? request->slot : request->fd;
+	char * buffer = request->buffer + request->done;
+	size_t size = request->size - request->done;
+	off_t offset = request->offset + request->done;
+
+	if (request->write == true) {
+		io_uring_prep_write(sqe, fd, buffer, size, offset);
+	} else {
+		io_uring_prep_read(sqe, fd, buffer, size, offset);
+	}
+
+	if (request->slot >= 0) {
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+
+	io_uring_sqe_set_data(sqe, request);
+	nInflight++;
+	nRequests++;
+	return true;
+}
+
+inline void LocalUring::Prepare() {
+	if (bWakeArmed == false) {
+		struct io_uring_sqe * sqe = io_uring_get_sqe(&ring);
+		if (sqe != NULL) {
+			io_uring_prep_poll_add(sqe, wake_fd, POLLIN);
+			io_uring_sqe_set_data(sqe, NULL);
+			bWakeArmed = true;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+	while (oPendings.empty() == false) {
+		if (PrepareOne(oPendings.front()) == false) {
+			break;
+		}
+		oPendings.pop_front();
+	}
+}
+
+inline void LocalUring::Complete(struct io_uring_cqe * cqe) {
+	LocalUringRequest * request = (LocalUringRequest *) io_uring_cqe_get_data(cqe);
+	if (request == NULL) { //eventfd 被唤醒，清空计数后下一轮重新 POLL
+		uint64_t value;
+		if (read(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+			LOGGER_WARN("#" << __LINE__ << ", LocalUring::Complete, eventfd, Error: " << strerror(errno));
+		}
+		bWakeArmed = false;
+		return;
+	}
+
+	nInflight--;
+
+	int res = cqe->res;
+	if (res < 0) {
+		int e_code = -res;
+		LOGGER_WARN(
+				"#" << __LINE__ << ", LocalUring::Complete, " << (request->write ? "Write" : "Read") << ", Error: " << strerror(e_code));
+		request->callback(-1, e_code, strerror(e_code));
+		delete request;
+		return;
+	}
+
+	request->done += res;
+
+	/**
+	 * 写入不完整时继续写入剩余部分，读取不完整说明已到文件末尾
+	 */
+	if (request->write == true && res > 0 && request->done < request->size) {
+		std::lock_guard<std::mutex> lock(mtx);
+		oPendings.push_front(request);
+		return;
+	}
+
+	request->callback(request->done, 0, "");
+	delete request;
+}
+
+inline unsigned LocalUring::Reap() {
+	struct io_uring_cqe * cqe;
+	unsigned head;
+	unsigned count = 0;
+	io_uring_for_each_cqe(&ring, head, cqe) {
+		Complete(cqe);
+		count++;
+	}
+	io_uring_cq_advance(&ring, count);
+	return count;
+}
+
+inline void LocalUring::FailPendings(int e_code) {
+	std::deque<LocalUringRequest *> requests;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		requests.swap(oPendings);
+	}
+
+	for (LocalUringRequest * request : requests) {
+		request->callback(-1, e_code, strerror(e_code));
+		delete request;
+	}
+}
+
+inline void LocalUring::Run() {
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (bTerminated == true && oPendings.empty() == true && nInflight == 0) {
+				break;
+			}
+		}
+
+		/**
+		 * 连续提交失败时不再把新请求填入 SQ，直接返回失败，已经在 SQ 中的请求继续重试
+		 */
+		if (nErrors >= MAX_SUBMIT_ERRORS) {
+			FailPendings(EIO);
+		}
+
+		Prepare();
+
+		int state = io_uring_submit_and_wait(&ring, 1);
+		if (state < 0 && state != -EINTR) {
+			nErrors++;
+			LOGGER_WARN(
+					"#" << __LINE__ << ", LocalUring::Run, io_uring_submit_and_wait, Error: " << strerror(-state) << ", Errors: " << nErrors);
+
+			/**
+			 * EAGAIN/EBUSY 通常是完成队列未及时收割，先收割已有的完成，再按失败次数指数退避
+			 */
+			Reap();
+
+			uint32_t backoff = nErrors < 8 ? (1u << nErrors) : MAX_SUBMIT_BACKOFF_MS;
+			if (backoff > MAX_SUBMIT_BACKOFF_MS) {
+				backoff = MAX_SUBMIT_BACKOFF_MS;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+			continue;
+		}
+		nErrors = 0;
+		nSubmits++;
+
+		Reap();
+	}
+}
+
+#endif /* HAVE_LIBURING */
+
+#endif /* LOCAL_URING_HPP_ */
@@ -25,12 +25,17 @@
 #include <databox/filesystemutils.hpp>
 
 #include "rados_cc.hpp"
+#include "rados_stripe.hpp"
 
 class RadosBackend: public Backend {
 private:
 	std::shared_ptr<VsiCephClient> oCephClient;
 	std::shared_ptr<CephNode> node;
 	std::shared_ptr<RadosContext> ctx;
+	std::shared_ptr<RadosAioQueue> oAioQueue;
+
+	uint64_t nStripeSize { 0 }; //新文件的分片大小，0 为单对象
+	std::shared_ptr<RadosStripeLayout> oLayout; //分片布局，单对象文件为空
 
 	std::string filename;
 
@@ -43,8 +48,31 @@ private:
 protected:
 	bool Open(bool create_if_not_exists);
 
+	/**
+	 * 读取清单确定文件布局，有清单为分片文件，没有清单时按单对象文件或新文件处理
+	 */
+	bool LoadLayout(const std::shared_ptr<RadosContext> & oContext);
+
+	void SubmitAio(bool write, const std::string & oid, char * buf, size_t len, uint64_t off,
+			const std::function<void(int ret)> & callback);
+
+	int ReadStriped(void * buffer, size_t size, off_t offset);
+
+	int WriteStriped(void * buffer, size_t size, off_t offset);
+
+	void ReadStripedAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	void WriteStripedAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	bool TruncateStriped(off_t length);
+
+	bool UnlinkStriped();
+
+	bool GetAttrStriped(struct stat * st);
+
 public:
-	RadosBackend(const std::shared_ptr<VsiCephClient> & oCephClient, const std::string & filename);
+	RadosBackend(const std::shared_ptr<VsiCephClient> & oCephClient, const std::shared_ptr<RadosAioQueue> & oAioQueue,
+			uint64_t nStripeSize, const std::string & filename);
 
 	~RadosBackend();
 
@@ -52,6 +80,10 @@ public:
 
 	int Write(void * buffer, size_t size, off_t offset);
 
+	void ReadAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	void WriteAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
 	bool Truncate(const std::string& filename, off_t length);
 
 	bool Unlink(const std::string& filename);
@@ -70,10 +102,14 @@ public:
 class RadosBackendFactory: public BackendFactory {
 private:
 	std::shared_ptr<VsiCephClient> oCephClient;
+	std::shared_ptr<RadosAioQueue> oAioQueue; //所有文件共用的异步读写在途数限制
+	uint64_t nStripeSize { 0 }; //新文件的分片大小，0 为不分片
 	std::string prefix;
 public:
 	RadosBackendFactory(const std::string & conf);
 
+	void GetMetrics(std::map<std::string, uint64_t> & metrics);
+
 	std::shared_ptr<Backend> Open(const std::string & filename);
 
 	std::string Prefix() {
@@ -10,10 +10,20 @@
 
 #include <string>
 #include <memory>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <functional>
 
 #include <errno.h>
 
+#ifdef RADOS_STUB // 测试程序使用 gtest/rados_stub.hpp
+#include "rados_stub.hpp"
+#else
 #include <rados/librados.h>
+#endif
 
 #include <databox/cpl_conf.hpp>
 #include <databox/cpl_debug.h>
@@ -21,12 +31,9 @@
 struct RadosContext {
 private:
 	rados_ioctx_t ioctx_ { NULL };
-	rados_completion_t comp_ { NULL };
 
 	rados_t cluster_ { NULL };
 	std::string pool_;
-
-	bool has_data_ { false };
 public:
 	RadosContext(rados_t cluster, const std::string & pool) :
 			cluster_(cluster), pool_(pool) {
@@ -39,8 +46,6 @@ public:
 	}
 
 	~RadosContext() {
-		aio_close();
-
 		if (ioctx_) {
 			LOGGER_TRACE("#" << __LINE__ << ", RadosContext::~RadosContext, rados_ioctx_destroy: " << pool_);
 			rados_ioctx_destroy(ioctx_);
@@ -48,21 +53,7 @@ public:
 		}
 	}
 
-	int aio_start() {
-		aio_close();
-		LOGGER_TRACE("#" << __LINE__ << ", RadosContext::aio_start, rados_aio_create_completion: " << pool_);
-		int err = rados_aio_create_completion(NULL, NULL, NULL, &comp_);
-		if (err < 0) {
-			errno = abs(err);
-		}
-		return err;
-	}
-
-	int aio_flush() { // 当有数据写入过，需要进行 flush
-		if (comp_ == NULL || has_data_ == false) {
-			return 0;
-		}
-
+	int aio_flush() { // 等待该 ioctx 上所有异步写入完成
 		if (ioctx_) {
 			LOGGER_TRACE("#" << __LINE__ << ", RadosContext::aio_flush, rados_aio_flush: " << pool_);
 			int err = rados_aio_flush(ioctx_);
@@ -71,66 +62,179 @@ public:
 			}
 			return err;
 		}
-
-		has_data_ = false;
 		return 0;
 	}
 
-	int aio_write(const char *oid, const char *buf, size_t len, uint64_t off) {
-		has_data_ = true;
+	rados_t cluster() const {
+		return cluster_;
+	}
 
-		if (comp_ == NULL) {
-			LOGGER_TRACE(
-					"#" << __LINE__ << ", RadosContext::aio_write, rados_write: " << pool_ << "|" << std::string(oid) << ", size: " << len << ", offset: " << off);
-			int err = rados_write(ioctx_, oid, buf, len, off);
-			if (err < 0) {
-				errno = abs(err);
-			}
-			return err;
-		}
+	rados_ioctx_t ioctx() const {
+		return ioctx_;
+	}
 
-		LOGGER_TRACE(
-				"#" << __LINE__ << ", RadosContext::aio_write, rados_aio_write: " << pool_ << "|" << std::string(oid) << ", size: " << len << ", offset: " << off);
-		int err = rados_aio_write(ioctx_, oid, comp_, buf, len, off);
-		if (err < 0) {
-			errno = abs(err);
-		}
-		return err;
+	const std::string& pool() const {
+		return pool_;
 	}
+};
 
-	int aio_close() {
-		if (comp_ == NULL) {
-			return 0;
+class RadosAioQueue;
+
+/**
+ * 一个 rados 异步读写请求，每个请求使用独立的 completion，ctx 在完成前保持有效
+ */
+struct RadosAioRequest {
+	bool write { false };
+	std::shared_ptr<RadosContext> ctx;
+	std::string oid;
+	char * buf { NULL };
+	size_t len { 0 };
+	uint64_t off { 0 };
+	rados_completion_t comp { NULL };
+	rados_write_op_t write_op { NULL }; //不为空时整体执行该写入操作代替 rados_aio_write，完成后释放
+	std::weak_ptr<RadosAioQueue> queue;
+
+	/**
+	 * 读取返回字节数，写入成功返回 len，失败返回 -errno，在 librados 回调线程中调用
+	 */
+	std::function<void(int ret)> callback;
+};
+
+/**
+ * rados 异步读写的在途数限制，一个前缀共用
+ * 超过 max_inflight 时请求暂存等待，完成一个提交一个，不阻塞提交线程
+ */
+class RadosAioQueue: public std::enable_shared_from_this<RadosAioQueue> {
+private:
+	std::mutex mtx;
+	size_t max_inflight { 64 };
+	size_t nInflight { 0 }; //mtx 保护
+	std::deque<RadosAioRequest *> oWaitings; //mtx 保护
+
+protected:
+	static void Complete(rados_completion_t comp, void * arg);
+
+	void Start(RadosAioRequest * request);
+
+	/**
+	 * 一个请求完成，放行一个等待的请求
+	 */
+	void Done();
+
+public:
+	std::atomic<uint64_t> nRequests { 0 };
+	std::atomic<uint64_t> nParked { 0 }; //进入等待列表的次数
+
+	RadosAioQueue(size_t max_inflight_) :
+			max_inflight(std::max<size_t>(1, max_inflight_)) {
+	}
+
+	void Submit(RadosAioRequest * request);
+
+	void GetDepth(size_t & inflight, size_t & waiting) {
+		std::lock_guard<std::mutex> lock(mtx);
+		inflight = nInflight;
+		waiting = oWaitings.size();
+	}
+};
+
+inline void RadosAioQueue::Submit(RadosAioRequest * request) {
+	nRequests++;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (nInflight >= max_inflight) {
+			oWaitings.push_back(request);
+			nParked++;
+			return;
 		}
+		nInflight++;
+	}
 
-		int err = 0;
-		if (ioctx_) {
-			LOGGER_TRACE("#" << __LINE__ << ", RadosContext::aio_flush, rados_aio_flush: " << pool_);
-			err = rados_aio_flush(ioctx_);
-			if (err < 0) {
-				errno = abs(err);
-			}
+	Start(request);
+}
+
+inline void RadosAioQueue::Start(RadosAioRequest * request) {
+	request->queue = this->shared_from_this();
+
+	int err = rados_aio_create_completion(request, RadosAioQueue::Complete, NULL, &request->comp);
+	if (err >= 0) {
+		if (request->write_op != NULL) {
+			LOGGER_TRACE(
+					"#" << __LINE__ << ", RadosAioQueue::Start, rados_aio_write_op_operate: " << request->ctx->pool() << "|" << request->oid);
+			err = rados_aio_write_op_operate(request->write_op, request->ctx->ioctx(), request->comp, request->oid.c_str(),
+					NULL, 0);
+		} else if (request->write == true) {
+			LOGGER_TRACE(
+					"#" << __LINE__ << ", RadosAioQueue::Start, rados_aio_write: " << request->ctx->pool() << "|" << request->oid << ", size: " << request->len << ", offset: " << request->off);
+			err = rados_aio_write(request->ctx->ioctx(), request->oid.c_str(), request->comp, request->buf, request->len,
+					request->off);
+		} else {
+			LOGGER_TRACE(
+					"#" << __LINE__ << ", RadosAioQueue::Start, rados_aio_read: " << request->ctx->pool() << "|" << request->oid << ", size: " << request->len << ", offset: " << request->off);
+			err = rados_aio_read(request->ctx->ioctx(), request->oid.c_str(), request->comp, request->buf, request->len,
+					request->off);
 		}
+	}
 
-		rados_aio_release(comp_);
-		comp_ = NULL;
+	if (err >= 0) {
+		return;
+	}
 
-		has_data_ = false;
-		return err;
+	/**
+	 * 没有提交成功，不会有回调，直接结束
+	 */
+	if (request->comp != NULL) {
+		rados_aio_release(request->comp);
+	}
+	if (request->write_op != NULL) {
+		rados_release_write_op(request->write_op);
 	}
+	request->callback(-abs(err));
+	delete request;
 
-	rados_t cluster() const {
-		return cluster_;
+	Done();
+}
+
+inline void RadosAioQueue::Complete(rados_completion_t comp, void * arg) {
+	RadosAioRequest * request = (RadosAioRequest *) arg;
+
+	int ret = rados_aio_get_return_value(comp);
+	rados_aio_release(comp);
+
+	if (request->write_op != NULL) {
+		rados_release_write_op(request->write_op);
 	}
 
-	rados_ioctx_t ioctx() const {
-		return ioctx_;
+	if (ret == 0 && request->write == true) {
+		ret = request->len;
 	}
 
-	const std::string& pool() const {
-		return pool_;
+	/**
+	 * 完成后放行等待的请求，回调之前获取 queue，回调中可能释放最后的引用
+	 */
+	std::shared_ptr<RadosAioQueue> queue = request->queue.lock();
+	request->callback(ret);
+	delete request;
+
+	if (queue.get() != NULL) {
+		queue->Done();
 	}
-};
+}
+
+inline void RadosAioQueue::Done() {
+	RadosAioRequest * request = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (oWaitings.empty() == true) {
+			nInflight--;
+			return;
+		}
+		request = oWaitings.front();
+		oWaitings.pop_front();
+	}
+
+	Start(request);
+}
 
 class CephNode {
 private:
@@ -0,0 +1,465 @@
+/*
+ * rados_stripe.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#ifndef RADOS_STRIPE_HPP_
+#define RADOS_STRIPE_HPP_
+
+/**
+ * rados 分片布局：一个文件切分为固定大小的分片对象 <dataid>.<16 位十六进制序号>，
+ * 另有一个清单对象 <dataid>.manifest 记录分片大小、文件长度和修改时间，
+ * 不同分片落在不同的 PG/OSD 上，一个大文件不同块的读写可以并行
+ *
+ * 分片对象不存在或不完整的部分视为空洞，读取时在文件长度以内补 0
+ *
+ * 清单每次更新代数加一，代数同时写入清单内容和清单对象的 xattr，写入时比较 xattr 中的代数，
+ * 期间被其他节点更新则重新读取清单，合并长度后重试，其他节点的截断通过更大的代数观察到
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+#include "rados_cc.hpp"
+
+#define RADOS_STRIPE_MAGIC 0x54534244 // "DBST"
+#define RADOS_STRIPE_VERSION 2
+#define RADOS_STRIPE_GENERATION "dbox.generation" //清单对象上记录代数的 xattr
+#define RADOS_STRIPE_RETRIES 16 //清单更新冲突时的最多重试次数
+
+/**
+ * 清单对象的内容，定长，每次整体覆盖写入
+ */
+struct RadosStripeManifest {
+	uint32_t magic { RADOS_STRIPE_MAGIC };
+	uint32_t version { RADOS_STRIPE_VERSION };
+	uint64_t stripe_size { 0 };
+	uint64_t length { 0 };
+	int64_t mtime { 0 };
+	uint64_t generation { 0 }; //清单更新的代数，与 xattr 中的相同
+
+	bool Valid(int bytes) const {
+		return bytes == (int) sizeof(RadosStripeManifest) && magic == RADOS_STRIPE_MAGIC
+				&& version == RADOS_STRIPE_VERSION && stripe_size > 0;
+	}
+};
+
+/**
+ * 一次读写落在一个分片对象上的部分
+ */
+struct RadosStripePiece {
+	uint64_t index { 0 }; //分片序号
+	size_t pos { 0 }; //在调用者缓冲区中的位置
+	size_t len { 0 };
+	uint64_t off { 0 }; //在分片对象中的偏移
+};
+
+/**
+ * 一次分片读写的汇合，所有分片完成后调用 done
+ */
+struct RadosStripeJoin {
+	std::atomic<size_t> remaining { 0 };
+	std::vector<RadosStripePiece> pieces;
+	std::vector<int> results; //每个分片的返回值，下标与分片相同
+	RadosStripeManifest manifest; //同时读取的清单
+	int manifest_ret { 0 };
+	std::function<void(RadosStripeJoin & join)> done;
+
+	void Finish() {
+		if (remaining.fetch_sub(1) == 1) {
+			done(*this);
+		}
+	}
+};
+
+class RadosStripeLayout: public std::enable_shared_from_this<RadosStripeLayout> {
+private:
+	std::string sDataId;
+	uint64_t nStripeSize { 0 };
+
+	std::mutex mtx;
+	uint64_t nLength { 0 }; //文件长度，mtx 保护
+	uint64_t nGeneration { 0 }; //已知的清单代数，0 为清单不存在，mtx 保护
+	uint64_t nUncommitted { 0 }; //数据已写入、清单还没有包含的最大结束位置，mtx 保护
+
+	/**
+	 * 清单写入：同一时间只有一个在途，期间完成的数据写入合并到下一次清单写入
+	 */
+	bool bSyncing { false }; //mtx 保护
+	uint64_t nDirty { 0 }; //数据写入完成的次数，mtx 保护
+	int nRetries { 0 }; //在途清单写入的冲突次数
+	RadosStripeManifest oRecord; //在途清单写入的缓冲区
+	RadosStripeManifest oRemote; //冲突后重新读取清单的缓冲区
+	std::vector<std::pair<uint64_t, std::function<void(int ret)> > > oWaiters; //等待清单写入的数据写入，mtx 保护
+
+protected:
+	void SyncNext(const std::shared_ptr<RadosContext> & ctx, const std::shared_ptr<RadosAioQueue> & queue);
+
+	void SyncDone(uint64_t seq, int ret, const std::shared_ptr<RadosContext> & ctx,
+			const std::shared_ptr<RadosAioQueue> & queue);
+
+	void SyncReload(uint64_t seq, int ret, const std::shared_ptr<RadosContext> & ctx,
+			const std::shared_ptr<RadosAioQueue> & queue);
+
+	/**
+	 * 清单写入成功，记录新的代数，record 中已经包含的数据写入不再等待
+	 */
+	void Committed(const RadosStripeManifest & record) {
+		std::lock_guard<std::mutex> lock(mtx);
+		nGeneration = std::max(nGeneration, record.generation);
+		if (nUncommitted <= record.length) {
+			nUncommitted = 0;
+		}
+	}
+
+	/**
+	 * 比较代数后整体写入清单：代数为 0 时要求清单不存在，否则要求 xattr 中的代数不变
+	 */
+	static rados_write_op_t NewManifestOp(const RadosStripeManifest & record) {
+		rados_write_op_t op = rados_create_write_op();
+		uint64_t guard = record.generation - 1;
+		if (guard == 0) {
+			rados_write_op_create(op, LIBRADOS_CREATE_EXCLUSIVE, NULL);
+		} else {
+			rados_write_op_cmpxattr(op, RADOS_STRIPE_GENERATION, LIBRADOS_CMPXATTR_OP_EQ, (const char *) &guard,
+					sizeof(guard));
+		}
+		rados_write_op_setxattr(op, RADOS_STRIPE_GENERATION, (const char *) &record.generation,
+				sizeof(record.generation));
+		rados_write_op_write_full(op, (const char *) &record, sizeof(record));
+		return op;
+	}
+
+public:
+	RadosStripeLayout(const std::string & dataid, uint64_t stripe_size, uint64_t length) :
+			sDataId(dataid), nStripeSize(stripe_size), nLength(length) {
+	}
+
+	static std::string ManifestOid(const std::string & dataid) {
+		return dataid + ".manifest";
+	}
+
+	std::string ManifestOid() const {
+		return ManifestOid(sDataId);
+	}
+
+	std::string StripeOid(uint64_t index) const {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx", (unsigned long long) index);
+		return sDataId + suffix;
+	}
+
+	uint64_t getStripeSize() const {
+		return nStripeSize;
+	}
+
+	/**
+	 * 文件长度覆盖的分片数
+	 */
+	uint64_t getStripeCount(uint64_t length) const {
+		return (length + nStripeSize - 1) / nStripeSize;
+	}
+
+	uint64_t GetLength() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return nLength;
+	}
+
+	uint64_t GetGeneration() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return nGeneration;
+	}
+
+	/**
+	 * 清单删除后，没有提交的写入也不再保留
+	 */
+	void Reset() {
+		std::lock_guard<std::mutex> lock(mtx);
+		nLength = nGeneration = nUncommitted = 0;
+	}
+
+	/**
+	 * 数据写入完成，清单提交之前文件长度已经包含该写入
+	 */
+	void Extend(uint64_t length) {
+		std::lock_guard<std::mutex> lock(mtx);
+		nLength = std::max(nLength, length);
+		nUncommitted = std::max(nUncommitted, length);
+	}
+
+	/**
+	 * 用读取到的清单更新文件长度，清单不存在或无效时返回 -errno
+	 * 代数更大的清单以其长度为准（可能被其他节点截断），再合并本地还没有提交的写入，更旧的清单忽略
+	 */
+	int Refresh(int bytes, const RadosStripeManifest & manifest) {
+		if (manifest.Valid(bytes) == true) {
+			std::lock_guard<std::mutex> lock(mtx);
+			if (manifest.generation >= nGeneration) {
+				nGeneration = manifest.generation;
+				nLength = std::max(manifest.length, nUncommitted);
+			}
+			return 0;
+		}
+
+		if (bytes == -ENOENT) { //清单被其他节点删除，之后的写入重新创建
+			std::lock_guard<std::mutex> lock(mtx);
+			nGeneration = 0;
+			nLength = nUncommitted;
+		}
+		return bytes < 0 ? bytes : -EIO;
+	}
+
+	/**
+	 * 清单写入因为代数比较失败
+	 */
+	static bool Conflict(int ret) {
+		return ret == -ECANCELED || ret == -EEXIST || ret == -ENODATA;
+	}
+
+	/**
+	 * 同步读取清单并更新文件长度，返回同 Refresh
+	 */
+	int Load(rados_ioctx_t ioctx, RadosStripeManifest & manifest) {
+		int bytes = rados_read(ioctx, ManifestOid().c_str(), (char *) &manifest, sizeof(manifest), 0);
+		return Refresh(bytes, manifest);
+	}
+
+	/**
+	 * 按分片边界切分一次读写
+	 */
+	void Split(size_t size, off_t offset, std::vector<RadosStripePiece> & pieces) const {
+		size_t pos = 0;
+		while (pos < size) {
+			uint64_t position = offset + pos;
+
+			RadosStripePiece piece;
+			piece.index = position / nStripeSize;
+			piece.off = position % nStripeSize;
+			piece.pos = pos;
+			piece.len = std::min<uint64_t>(size - pos, nStripeSize - piece.off);
+			pieces.push_back(piece);
+
+			pos += piece.len;
+		}
+	}
+
+	/**
+	 * 分片读取完成后，文件长度以内没有读到的部分补 0，返回文件长度以内的字节数
+	 */
+	int Fill(char * buffer, size_t size, off_t offset, const std::vector<RadosStripePiece> & pieces,
+			const std::vector<int> & results) {
+		uint64_t length = GetLength();
+		if ((uint64_t) offset >= length) {
+			return 0;
+		}
+
+		size_t bytes = std::min<uint64_t>(size, length - offset);
+		for (size_t i = 0; i < pieces.size(); i++) {
+			const RadosStripePiece & piece = pieces[i];
+			size_t got = std::max(results[i], 0);
+			if (got < piece.len && piece.pos + got < bytes) {
+				memset(buffer + piece.pos + got, 0, std::min(piece.len, bytes - piece.pos) - got);
+			}
+		}
+		return bytes;
+	}
+
+	void Encode(RadosStripeManifest & record) {
+		std::lock_guard<std::mutex> lock(mtx);
+		record.stripe_size = nStripeSize;
+		record.length = nLength;
+		record.mtime = time(NULL);
+		record.generation = nGeneration + 1;
+	}
+
+	/**
+	 * 数据写入完成后提交清单，清单写入后调用 callback，多个写入合并为一次清单写入
+	 */
+	void Commit(uint64_t end, const std::shared_ptr<RadosContext> & ctx, const std::shared_ptr<RadosAioQueue> & queue,
+			const std::function<void(int ret)> & callback);
+
+	/**
+	 * 同步写入清单，truncate 为 true 时长度为 length，否则为当前长度与远程长度的较大者
+	 * 成功返回 0，失败返回 -errno，冲突次数过多返回 -EBUSY
+	 */
+	int CommitSync(rados_ioctx_t ioctx, bool truncate = false, uint64_t length = 0);
+};
+
+inline int RadosStripeLayout::CommitSync(rados_ioctx_t ioctx, bool truncate, uint64_t length) {
+	for (int i = 0; i < RADOS_STRIPE_RETRIES; i++) {
+		RadosStripeManifest record;
+		Encode(record);
+		if (truncate == true) {
+			record.length = length;
+		}
+
+		rados_write_op_t op = NewManifestOp(record);
+		int ret = rados_write_op_operate(op, ioctx, ManifestOid().c_str(), NULL, 0);
+		rados_release_write_op(op);
+
+		if (ret >= 0) {
+			if (truncate == true) {
+				std::lock_guard<std::mutex> lock(mtx);
+				nLength = length;
+				nUncommitted = std::min(nUncommitted, length);
+			}
+			Committed(record);
+			return 0;
+		}
+
+		if (Conflict(ret) == false) {
+			return ret;
+		}
+
+		LOGGER_TRACE("#" << __LINE__ << ", RadosStripeLayout::CommitSync, " << sDataId << ", Conflict: " << record.generation);
+
+		RadosStripeManifest manifest;
+		int state = Load(ioctx, manifest);
+		if (state < 0 && state != -ENOENT) {
+			return state;
+		}
+	}
+	return -EBUSY;
+}
+
+inline void RadosStripeLayout::Commit(uint64_t end, const std::shared_ptr<RadosContext> & ctx,
+		const std::shared_ptr<RadosAioQueue> & queue, const std::function<void(int ret)> & callback) {
+
+	bool bStart = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		nLength = std::max(nLength, end);
+		nUncommitted = std::max(nUncommitted, end);
+		oWaiters.push_back(std::make_pair(++nDirty, callback));
+		if (bSyncing == false) {
+			bSyncing = bStart = true;
+		}
+	}
+
+	if (bStart == true) {
+		SyncNext(ctx, queue);
+	}
+}
+
+inline void RadosStripeLayout::SyncNext(const std::shared_ptr<RadosContext> & ctx,
+		const std::shared_ptr<RadosAioQueue> & queue) {
+
+	uint64_t seq = 0;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		seq = nDirty;
+	}
+	Encode(oRecord);
+
+	RadosAioRequest * request = new RadosAioRequest();
+	request->write = true;
+	request->ctx = ctx;
+	request->oid = ManifestOid();
+	request->buf = (char *) &oRecord;
+	request->len = sizeof(oRecord);
+	request->off = 0;
+	request->write_op = NewManifestOp(oRecord);
+
+	std::shared_ptr<RadosStripeLayout> self = this->shared_from_this();
+	request->callback = [ self, seq, ctx, queue ]( int ret ) {
+		self->SyncDone( seq, ret, ctx, queue );
+	};
+
+	queue->Submit(request);
+}
+
+/**
+ * seq 之前完成的数据写入都已包含在这次清单中
+ * 代数冲突时异步重新读取清单，合并后再次写入，在回调线程中不能同步读写
+ */
+inline void RadosStripeLayout::SyncDone(uint64_t seq, int ret, const std::shared_ptr<RadosContext> & ctx,
+		const std::shared_ptr<RadosAioQueue> & queue) {
+
+	if (Conflict(ret) == true && ++nRetries < RADOS_STRIPE_RETRIES) {
+		LOGGER_TRACE("#" << __LINE__ << ", RadosStripeLayout::SyncDone, " << sDataId << ", Conflict: " << oRecord.generation);
+
+		RadosAioRequest * request = new RadosAioRequest();
+		request->ctx = ctx;
+		request->oid = ManifestOid();
+		request->buf = (char *) &oRemote;
+		request->len = sizeof(oRemote);
+		request->off = 0;
+
+		std::shared_ptr<RadosStripeLayout> self = this->shared_from_this();
+		request->callback = [ self, seq, ctx, queue ]( int bytes ) {
+			self->SyncReload( seq, bytes, ctx, queue );
+		};
+
+		queue->Submit(request);
+		return;
+	}
+
+	if (Conflict(ret) == true) {
+		ret = -EBUSY;
+	}
+	nRetries = 0;
+
+	if (ret >= 0) {
+		Committed(oRecord);
+	}
+
+	std::vector<std::function<void(int ret)> > callbacks;
+	bool bNext = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		auto iter = oWaiters.begin();
+		while (iter != oWaiters.end() && iter->first <= seq) {
+			callbacks.push_back(iter->second);
+			iter++;
+		}
+		oWaiters.erase(oWaiters.begin(), iter);
+
+		if (nDirty > seq) {
+			bNext = true;
+		} else {
+			bSyncing = false;
+		}
+	}
+
+	if (ret < 0) {
+		LOGGER_WARN("#" << __LINE__ << ", RadosStripeLayout::SyncDone, " << sDataId << ", Error: " << strerror(abs(ret)));
+	}
+
+	for (auto & callback : callbacks) {
+		callback(ret < 0 ? ret : 0);
+	}
+
+	if (bNext == true) {
+		SyncNext(ctx, queue);
+	}
+}
+
+/**
+ * 冲突后读取到的清单合并到本地长度，重新写入，seq 之后完成的写入也一并包含
+ */
+inline void RadosStripeLayout::SyncReload(uint64_t seq, int bytes, const std::shared_ptr<RadosContext> & ctx,
+		const std::shared_ptr<RadosAioQueue> & queue) {
+
+	Refresh(bytes, oRemote);
+
+	if (bytes < 0 && bytes != -ENOENT) {
+		SyncDone(seq, bytes, ctx, queue);
+		return;
+	}
+
+	SyncNext(ctx, queue);
+}
+
+#endif /* RADOS_STRIPE_HPP_ */
@@ -0,0 +1,271 @@
+/*
+ * sim_backend.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#ifndef SIM_BACKEND_HPP_
+#define SIM_BACKEND_HPP_
+
+/**
+ * 模拟后端，用于没有存储集群时的性能测试和回归测试
+ *
+ * 数据保存在内存或本地目录中，每个操作按配置的分布增加延迟，按带宽上限排队传输，
+ * 同时进行的操作数受 max_concurrency 限制，并按比例注入错误；
+ * 异步读写不占用后端线程，到期后由定时线程回调，与 rados 的多个请求同时在途相同
+ */
+
+#include <math.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+#include <backend.hpp>
+
+#include <databox/cpl_debug.h>
+#include <databox/cpl_conf.hpp>
+#include <databox/filesystemutils.hpp>
+
+/**
+ * 操作类型，每种操作有独立的延迟分布和错误率
+ */
+enum SimOp {
+	soRead = 0, soWrite = 1, soMeta = 2, soCount = 3
+};
+
+/**
+ * 延迟分布: fixed 固定为 mean，uniform 为 [0, 2 * mean]，exp 为均值 mean 的指数分布，
+ * lognormal 为中位数 mean、形状参数 sigma 的对数正态分布（长尾）
+ */
+struct SimLatency {
+	std::string dist { "fixed" };
+	uint32_t mean_usec { 0 };
+	double sigma { 1.0 };
+
+	void Load(const ConfReader & cr, const std::string & op);
+
+	uint64_t Sample(std::mt19937_64 & rng) const;
+};
+
+/**
+ * 带宽上限，所有请求共用一条链路，按到达顺序依次传输，bps = 0 为不限制
+ */
+struct SimLink {
+	std::mutex mtx;
+	uint64_t bps { 0 };
+	std::chrono::steady_clock::time_point next; //链路空闲的时间，mtx 保护
+
+	/**
+	 * 预留传输 bytes 的时间，返回从现在到传输结束的微秒数
+	 */
+	uint64_t Reserve(size_t bytes);
+};
+
+/**
+ * 到期执行回调的定时线程
+ */
+class SimScheduler {
+private:
+	std::mutex mtx;
+	std::condition_variable cond;
+	std::multimap<std::chrono::steady_clock::time_point, std::function<void(void)> > oTimers; //mtx 保护
+	bool bRunning { false }; //mtx 保护
+	std::thread oThread;
+
+protected:
+	void Run();
+
+public:
+	~SimScheduler() {
+		Stop();
+	}
+
+	void Start();
+
+	/**
+	 * 停止时立即执行所有未到期的回调
+	 */
+	void Stop();
+
+	/**
+	 * 定时线程未启动时返回 false
+	 */
+	bool Post(uint64_t delay_usec, const std::function<void(void)> & callback);
+};
+
+/**
+ * 模拟存储，root 为空时保存在内存中
+ */
+class SimStore {
+private:
+	struct SimFile {
+		std::mutex mtx;
+		std::string data; //mtx 保护
+		time_t mtime { 0 };
+	};
+
+	std::string root;
+
+	std::mutex mtx;
+	std::map<std::string, std::shared_ptr<SimFile> > oFiles; //mtx 保护
+
+protected:
+	std::shared_ptr<SimFile> Find(const std::string & name, bool create);
+
+public:
+	SimStore(const std::string & root_) :
+			root(root_) {
+	}
+
+	/**
+	 * 失败时返回 -1 和 e_code
+	 */
+	int Read(const std::string & name, void * buffer, size_t size, off_t offset, int & e_code);
+
+	int Write(const std::string & name, const void * buffer, size_t size, off_t offset, int & e_code);
+
+	bool Truncate(const std::string & name, off_t length, int & e_code);
+
+	bool Unlink(const std::string & name, int & e_code);
+
+	bool GetAttr(const std::string & name, struct stat * st, int & e_code);
+
+	bool Exists(const std::string & name);
+
+	bool MakeDirs(const std::string & name, int & e_code);
+};
+
+/**
+ * 一个前缀的模拟环境，工厂和所有文件共用
+ */
+class SimState {
+private:
+	SimLatency oLatency[SimOp::soCount];
+	double error_rate[SimOp::soCount] { 0, 0, 0 }; //注入错误的比例，0 ~ 1
+	int error_code { EIO };
+
+	SimLink oReadLink;
+	SimLink oWriteLink;
+
+	std::mutex mtx_rng;
+	std::mt19937_64 rng; //mtx_rng 保护
+
+	/**
+	 * 同时进行的操作数，超过 max_concurrency 时暂存等待，0 为不限制
+	 */
+	std::mutex mtx;
+	uint32_t max_concurrency { 0 };
+	uint32_t nInflight { 0 }; //mtx 保护
+	std::deque<std::function<void(void)> > oWaitings; //mtx 保护
+
+protected:
+	/**
+	 * 获得空位后执行：注入错误或执行存储操作，按延迟和带宽计算完成时间，到期回调
+	 */
+	void Start(SimOp op, size_t bytes, const std::function<int(int & e_code)> & fIO, const Backend::IOCallback & callback);
+
+	void Release();
+
+	bool InjectError(SimOp op);
+
+public:
+	SimStore oStore;
+	SimScheduler oScheduler;
+
+	std::atomic<uint64_t> nCalls[SimOp::soCount];
+	std::atomic<uint64_t> nErrors { 0 };
+	std::atomic<uint64_t> nParked { 0 };
+	std::atomic<uint64_t> nReadBytes { 0 };
+	std::atomic<uint64_t> nWriteBytes { 0 };
+
+	SimState(const ConfReader & cr);
+
+	/**
+	 * 提交一次操作，fIO 执行存储操作，返回字节数或 -1 和 e_code，callback 在定时线程中调用
+	 */
+	void Submit(SimOp op, size_t bytes, const std::function<int(int & e_code)> & fIO, const Backend::IOCallback & callback);
+
+	/**
+	 * 提交后等待完成，bytes < 0 时 e_code 为错误码
+	 */
+	int Call(SimOp op, size_t bytes, const std::function<int(int & e_code)> & fIO, int & e_code);
+
+	void GetDepth(uint32_t & inflight, uint32_t & waiting) {
+		std::lock_guard<std::mutex> lock(mtx);
+		inflight = nInflight;
+		waiting = oWaitings.size();
+	}
+};
+
+class SimBackend: public Backend {
+private:
+	std::shared_ptr<SimState> oState;
+	std::string filename;
+
+protected:
+	/**
+	 * 同步调用的结果写入 code 和 message
+	 */
+	bool Done(int state, int e_code, const char * method);
+
+public:
+	SimBackend(const std::shared_ptr<SimState> & oState, const std::string & filename);
+
+	int Read(void * buffer, size_t size, off_t offset);
+
+	int Write(void * buffer, size_t size, off_t offset);
+
+	void ReadAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	void WriteAsync(void * buffer, size_t size, off_t offset, const IOCallback & callback);
+
+	bool Truncate(const std::string& filename, off_t length);
+
+	bool Unlink(const std::string& filename);
+
+	bool MkDir(const std::string& filename);
+
+	bool RmDir(const std::string& filename);
+
+	bool GetAttr(const std::string& filename, struct stat * st);
+
+	bool isValid(bool create_if_not_exists);
+};
+
+class SimBackendFactory: public BackendFactory {
+private:
+	std::shared_ptr<SimState> oState;
+public:
+	SimBackendFactory(const std::string & conf);
+
+	std::shared_ptr<Backend> Open(const std::string & filename);
+
+	bool Validate(const std::string& filename);
+
+	void Start();
+
+	void Stop();
+
+	void GetMetrics(std::map<std::string, uint64_t> & metrics);
+};
+
+#include "sim_backend.inc"
+
+#endif /* SIM_BACKEND_HPP_ */
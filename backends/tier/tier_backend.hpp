@@ -0,0 +1,372 @@
+/*
+ * tier_backend.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#ifndef TIER_BACKEND_HPP_
+#define TIER_BACKEND_HPP_
+
+/**
+ * 分层后端：一个新前缀包装两个已经加载的前缀，上层为本地目录（SSD），下层为较慢的后端（如 rados）
+ *
+ * 文件按 chunk_kb 切分为片，每片在上层的状态记录在 state_dir 下的状态文件中，重启后仍然有效：
+ * 读取时上层没有的片从下层读取后写入上层；write-back 写入上层后返回，由上传线程延迟写入下层，
+ * write-through 同时写入上下两层后返回；write-back 返回前上层数据和状态文件已经落盘，重启后继续上传
+ *
+ * 上层文件为 <upper>://<upper_dir>/<转义后的文件名>，文件名中的 % 和 / 转义为 %25 和 %2F；
+ * 转义后超过 NAME_MAX 的取开头一段加上 %H<哈希>，原文件名保存在 state_dir 下同名的 .name 文件中，用于重启后恢复；
+ * 分层后端假设下层文件只通过该前缀修改，状态文件加载时发现下层长度或修改时间变化且没有待上传的片，丢弃上层数据
+ */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include <backend.hpp>
+
+#include <databox/cpl_debug.h>
+#include <databox/cpl_conf.hpp>
+
+#define TIER_MAP_MAGIC 0x4d544244 // "DBTM"
+#define TIER_MAP_VERSION 1
+
+#define TIER_NAME_PREFIX 128 //过长的文件名保留的转义后开头长度
+
+/**
+ * 一片在上层的状态，状态文件中每片一个字节
+ */
+enum TierChunk {
+	tcAbsent = 0, //上层没有，从下层读取
+	tcClean = 1, //上层与下层一致
+	tcDirty = 2, //只写入了上层，等待上传
+	tcUploading = 3 //正在上传，期间再次写入变回 tcDirty
+};
+
+/**
+ * 状态文件头，之后为每片的状态
+ */
+struct TierMapHeader {
+	uint32_t magic { TIER_MAP_MAGIC };
+	uint32_t version { TIER_MAP_VERSION };
+	uint64_t chunk_size { 0 };
+	uint64_t length { 0 }; //文件长度，包括未上传的写入
+	int64_t lower_size { -1 }; //最近一次确认时下层的长度和修改时间，用于发现下层被其他途径修改
+	int64_t lower_mtime { 0 };
+
+	bool Valid(ssize_t bytes, uint64_t chunk_size_) const {
+		return bytes == (ssize_t) sizeof(TierMapHeader) && magic == TIER_MAP_MAGIC && version == TIER_MAP_VERSION
+				&& chunk_size == chunk_size_;
+	}
+};
+
+/**
+ * 一个文件的分层状态，同一文件的所有句柄共用，有待上传的片时由 TierStore 持有
+ */
+class TierFile {
+public:
+	std::string name;
+	std::shared_ptr<Backend> oUpper; //mtx 保护，删除文件后置空
+	std::shared_ptr<Backend> oLower; //mtx 保护
+
+	std::mutex mtx_upload; //上传与截取、删除串行
+	std::mutex mtx_io; //填充、写入、截取和删除串行，避免填充覆盖新写入的数据
+
+	std::mutex mtx;
+	int fd { -1 }; //状态文件，mtx 保护
+	bool bLoaded { false }; //mtx 保护
+	TierMapHeader header; //mtx 保护
+	std::vector<uint8_t> chunks; //每片的状态，mtx 保护
+	size_t nDirty { 0 }; //tcDirty 和 tcUploading 的片数，mtx 保护
+
+	TierFile(const std::string & name_) :
+			name(name_) {
+	}
+
+	~TierFile() {
+		if (fd >= 0) {
+			close(fd);
+		}
+		fd = -1;
+	}
+
+	uint8_t GetChunk(uint64_t index) {
+		std::lock_guard<std::mutex> lock(mtx);
+		return index < chunks.size() ? chunks[index] : (uint8_t) TierChunk::tcAbsent;
+	}
+
+	uint64_t GetLength() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return header.length;
+	}
+
+	/**
+	 * 取得上下两层，未打开或已删除时返回 false
+	 */
+	bool GetBackends(std::shared_ptr<Backend> & upper, std::shared_ptr<Backend> & lower) {
+		std::lock_guard<std::mutex> lock(mtx);
+		upper = oUpper;
+		lower = oLower;
+		return bLoaded == true && upper.get() != NULL && lower.get() != NULL;
+	}
+
+	uint8_t GetChunkLocked(uint64_t index) const {
+		return index < chunks.size() ? chunks[index] : (uint8_t) TierChunk::tcAbsent;
+	}
+
+	/**
+	 * 有待上传的片，或新建后还没有上传过，下层可能还不存在，mtx 已加锁
+	 */
+	bool IsUpperOnlyLocked() const {
+		return bLoaded == true && (nDirty > 0 || (header.lower_size == 0 && header.lower_mtime == 0));
+	}
+
+	/**
+	 * 修改一片的状态并写入状态文件，mtx 已加锁
+	 */
+	void SetChunkLocked(uint64_t index, uint8_t state);
+
+	/**
+	 * 写入状态文件头，mtx 已加锁
+	 */
+	void SaveHeaderLocked();
+};
+
+/**
+ * 一个分层前缀的状态，工厂和所有文件共用
+ */
+class TierStore {
+private:
+	std::shared_ptr<BackendFactory> oUpperFactory;
+	std::shared_ptr<BackendFactory> oLowerFactory;
+
+	std::string upper_dir;
+	std::string state_dir;
+	uint64_t nChunkSize { 1024 * 1024 };
+	uint64_t nMaxIOSize { 8 * 1024 * 1024 }; //一次填充或上传的最大长度
+	bool bWriteBack { true };
+	uint32_t nUploadDelay { 5 }; //秒
+
+	std::mutex mtx;
+	std::map<std::string, std::weak_ptr<TierFile> > oFiles; //已打开的文件，mtx 保护
+	std::map<std::string, std::shared_ptr<TierFile> > oDirtyFiles; //有待上传片的文件，mtx 保护
+	std::map<std::string, std::shared_ptr<TierFile> > oChangedFiles; //下层已修改、需要更新状态文件头的文件，mtx 保护
+
+	std::condition_variable cond;
+	bool bRunning { false }; //mtx 保护
+	std::thread oUploader;
+
+protected:
+	std::string Escape(const std::string & name) const;
+
+	std::string Unescape(const std::string & name) const;
+
+	/**
+	 * 状态文件和上层文件使用的名字，转义后加上后缀超过 NAME_MAX 时截取开头加上 %H<哈希>
+	 */
+	std::string StoreName(const std::string & name) const;
+
+	std::string MapPath(const std::string & name) const {
+		return state_dir + "/" + StoreName(name) + ".map";
+	}
+
+	std::string NamePath(const std::string & name) const {
+		return state_dir + "/" + StoreName(name) + ".name";
+	}
+
+	/**
+	 * 过长的文件名写入 .name 文件，已有的 .name 文件必须是同一文件名，失败时返回 false 和 e_code
+	 */
+	bool SaveName(const std::string & name, int & e_code);
+
+	/**
+	 * 从 .map 文件名得到原文件名，哈希的名字读取 .name 文件，失败时返回 false
+	 */
+	bool LoadName(const std::string & stored, std::string & name) const;
+
+	/**
+	 * 打开状态文件并校验，create_if_not_exists 时下层不存在按长度 0 处理，失败时返回 false 和 e_code
+	 */
+	bool LoadMap(const std::shared_ptr<TierFile> & oFile, bool create_if_not_exists, int & e_code);
+
+	/**
+	 * 从下层读取 [first, last] 片中仍然不在上层的开头几片，写入上层，复制请求的部分到 buffer
+	 * 返回填充覆盖的请求字节数，失败时返回 -1 和 e_code
+	 */
+	int Fill(const std::shared_ptr<TierFile> & oFile, uint64_t first, uint64_t last, char * buffer, size_t size,
+			off_t offset, int & e_code);
+
+	/**
+	 * 写入前加载一片原有的数据，mtx_io 已加锁
+	 */
+	bool FillChunk(const std::shared_ptr<TierFile> & oFile, const std::shared_ptr<Backend> & oUpper,
+			const std::shared_ptr<Backend> & oLower, uint64_t index, int & e_code);
+
+	/**
+	 * 从下层读取 [start, stop) 写入上层，下层没有的部分补 0
+	 * 返回 1 成功，0 上层写入失败（data 仍然有效），-1 下层读取失败，失败时 e_code 为错误码
+	 */
+	int Load(const std::shared_ptr<Backend> & oUpper, const std::shared_ptr<Backend> & oLower, uint64_t start,
+			uint64_t stop, const std::shared_ptr<char> & data, int & e_code);
+
+	/**
+	 * 上传一个文件所有待上传的片，相邻片合并为一次下层写入
+	 */
+	void Upload(const std::shared_ptr<TierFile> & oFile);
+
+	/**
+	 * 下层修改完成且没有待上传的片后，记录下层的长度和修改时间
+	 */
+	void Refresh(const std::shared_ptr<TierFile> & oFile);
+
+	void MarkDirty(const std::shared_ptr<TierFile> & oFile);
+
+	void MarkChanged(const std::shared_ptr<TierFile> & oFile);
+
+	/**
+	 * 启动时找出有待上传片的状态文件
+	 */
+	void Recover();
+
+	void Run();
+
+	/**
+	 * 上传所有待上传的文件，更新下层已修改的文件
+	 */
+	void Sync();
+
+public:
+	std::atomic<uint64_t> nHitBytes { 0 }; //从上层读取的字节数
+	std::atomic<uint64_t> nFills { 0 }; //从下层填充的次数
+	std::atomic<uint64_t> nFillBytes { 0 };
+	std::atomic<uint64_t> nUploads { 0 }; //上传的下层写入次数
+	std::atomic<uint64_t> nUploadBytes { 0 };
+	std::atomic<uint64_t> nUploadErrors { 0 };
+	std::atomic<uint64_t> nResets { 0 }; //下层被修改，丢弃上层数据的次数
+
+	TierStore(const ConfReader & cr, const std::shared_ptr<BackendFactory> & oUpperFactory,
+			const std::shared_ptr<BackendFactory> & oLowerFactory);
+
+	std::string UpperName(const std::string & name) const {
+		return upper_dir.empty() == true ? StoreName(name) : upper_dir + "/" + StoreName(name);
+	}
+
+	const std::shared_ptr<BackendFactory> & getLowerFactory() const {
+		return oLowerFactory;
+	}
+
+	/**
+	 * 同一文件返回同一个状态对象
+	 */
+	std::shared_ptr<TierFile> GetFile(const std::string & name);
+
+	/**
+	 * 打开上下两层并加载状态文件，失败时返回 false 和 e_code
+	 */
+	bool Open(const std::shared_ptr<TierFile> & oFile, bool create_if_not_exists, int & e_code);
+
+	/**
+	 * 读写失败时返回 -1 和 e_code
+	 */
+	int Read(const std::shared_ptr<TierFile> & oFile, void * buffer, size_t size, off_t offset, int & e_code);
+
+	int Write(const std::shared_ptr<TierFile> & oFile, const void * buffer, size_t size, off_t offset, int & e_code);
+
+	bool Truncate(const std::shared_ptr<TierFile> & oFile, off_t length, int & e_code);
+
+	bool Unlink(const std::shared_ptr<TierFile> & oFile, int & e_code);
+
+	/**
+	 * 有待上传的片时文件长度以状态为准
+	 */
+	bool GetAttr(const std::shared_ptr<TierFile> & oFile, struct stat * st, int & e_code);
+
+	void Start();
+
+	/**
+	 * 停止前上传所有待上传的片
+	 */
+	void Stop();
+
+	void GetDepth(size_t & dirty_files, size_t & open_files);
+};
+
+class TierBackend: public Backend {
+private:
+	std::shared_ptr<TierStore> oStore;
+	std::shared_ptr<TierFile> oFile;
+	std::string filename;
+
+protected:
+	/**
+	 * 结果写入 code 和 message
+	 */
+	bool Done(bool state, int e_code, const char * method);
+
+public:
+	TierBackend(const std::shared_ptr<TierStore> & oStore, const std::string & filename);
+
+	int Read(void * buffer, size_t size, off_t offset);
+
+	int Write(void * buffer, size_t size, off_t offset);
+
+	int Read(void * buffer, size_t size, off_t offset, int & e_code);
+
+	int Write(void * buffer, size_t size, off_t offset, int & e_code);
+
+	bool Truncate(const std::string& filename, off_t length);
+
+	bool Unlink(const std::string& filename);
+
+	bool MkDir(const std::string& filename);
+
+	bool RmDir(const std::string& filename);
+
+	bool GetAttr(const std::string& filename, struct stat * st);
+
+	bool isValid(bool create_if_not_exists);
+};
+
+/**
+ * 不是插件，由 BackendManager 在加载全部插件后按 backend_tier 创建
+ */
+class TierBackendFactory: public BackendFactory {
+private:
+	std::shared_ptr<TierStore> oStore;
+public:
+	TierBackendFactory(const std::string & conf, const std::shared_ptr<BackendFactory> & oUpperFactory,
+			const std::shared_ptr<BackendFactory> & oLowerFactory);
+
+	std::shared_ptr<Backend> Open(const std::string & filename);
+
+	bool Validate(const std::string& filename);
+
+	void Start();
+
+	void Stop();
+
+	void GetMetrics(std::map<std::string, uint64_t> & metrics);
+};
+
+#include "tier_backend.inc"
+
+#endif /* TIER_BACKEND_HPP_ */
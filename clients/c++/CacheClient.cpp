@@ -656,7 +656,7 @@ VFile::VFile(const std::shared_ptr<DboxSlabClient> & oCacheClient_, const std::s
 		moFileClient(oCacheClient_), moMsgSender(oMsgSender_), msFilename(filename_),  //
 		msMode(mode_), miTimeout(timeout_) {
 
-	if (mode_.find("w") == mode_.npos) {
+	if (mode_.find("w") == mode_.npos && mode_.find("a") == mode_.npos) {
 		/**
 		 * 只读模式
 		 */
@@ -753,6 +753,87 @@ ssize_t VFile::Read(void* buffer, size_t buffer_size, off_t offset) {
 	return tsFailed;
 }
 
+/**
+ * 客户端多区间读取数据流程
+ * 	 1、将所有区间一次发送到 127.0.0.1:6501 的 块缓存 服务上，服务端合并所需块后并行读取，一次返回所有区间数据
+ * 	 返回 成功读取数据总量，<0 代表错误发生
+ */
+ssize_t VFile::ReadV(std::vector<ReadRange> & ranges) {
+	TRACE_TIMER(t, "ReadV")
+
+	if (ranges.size() > MAX_READV_RANGES) {
+		msMessage = FAILED_INVALID_ARGUMENT;
+		return -EINVAL;
+	}
+
+	std::shared_ptr<stringbuffer> sb = std::make_shared<stringbuffer>();
+
+	sb->write_int8(CacheAction::caClientReadV);
+	sb->write_str(msFilename);
+	sb->write_int8(bReadOnly == true ? 1 : 0); //是否只读，如果只读，数据块端将进行通讯优化
+
+	sb->write_uint32(ranges.size());
+	for (ReadRange & range : ranges) {
+		range.bytes = 0;
+		sb->write_int64(range.offset);
+		sb->write_uint64(range.size);
+	}
+
+	const auto & result = moMsgSender->SendMessage(sb, miTimeout);
+
+	if (result->timeout() == true) {
+		msMessage = FAILED_CONNECTION_TIMEOUT;
+		LOGGER_TRACE("#" << __LINE__ << ", CacheFile::ReadV: " << msMessage)
+		return -EBUSY;
+	}
+
+	if (result->ok() == true) {
+		int8_t action;
+		int32_t state = tsFailed;
+
+		if (result->input->read_int8(action) == false || result->input->read_int32(state) == false
+				|| action != CacheAction::caClientReadVResp) {
+			msMessage = FAILED_INVALID_RESPONSE;
+			LOGGER_TRACE("#" << __LINE__ << ", CacheFile::ReadV: " << msMessage << ", " << action)
+			return tsFailed;
+		}
+
+		if (state != tsSuccess) { //如果 块缓存 上发送错误，则读取错误 message
+			if (result->input->read_str(msMessage) == false) {
+				msMessage = FAILED_INVALID_RESPONSE;
+				LOGGER_TRACE("#" << __LINE__ << ", CacheFile::ReadV: " << msMessage)
+				return tsFailed;
+			}
+			return state;
+		}
+
+		uint32_t nRanges = 0;
+		if (result->input->read_uint32(nRanges) == false || nRanges != ranges.size()) {
+			msMessage = FAILED_INVALID_RESPONSE;
+			LOGGER_TRACE("#" << __LINE__ << ", CacheFile::ReadV: " << msMessage)
+			return tsFailed;
+		}
+
+		ssize_t bytes_total = 0;
+		for (ReadRange & range : ranges) {
+			size_t bytes_readed = 0;
+			if (result->input->read_str((char *) range.buffer, range.size, bytes_readed) == false) {
+				msMessage = FAILED_INVALID_RESPONSE;
+				LOGGER_TRACE("#" << __LINE__ << ", CacheFile::ReadV: " << msMessage)
+				return tsFailed;
+			}
+			range.bytes = bytes_readed;
+			bytes_total += bytes_readed;
+		}
+
+		return bytes_total;
+	}
+
+	msMessage = FAILED_CONNECTION_FAILED;
+	LOGGER_TRACE("#" << __LINE__ << ", CacheFile::ReadV: " << msMessage)
+	return tsFailed;
+}
+
 /**
  * 客户端写入数据流程
  * 	 1、将数据直接写入到 127.0.0.1:6501 的 块缓存 服务上，剩余事情由 块缓存 处理
@@ -815,6 +896,63 @@ ssize_t VFile::Write(const void* buffer, size_t buffer_size, off_t offset, bool
 	return tsFailed;
 }
 
+ssize_t VFile::Append(const void* buffer, size_t buffer_size, bool async_write, off_t * offset) {
+	if (bReadOnly == true) {
+		msMessage = "Readonly File";
+		LOGGER_TRACE("#" << __LINE__ << ", CacheFile::Append: " << msMessage)
+		return - EROFS;
+	}
+
+	if (buffer_size == 0) {
+		return 0;
+	}
+
+	int8_t write_async = async_write == true ? 1 : 0;
+
+	std::shared_ptr<stringbuffer> sb = std::make_shared<stringbuffer>();
+
+	sb->write_int8(CacheAction::caClientAppend);
+	sb->write_str(msFilename);
+	sb->write_int8(bReadOnly == true ? 1 : 0);
+
+	sb->write_str((const char *) buffer, buffer_size);
+	sb->write_int8(write_async);
+
+	const auto & result = moMsgSender->SendMessage(sb, miTimeout);
+
+	if (result->timeout() == true) {
+		msMessage = FAILED_CONNECTION_TIMEOUT;
+		LOGGER_TRACE("#" << __LINE__ << ", CacheFile::Append: " << msMessage)
+		return -EBUSY;
+	}
+
+	if (result->ok() == true) {
+		int8_t action;
+		int32_t bytes = tsFailed;
+		if (result->input->read_int8(action) == false || result->input->read_int32(bytes) == false
+				|| action != CacheAction::caClientAppendResp || result->input->read_str(msMessage) == false) {
+			msMessage = FAILED_INVALID_RESPONSE;
+			LOGGER_TRACE("#" << __LINE__ << ", CacheFile::Append: " << msMessage)
+			return tsFailed;
+		}
+
+		int64_t data_offset = -1;
+		if (bytes >= 0 && result->input->read_int64(data_offset) == false) {
+			data_offset = -1;
+		}
+
+		if (offset != NULL) {
+			*offset = data_offset;
+		}
+
+		return bytes;
+	}
+
+	msMessage = FAILED_CONNECTION_FAILED;
+	LOGGER_TRACE("#" << __LINE__ << ", CacheFile::Append: " << msMessage)
+	return tsFailed;
+}
+
 int VFile::Truncate(off_t newsize) {
 	if (bReadOnly == true) {
 		msMessage = "Readonly File";
@@ -9,6 +9,7 @@
 #define CACHECLIENT_HPP_
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <future>         // std::promise, std::future
 
 #include <databox/stringutils.hpp>
@@ -28,6 +29,7 @@
 #define	tsSuccess   0 //成功
 
 #define MAX_REQUEST_SIZE ( 8 * 1024 * 1024 ) //单次请求的最大数据长度
+#define MAX_READV_RANGES ( 1024 ) //单次请求的最大区间数
 
 // 默认管理 1024 * 1 内存块，每块 256 KB，共 256 MB
 // 对应 SlabForward.hpp 里面需要一致
@@ -79,7 +81,16 @@ enum CacheAction {
 	caClientGetAttrResp = 23,  //客户端读取文件属性返回
 
 	caClientFlush = 24,        //客户端刷新写入数据
-	caClientFlushResp = 25     //客户端刷新写入数据返回
+	caClientFlushResp = 25,    //客户端刷新写入数据返回
+
+	caClientReadV = 26,        //一次读取文件的多个区间
+	caClientReadVResp = 27,    //读取多个区间返回
+
+	caClientReadStream = 28,   //流式读取，不受单次请求长度限制
+	caClientReadStreamResp = 29, //流式读取返回，每块一帧
+
+	caClientAppend = 50,       //客户端追加写入，写入位置由服务端分配
+	caClientAppendResp = 51    //客户端追加写入返回，成功时附加写入位置
 
 };
 
@@ -127,6 +138,23 @@ public:
 
 };
 
+/**
+ * ReadV 读取的一个区间
+ */
+struct ReadRange {
+	off_t offset { 0 };
+	size_t size { 0 };
+	void * buffer { NULL }; //数据存放位置，至少 size 字节
+	ssize_t bytes { 0 }; //实际读取数据量
+
+	ReadRange() {
+	}
+
+	ReadRange(off_t offset_, size_t size_, void * buffer_) :
+			offset(offset_), size(size_), buffer(buffer_) {
+	}
+};
+
 class DboxSlabClient;
 
 class VFile {
@@ -144,8 +172,20 @@ public:
 	 */
 	ssize_t Read2(void * buffer, size_t buffer_size, off_t offset);
 
+	/**
+	 * 一次请求读取多个区间，服务端只获取一次元数据，并行读取后一次返回
+	 * 区间总长度不超过 MAX_REQUEST_SIZE，返回成功读取的数据总量，每个区间的读取量在 bytes 中
+	 */
+	ssize_t ReadV(std::vector<ReadRange> & ranges);
+
 	ssize_t Write(const void * buffer, size_t buffer_size, off_t offset, bool async_write = true);
 
+	/**
+	 * 追加写入到文件末尾，不需要指定位置，offset 不为 NULL 时返回服务端分配的写入位置
+	 * 多个块缓存服务器同时追加相同文件不保证顺序
+	 */
+	ssize_t Append(const void * buffer, size_t buffer_size, bool async_write = true, off_t * offset = NULL);
+
 	/**
 	 * 刷新远程块缓存服务器的修改块 和 后端存储
 	 */
@@ -205,7 +245,7 @@ public:
 	/**
 	 新建一个文件对象进行读写
 
-	 mode: r 只读模式，w 修改模式
+	 mode: r 只读模式，w 修改模式，a 追加模式（可写）
 
 	 当 readonly == true  模式，由于使用属性（size、version等）缓存优化 3s，读取效率更高，但当其他块缓存服务器上写入数据的后端存储文件，被当前节点在写入之前已经访问，可能会存在数据不同步问题
 	 当 readonly == false 无数据不同步问题
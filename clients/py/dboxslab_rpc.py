@@ -55,6 +55,15 @@ caClientGetAttrResp = 23      # 客户端读取文件属性返回
 caClientFlush = 24            # 客户端刷新写入数据
 caClientFlushResp = 25        # 客户端刷新写入数据返回
 
+caClientReadV = 26            # 一次读取文件的多个区间
+caClientReadVResp = 27        # 读取多个区间返回
+
+caClientReadStream = 28       # 流式读取，不受单次请求长度限制
+caClientReadStreamResp = 29   # 流式读取返回，每块一帧
+
+caClientAppend = 50           # 客户端追加写入，写入位置由服务端分配
+caClientAppendResp = 51       # 客户端追加写入返回，成功时附加写入位置
+
 FAILED_INVALID_RESPONSE = "Invalid response";
 FAILED_CONNECTION_TIMEOUT = "Connection timeout";
 FAILED_CONNECTION_FAILED = "Connection failed";
@@ -94,6 +103,41 @@ class CacheFile(object):
         
         return message
         
+    def ReadStream(self, size, offset=0):
+        """ 流式读取，逐块返回 (offset, data)，不受单次请求长度限制 """
+        pydata = PyHiveData()
+        pydata.write_int8(caClientReadStream)
+        
+        pydata.write_str(self.filename) 
+        pydata.write_int8(1 if self.readonly == True else  0)
+        
+        pydata.write_int64(offset);
+        pydata.write_uint64(size);               
+
+        c = Connection(self.hostinfo, self.timeout).connect()         
+        c.send(pydata)
+        
+        while True:
+            action, data = c.recv_frame()
+            if action != caClientReadStreamResp :
+                raise DBoxException(tsFailed, FAILED_INVALID_RESPONSE)   
+            
+            pydata.set_data(data)     
+            
+            state = pydata.read_int32(tsFailed) 
+            if state != tsSuccess :
+                raise DBoxException(state, pydata.read_str(FAILED_INVALID_RESPONSE))
+            
+            last = pydata.read_int8(1)
+            data_offset = pydata.read_int64(offset)
+            message = pydata.read_str(b"")
+            
+            if len(message) > 0:
+                yield data_offset, message
+            
+            if last == 1:
+                break
+        
     def Write(self, data, offset=0, async_write=True):        
         if self.readonly == True:
             raise DBoxException(tsFailed, "ReadOnly") 
@@ -127,6 +171,42 @@ class CacheFile(object):
         
         return bytes
     
+    def Append(self, data, async_write=True):
+        '''
+        追加写入到文件末尾，返回 (写入字节数, 写入位置)
+        '''
+        if self.readonly == True:
+            raise DBoxException(tsFailed, "ReadOnly") 
+        
+        if len(data) == 0:
+            return 0, -1
+             
+        pydata = PyHiveData()
+        pydata.write_int8(caClientAppend)
+        
+        pydata.write_str(self.filename) 
+        pydata.write_int8(1 if self.readonly == True else  0)
+        
+        pydata.write_str(data);   
+        pydata.write_int8(1 if async_write == True else 0)     
+               
+        c = Connection(self.hostinfo, self.timeout).connect()         
+        action, data = c.commuicate(pydata)
+        
+        if action != caClientAppendResp :
+            raise DBoxException(tsFailed, FAILED_INVALID_RESPONSE)   
+        
+        pydata.set_data(data)     
+        
+        bytes = pydata.read_int32(tsFailed) 
+        message = pydata.read_str(FAILED_INVALID_RESPONSE)
+        
+        if bytes < 0:
+            raise DBoxException(bytes, message)
+        
+        offset = pydata.read_int64(-1)
+        return bytes, offset
+    
     def Flush(self):
         '''
         刷新远程块缓存服务器的修改块 和 后端存储 
@@ -215,6 +215,14 @@ class Connection(object):
         data = self._recv(size - 1)
         return action, data           
 
+    def send(self, data):
+        self.c.sendall(data.pack_data())
+
+    def recv_frame(self):
+        size, action = self._recv_action()
+        data = self._recv(size - 1)
+        return action, data
+
     def _recv(self, size):
         if size == 0:
             return b"" 
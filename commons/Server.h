@@ -30,6 +30,9 @@ struct MetaServerData {
 	// 内存最大文件数，超过会被释放
 	uint32_t max_files { 2 * 256 * 1024 }; //
 
+	// 元数据租约时间，秒，租约期内数据块版本变化时推送失效通知给持有节点，0 为关闭
+	uint32_t lease_ttl { 10 };
+
 	/**
 	 * 日志文件路径
 	 */
@@ -49,7 +52,7 @@ struct SlabServerData {
 	// 元数据服务 tcp 端口
 	uint16_t meta_port { 6500 };
 
-	// 本地服务线程数量
+	// 本地服务线程数量，处理网络和定时器，后端调用在各后端插件的线程池中执行（插件配置 workers）
 	uint16_t workers { 4 };
 
 	//是否可以离线使用
@@ -75,6 +78,27 @@ struct SlabServerData {
 
 	// 内存最大文件数，超过会被释放
 	uint32_t max_files { 1024 * 1024 };
+
+	/**
+	 * 邻居读取对冲：超过最近邻居读取耗时的该百分位仍未返回，启动第二路读取，0 为关闭
+	 */
+	uint32_t hedge_percentile { 95 };
+
+	/**
+	 * 对冲等待的最小时间，微秒
+	 */
+	uint32_t hedge_min_usec { 2000 };
+
+	/**
+	 * 异步写入的本地预写日志目录，为空则关闭，建议放在 SSD 上
+	 */
+	std::string journal_path;
+
+	// 每条日志记录后是否 fdatasync
+	bool journal_sync { true };
+
+	// 日志段文件大小，MB
+	uint32_t journal_segment_mb { 64 };
 };
 
 class SlabPeer {
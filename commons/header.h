@@ -16,6 +16,7 @@
 #define	tsSuccess   0 //成功
 
 #define MAX_REQUEST_SIZE ( 8 * 1024 * 1024 ) //单次请求的最大数据长度
+#define MAX_READV_RANGES ( 1024 ) //单次请求的最大区间数
 
 #define FAILED_INVALID_MEMORY      "Invalid memory"
 #define FAILED_INVALID_ARGUMENT    "Invalid argument"
@@ -26,6 +27,11 @@
 
 #define MEM_PREFIX   "mem://" //内存文件前缀
 
+/**
+ * 元数据服务器支持的功能，附加在 caSlabStatusResp 中，旧版本没有该字段
+ */
+#define META_FEATURE_PUTMETA_BATCH  0x01 //支持 caSlabPutMetaBatch
+
 enum CacheAdminAction {
 
 	caaClearFiles = 10 //清除缓存文件
@@ -62,6 +68,12 @@ enum CacheAction {
 	caClientFlush = 24,        //客户端刷新写入数据
 	caClientFlushResp = 25,    //客户端刷新写入数据返回
 
+	caClientReadV = 26,        //一次读取文件的多个区间
+	caClientReadVResp = 27,    //读取多个区间返回
+
+	caClientReadStream = 28,   //流式读取，不受单次请求长度限制
+	caClientReadStreamResp = 29, //流式读取返回，每块一帧
+
 	caSlabStatus = 30,         //获取节点信息，例如块数量、利用数等，主节点定时主动块节点获取统计信息，块节点反馈信息，彼此通讯确认块节点是否与主节点连通
 	caSlabStatusResp = 31,     //返回节点信息，主节点定时主动块节点获取统计信息，块节点反馈信息，彼此通讯确认块节点是否与主节点连通
 
@@ -84,7 +96,16 @@ enum CacheAction {
 	caSlabGetAttrResp = 43,    //获取文件属性返回
 
 	caMasterCheckIt = 44,      //主节点主动检查数据
-	caMasterCheckItResp = 45   //主节点主动检查数据返回
+	caMasterCheckItResp = 45,  //主节点主动检查数据返回
+
+	caMasterInvalidate = 46,   //主节点通知持有租约的节点元数据失效
+	caMasterInvalidateResp = 47, //主节点通知元数据失效返回
+
+	caSlabPutMetaBatch = 48,   //一次修改文件多块数据信息
+	caSlabPutMetaBatchResp = 49, //一次修改多块数据信息返回
+
+	caClientAppend = 50,       //客户端追加写入，写入位置由服务端分配
+	caClientAppendResp = 51    //客户端追加写入返回，成功时附加写入位置
 
 };
 
@@ -9,7 +9,7 @@
 #define MaxRLimits 65536 * 2
 
 static void help(const char * app) {
-	std::cerr << app << " [stop] [-P master_port] [-T bg_threads] [-d] [--path meta_path]" << std::endl;
+	std::cerr << app << " [stop] [-P master_port] [-T bg_threads] [-d] [--path meta_path] [--lease lease_ttl]" << std::endl;
 }
 
 int main(int argc, char ** argv) {
@@ -43,6 +43,8 @@ int main(int argc, char ** argv) {
 			as_daemon = true;
 		} else if (STR_EQ(a_arg, "--path") && (i < argc - 1)) {
 			oServerData->meta_path = argv[++i];
+		} else if (STR_EQ(a_arg, "--lease") && (i < argc - 1)) {
+			oServerData->lease_ttl = StringUtils::ToLong(argv[++i], oServerData->lease_ttl);
 		} else {
 			help(argv[0]);
 			exit(0);
@@ -56,6 +56,10 @@ ResultType CacheFileService::hb_request(std::shared_ptr<stringbuffer> input, std
 		return DoSlabPutMeta(input, output, worker_conn);
 	}
 
+	if (action == CacheAction::caSlabPutMetaBatch) { // 数据节点一次保存多块信息
+		return DoSlabPutMetaBatch(input, output, worker_conn);
+	}
+
 	if (action == CacheAction::caSlabPutAttr) { // 修改文件属性，只针对内存文件
 		return DoSlabPutAttr(input, output, worker_conn);
 	}
@@ -162,7 +166,9 @@ bool CacheFileService::hb_replay_logs(const std::shared_ptr<MetaLogData> & logda
 			oMetaBlock->ClearPeers();
 		}
 
-		oMetaBlock->AddPeer(oSlabPeer);
+		if (logdata->port > 0) { //绕写的块没有节点
+			oMetaBlock->AddPeer(oSlabPeer);
+		}
 	}
 
 	return true;
@@ -188,6 +194,7 @@ ResultType CacheFileService::DoSlabStatusPost(const std::shared_ptr<stringbuffer
 	}
 
 	output->write_int8(CacheAction::caSlabStatusResp);
+	output->write_uint32( META_FEATURE_PUTMETA_BATCH);
 
 	return ResultType::rtSuccess;
 }
@@ -227,6 +234,7 @@ ResultType CacheFileService::DoSlabGetMeta(const std::shared_ptr<stringbuffer> &
 		LOGGER_TRACE("#" << __LINE__ << ", CacheFileService::DoSlabGetMeta, Not found: " << filename)
 		output->write_int32(0); //uuid
 		output->write_uint32(0); //nBlocks
+		output->write_int32(0); //lease_ttl
 		return ResultType::rtSuccess;
 	}
 
@@ -259,40 +267,34 @@ ResultType CacheFileService::DoSlabGetMeta(const std::shared_ptr<stringbuffer> &
 		std::vector<std::string> peers;
 		oMetaBlock->GetPeers(peers, rs_host, rs_port);
 
-		std::string best_peer;
-		uint64_t delay_usec = 100000000;
-		std::vector<std::string> tmp_peers;
-
-		for (const std::string & peer : peers) {
-			uint64_t t = 0;
-			if (oMetaFileManager->GetSlabPeer(peer, t) == true) {
-				if (delay_usec > t) {
-					delay_usec = t;
-					best_peer = peer;
-				}
-				tmp_peers.push_back(peer);
-			}
+		/**
+		 * 按期望完成时间排序返回多个邻居，数据节点依次尝试，慢邻居由数据节点对冲处理
+		 * 内存文件没有后端存储，返回所有邻居
+		 */
+		size_t max_peers = MAX_META_PEERS;
+		if (filename.find( MEM_PREFIX) == 0) {
+			max_peers = peers.size();
 		}
 
-		if (filename.find( MEM_PREFIX) == 0) { //内存文件
-			output->write_uint32(tmp_peers.size());
-			for (const std::string & peer : tmp_peers) {
-				output->write_str(peer);
-				LOGGER_TRACE(
-						"#" << __LINE__ << ", CacheFileService::DoSlabGetMeta: " << filename << ", BlockId: " << block_offset_id << ", Peers: " << tmp_peers.size() << ", Peer: " << peer)
-			}
-		} else {
-			if (delay_usec < 200000) { //ping 响应速度小于 0.2 s，否则直接从 backend 获取数据
-				output->write_uint32(1);
-				output->write_str(best_peer);
-				LOGGER_TRACE(
-						"#" << __LINE__ << ", CacheFileService::DoSlabGetMeta: " << filename << ", BlockId: " << block_offset_id << ", Best peer: " << best_peer)
-			} else {
-				output->write_uint32(0);
-			}
+		std::vector<std::string> ranked_peers;
+		oMetaFileManager->RankSlabPeers(peers, ranked_peers, max_peers);
+
+		output->write_uint32(ranked_peers.size());
+		for (const std::string & peer : ranked_peers) {
+			output->write_str(peer);
 		}
 
+		LOGGER_TRACE(
+				"#" << __LINE__ << ", CacheFileService::DoSlabGetMeta: " << filename << ", BlockId: " << block_offset_id << ", Peers: " << ranked_peers.size() << ( ranked_peers.empty() ? "" : ", Best peer: " + ranked_peers.front() ))
+	}
+
+	/**
+	 * 授予请求节点元数据租约，租约期内数据块版本变化会推送失效通知
+	 */
+	if (oServerData->lease_ttl > 0) {
+		oMetaFile->GrantLease(SlabPeer(rs_host, rs_port).getKey(), oServerData->lease_ttl);
 	}
+	output->write_int32(oServerData->lease_ttl);
 
 	return ResultType::rtSuccess;
 }
@@ -370,14 +372,135 @@ ResultType CacheFileService::DoSlabPutMeta(const std::shared_ptr<stringbuffer> &
 		oMetaBlock->ClearPeers();
 	}
 
-	oMetaBlock->AddPeer(oSlabPeer);
+	bool bChanged = (overwrite == 1 || lVersion > mVersion);
 
-	output->write_int32( tsSuccess);
+	oMetaBlock->AddPeer(oSlabPeer);
 
 	oMetaLogger->PutFile(filename, uuid, mtime, newsize);
 	oMetaLogger->PutBlock(filename, uuid, block_offset_id, lVersion, rs_host, rs_port);
 
-	return ResultType::rtSuccess;
+	if (bChanged == false) {
+		output->write_int32( tsSuccess);
+		return ResultType::rtSuccess;
+	}
+
+	/**
+	 * 版本变化，通知持有租约的节点，包括写入节点自己，其缓存的是写入前的元数据
+	 * 所有节点确认或租约到期后才应答写入，避免应答后其他节点仍读到旧版本
+	 */
+	oMetaFileManager->InvalidateLeases(oMetaFile, std::vector<uint32_t>(1, block_offset_id),
+			[ conn, iMetaUuid ]() {
+				std::shared_ptr<stringbuffer> response = std::make_shared<stringbuffer>();
+				response->write_int8(CacheAction::caSlabPutMetaResp);
+				response->write_int32(iMetaUuid);
+				response->write_int32( tsSuccess);
+				conn->async_write(response);
+			});
+
+	return ResultType::rtNothing;
+}
+
+/**
+ * 与 DoSlabPutMeta 相同，一个请求携带文件属性和多块 (block_offset_id, version)
+ */
+ResultType CacheFileService::DoSlabPutMetaBatch(const std::shared_ptr<stringbuffer> & input,
+		const std::shared_ptr<stringbuffer> & output, const std::shared_ptr<asio_server_tcp_connection>& conn) {
+
+	std::string filename;
+	int32_t uuid;
+	uint16_t rs_port;
+	int8_t overwrite;
+	time_t mtime = 0;
+	off_t newsize = 0;
+	uint32_t nBlocks = 0;
+
+	if (input->read_int32(uuid) == false || input->read_str(filename) == false || input->read_uint16(rs_port) == false
+			|| input->read_int8(overwrite) == false || input->read_int64(mtime) == false
+			|| input->read_int64(newsize) == false || input->read_uint32(nBlocks) == false) {
+		return ResultType::rtFailed;
+	}
+
+	std::vector<std::pair<uint32_t, int32_t> > blocks;
+	for (uint32_t i = 0; i < nBlocks; i++) {
+		uint32_t block_offset_id;
+		int32_t lVersion;
+		if (input->read_uint32(block_offset_id) == false || input->read_int32(lVersion) == false) {
+			return ResultType::rtFailed;
+		}
+		blocks.push_back(std::make_pair(block_offset_id, lVersion));
+	}
+
+	std::string rs_host;
+	uint16_t peer_port;
+
+	if (conn->remote_endpoint(rs_host, peer_port) == false) {
+		return ResultType::rtFailed;
+	}
+
+	const std::shared_ptr<MetaFile> & oMetaFile = oMetaFileManager->GetOrCreate(filename, uuid);
+
+	oMetaFile->Update();
+	output->write_int8(CacheAction::caSlabPutMetaBatchResp);
+
+	int32_t iMetaUuid = oMetaFile->GetUuid();
+	output->write_int32(iMetaUuid);
+
+	if (uuid != iMetaUuid) {
+		LOGGER_TRACE(
+				"#" << __LINE__ << ", CacheFileService::DoSlabPutMetaBatch, UUID not same: " << filename << ", " << uuid << " --- " << iMetaUuid)
+
+		output->write_int32(tsFailed);
+		return ResultType::rtSuccess;
+	}
+
+	const std::shared_ptr<SlabPeer> & oSlabPeer = std::make_shared<SlabPeer>(rs_host, rs_port);
+
+	std::vector<uint32_t> changed_ids;
+	for (const auto & block : blocks) {
+		const std::shared_ptr<MetaBlock> & oMetaBlock = oMetaFile->GetOrCreate(block.first);
+
+		int32_t mVersion = oMetaBlock->GetVersion();
+
+		if (overwrite >= 1) {
+			oMetaBlock->ClearPeers();
+		}
+
+		if (block.second > mVersion) {
+			oMetaBlock->SetVersion(block.second);
+			oMetaBlock->ClearPeers();
+		}
+
+		if (overwrite >= 1 || block.second > mVersion) {
+			changed_ids.push_back(block.first);
+		}
+
+		if (overwrite != 2) { // 2: 绕写，数据只在后端存储，不记录该节点
+			oMetaBlock->AddPeer(oSlabPeer);
+		}
+	}
+
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", CacheFileService::DoSlabPutMetaBatch: " << filename << ", Blocks: " << blocks.size() << ", Changed: " << changed_ids.size() << ", peer: " << oSlabPeer->getKey())
+
+	oMetaLogger->PutBlocks(filename, uuid, mtime, newsize, blocks, rs_host, overwrite == 2 ? 0 : rs_port);
+
+	if (changed_ids.empty() == true) {
+		output->write_int32( tsSuccess);
+		return ResultType::rtSuccess;
+	}
+
+	/**
+	 * 与 DoSlabPutMeta 相同，持有租约的节点全部确认或租约到期后才应答写入
+	 */
+	oMetaFileManager->InvalidateLeases(oMetaFile, changed_ids, [ conn, iMetaUuid ]() {
+		std::shared_ptr<stringbuffer> response = std::make_shared<stringbuffer>();
+		response->write_int8(CacheAction::caSlabPutMetaBatchResp);
+		response->write_int32(iMetaUuid);
+		response->write_int32( tsSuccess);
+		conn->async_write(response);
+	});
+
+	return ResultType::rtNothing;
 }
 
 ResultType CacheFileService::DoSlabGetAttr(const std::shared_ptr<stringbuffer>& input,
@@ -483,12 +606,26 @@ ResultType CacheFileService::DoSlabUnlinkFile(const std::shared_ptr<stringbuffer
 
 	LOGGER_TRACE("#" << __LINE__ << ", CacheFileService::DoSlabUnlinkFile: " << filename);
 
-	oMetaFileManager->Remove(filename);
-	output->write_int8(CacheAction::caClientUnlinkResp);
+	const std::shared_ptr<MetaFile> & oMetaFile = oMetaFileManager->Get(filename);
 
+	oMetaFileManager->Remove(filename);
 	oMetaLogger->RemoveFile(filename);
 
-	return ResultType::rtSuccess;
+	if (oMetaFile.get() == NULL) {
+		output->write_int8(CacheAction::caClientUnlinkResp);
+		return ResultType::rtSuccess;
+	}
+
+	/**
+	 * 持有租约的节点全部确认或租约到期后才应答
+	 */
+	oMetaFileManager->InvalidateLeases(oMetaFile, std::vector<uint32_t>(), [ conn ]() {
+		std::shared_ptr<stringbuffer> response = std::make_shared<stringbuffer>();
+		response->write_int8(CacheAction::caClientUnlinkResp);
+		conn->async_write(response);
+	});
+
+	return ResultType::rtNothing;
 }
 
 ResultType CacheFileService::DoSlabTruncateFile(const std::shared_ptr<stringbuffer>& input,
@@ -503,10 +640,24 @@ ResultType CacheFileService::DoSlabTruncateFile(const std::shared_ptr<stringbuff
 
 	LOGGER_TRACE("#" << __LINE__ << ", CacheFileService::DoSlabTruncateFile: " << filename << ", newsize: " << newsize);
 
-	oMetaFileManager->Remove(filename);
-	output->write_int8(CacheAction::caClientTruncateResp);
+	const std::shared_ptr<MetaFile> & oMetaFile = oMetaFileManager->Get(filename);
 
+	oMetaFileManager->Remove(filename);
 	oMetaLogger->RemoveFile(filename);
 
-	return ResultType::rtSuccess;
+	if (oMetaFile.get() == NULL) {
+		output->write_int8(CacheAction::caClientTruncateResp);
+		return ResultType::rtSuccess;
+	}
+
+	/**
+	 * 持有租约的节点全部确认或租约到期后才应答
+	 */
+	oMetaFileManager->InvalidateLeases(oMetaFile, std::vector<uint32_t>(), [ conn ]() {
+		std::shared_ptr<stringbuffer> response = std::make_shared<stringbuffer>();
+		response->write_int8(CacheAction::caClientTruncateResp);
+		conn->async_write(response);
+	});
+
+	return ResultType::rtNothing;
 }
@@ -47,6 +47,12 @@ protected:
 
 	ResultType DoSlabPutMeta(const std::shared_ptr<stringbuffer> & input, const std::shared_ptr<stringbuffer> & output,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
+	/**
+	 * 一次修改文件的多块信息，只通知一次租约失效，只写一条日志
+	 */
+	ResultType DoSlabPutMetaBatch(const std::shared_ptr<stringbuffer> & input,
+			const std::shared_ptr<stringbuffer> & output, const std::shared_ptr<asio_server_tcp_connection> & conn);
 	/**
 	 * 修改文件的修改时间和大小，只针对内存文件
 	 */
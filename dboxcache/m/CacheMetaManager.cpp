@@ -5,6 +5,7 @@
  *      Author: root
  */
 
+#include <algorithm>
 #include <databox/hbserver.hpp>
 #include "CacheMetaManager.hpp"
 
@@ -31,18 +32,24 @@ MetaFileManager::~MetaFileManager() {
 /**
  * 利用消息队列进行消息发送到节点
  */
-void MetaFileManager::PostMessage(const std::shared_ptr<TcpMessage> & message) {
+bool MetaFileManager::PostMessage(const std::shared_ptr<TcpMessage> & message) {
+	if (oSlabMessages.qsize() >= MAX_META_MESSAGES) {
+		if (nRejectedMessages++ % MAX_META_MESSAGES == 0) {
+			LOGGER_WARN(
+					"#" << __LINE__ << ", MetaFileManager::PostMessage, " << strerror(EBUSY) << ", Rejected: " << nRejectedMessages);
+		}
+		return false;
+	}
+
 	oSlabMessages.push_back(message);
 
 	EnterMessageLoop();
 
 	size_t nMessages = oSlabMessages.qsize();
-	size_t nms = nMessages / 10;
-	if (nms > 0) {
-		//待刷新的数据过多，需要降低 PostMessage 速度
-		LOGGER_TRACE("MetaFileManager::PostMessage, "<< nMessages << " items, slow down: " << nms << " ms")
-		std::this_thread::sleep_for(std::chrono::milliseconds(nms));
+	if (nMessages > nMaxMessages) {
+		nMaxMessages = nMessages;
 	}
+	return true;
 }
 
 void MetaFileManager::EnterMessageLoop() {
@@ -270,6 +277,9 @@ void MetaFileManager::TraceTrushes(float factor) {
 						LeaveMessageLoop();
 					};
 
+					/**
+					 * 队列已满时跳过该节点，下一轮检查再发送
+					 */
 					PostMessage( message );
 				}
 
@@ -355,6 +365,29 @@ void MetaFileManager::TraceNodes() {
 
 						oSlabJson["network_delay_usec"] = oSlabData->GetNetworkDelayUsec();
 
+						const auto & oHistory = oSlabData->GetHistory();
+						oSlabJson["delay_p50_usec"] = Json::UInt64( oHistory->oHistogram.Percentile( 50 ) );
+						oSlabJson["delay_p90_usec"] = Json::UInt64( oHistory->oHistogram.Percentile( 90 ) );
+						oSlabJson["delay_p99_usec"] = Json::UInt64( oHistory->oHistogram.Percentile( 99 ) );
+
+						oSlabJson["outstanding_reads"] = Json::UInt64( oSlabData->GetOutstandingReads() );
+						oSlabJson["expected_usec"] = Json::UInt64( oSlabData->GetExpectedUsec() );
+
+						Json::Value oMetrics( Json::objectValue );
+						for ( const auto & metric : oSlabData->GetMetrics() ) {
+							oMetrics[ metric.first ] = Json::UInt64( metric.second );
+						}
+
+						/**
+						 * 对冲比例 和 对冲先完成比例
+						 */
+						uint64_t nPeerReads = oSlabData->GetMetric( "peer_reads" );
+						uint64_t nPeerHedges = oSlabData->GetMetric( "peer_hedges" );
+						oMetrics["peer_hedge_rate"] = nPeerReads > 0 ? (double) nPeerHedges / nPeerReads : 0.0;
+						oMetrics["peer_hedge_win_rate"] = nPeerHedges > 0 ? (double) oSlabData->GetMetric( "peer_hedge_wins" ) / nPeerHedges : 0.0;
+
+						oSlabJson["metrics"] = oMetrics;
+
 						oValue.append( oSlabJson );
 					}
 
@@ -365,6 +398,18 @@ void MetaFileManager::TraceNodes() {
 					oRoot[ "num_files" ] = oMetaFiles_m.size();
 				}
 
+				{
+					/**
+					 * 待发送消息和待持久化日志的队列长度
+					 */
+					oRoot[ "message_queue" ] = Json::UInt64( oSlabMessages.qsize() );
+					oRoot[ "message_queue_max" ] = Json::UInt64( nMaxMessages );
+					oRoot[ "message_queue_rejects" ] = Json::UInt64( nRejectedMessages );
+					oRoot[ "log_queue" ] = Json::UInt64( oMetaLogger->GetQueueSize() );
+					oRoot[ "log_queue_max" ] = Json::UInt64( oMetaLogger->nMaxQueue );
+					oRoot[ "log_queue_overflows" ] = Json::UInt64( oMetaLogger->nOverflows );
+				}
+
 				oStatusContainer.add( "base", StringUtils::ToJsonString( oRoot ) );
 
 //		LOGGER_TRACE( "#" << __LINE__ << ", MetaFileManager::TraceNodes, Peers: " << oSlabPeerNames.qsize() << ", " << oSlabPeers_m.size() );
@@ -384,7 +429,12 @@ bool MetaFileManager::NodeStatusPost(std::string& rs_host, unsigned short int rs
 
 	if (oSlabData->ParseStatus(input) == true) {
 
-		if (oSlabPeers_m.exists(key) == 0) {
+		std::shared_ptr<SlabPeerData> oLastData;
+		oSlabPeers_m.get(key, oLastData);
+
+		oSlabData->Inherit(oLastData);
+
+		if (oLastData.get() == NULL) {
 			SYSLOG_WARN(
 					"#" << __LINE__ << ", MetaFileManager::NodeStatusPost: " << oSlabData->getKey() << ", BlockSize: " << oSlabData->GetBlockSize()
 					//
@@ -400,6 +450,8 @@ bool MetaFileManager::NodeStatusPost(std::string& rs_host, unsigned short int rs
 		oSlabPeers_m.put(key, oSlabData);
 		oSlabPeerNames.push_back(key);
 
+		AddPeerReads(oSlabData);
+
 		return true;
 	}
 
@@ -417,6 +469,191 @@ bool MetaFileManager::GetSlabPeer(const std::string& peer, uint64_t & ns_usec) {
 	return false;
 }
 
+void MetaFileManager::InvalidateLeases(const std::shared_ptr<MetaFile> & oMetaFile,
+		const std::vector<uint32_t> & block_ids, const std::function<void(void)> & fDone) {
+
+	std::vector<std::pair<std::string, time_t> > leases;
+	oMetaFile->GetLeases(leases);
+
+	std::vector<std::pair<SlabPeer, time_t> > holders;
+	time_t nLastExpire = 0;
+	for (const auto & lease : leases) {
+		SlabPeer oSlabPeer(lease.first);
+		if (oSlabPeer.getPort() == 0) {
+			continue;
+		}
+		holders.push_back(std::make_pair(oSlabPeer, lease.second));
+		nLastExpire = std::max<time_t>(nLastExpire, lease.second);
+	}
+
+	if (holders.empty() == true) {
+		fDone();
+		return;
+	}
+
+	auto self = this->shared_from_this();
+	const std::string & filename = oMetaFile->GetFilename();
+
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", MetaFileManager::InvalidateLeases: " << filename << ", Blocks: " << block_ids.size() << ", Peers: " << holders.size());
+
+	std::shared_ptr<LeaseInvalidation> oWaiting = std::make_shared<LeaseInvalidation>();
+	oWaiting->nPending = holders.size();
+	oWaiting->fDone = fDone;
+	oWaiting->oTimer = std::make_shared<boost::asio::deadline_timer>(*io_service);
+
+	/**
+	 * 最迟等到所有租约到期，消息队列阻塞时也不会无限等待
+	 */
+	WaitInvalidation(oWaiting, nLastExpire);
+
+	for (const auto & holder : holders) {
+		const std::string & peer = holder.first.getKey();
+		time_t expire = holder.second;
+
+		std::shared_ptr<TcpMessage> message = std::make_shared<TcpMessage>();
+		message->host = holder.first.getHost();
+		message->port = holder.first.getPort();
+
+		message->output->write_int8(CacheAction::caMasterInvalidate);
+		message->output->write_int32(oMetaFile->GetUuid());
+		message->output->write_str(filename);
+
+		message->output->write_uint32(block_ids.size());
+		for (uint32_t block_id : block_ids) {
+			message->output->write_uint32(block_id);
+		}
+
+		/**
+		 * 节点确认或通知失败，失败时等到节点的租约到期，节点上的元数据自然失效
+		 */
+		const auto & fReplied = [ this, self, filename, peer, expire, oWaiting ]( const std::string & error ) {
+			bool bFinish = false;
+			{
+				std::lock_guard<std::mutex> lock(oWaiting->mtx);
+				if(error.empty() == false) {
+					LOGGER_INFO(
+							"#" << __LINE__ << ", MetaFileManager::InvalidateLeases: " << filename << ", " << peer << ", Error: " << error);
+					oWaiting->nFailedExpire = std::max<time_t>(oWaiting->nFailedExpire, expire);
+				}
+
+				if (--oWaiting->nPending > 0 || oWaiting->bDone == true) {
+					return;
+				}
+
+				if (oWaiting->nFailedExpire < SystemUtils::now()) {
+					bFinish = true;
+				}
+			}
+
+			if (bFinish == true) {
+				FinishInvalidation(oWaiting);
+				return;
+			}
+
+			WaitInvalidation(oWaiting, oWaiting->nFailedExpire);
+		};
+
+		message->callback = [ this, self, fReplied ]( std::shared_ptr<stringbuffer> input,
+				const boost::system::error_code & ec, std::shared_ptr<base_connection> conn1 ) {
+			LeaveMessageLoop();
+			fReplied( ec ? ec.message() : "" );
+		};
+
+		if (PostMessage(message) == false) {
+			fReplied(strerror(EBUSY));
+		}
+	}
+}
+
+void MetaFileManager::WaitInvalidation(const std::shared_ptr<LeaseInvalidation> & oWaiting, time_t expire) {
+	time_t now = SystemUtils::now();
+	time_t seconds = expire > now ? expire - now : 0;
+
+	auto self = this->shared_from_this();
+
+	/**
+	 * 租约按秒计时，多等一秒保证到期
+	 */
+	oWaiting->oTimer->expires_from_now(boost::posix_time::seconds(static_cast<long>(seconds + 1)));
+	oWaiting->oTimer->async_wait([ this, self, oWaiting ]( const boost::system::error_code & ec ) {
+		if ( ec ) {
+			return;
+		}
+		FinishInvalidation(oWaiting);
+	});
+}
+
+void MetaFileManager::FinishInvalidation(const std::shared_ptr<LeaseInvalidation> & oWaiting) {
+	{
+		std::lock_guard<std::mutex> lock(oWaiting->mtx);
+		if (oWaiting->bDone == true) {
+			return;
+		}
+		oWaiting->bDone = true;
+	}
+
+	boost::system::error_code ec;
+	oWaiting->oTimer->cancel(ec);
+
+	oWaiting->fDone();
+}
+
+void MetaFileManager::RankSlabPeers(const std::vector<std::string> & peers, std::vector<std::string> & ranked,
+		size_t max_peers) {
+
+	std::vector<std::pair<uint64_t, std::shared_ptr<SlabPeerData> > > candidates;
+
+	for (const std::string & peer : peers) {
+		std::shared_ptr<SlabPeerData> oPeerData;
+		oSlabPeers_m.get(peer, oPeerData);
+		if (oPeerData.get() == NULL || oPeerData->IsTimeout(NODE_TIMEOUT) == true) {
+			continue;
+		}
+		candidates.push_back(std::make_pair(oPeerData->GetExpectedUsec(), oPeerData));
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end(),
+			[]( const std::pair<uint64_t, std::shared_ptr<SlabPeerData> > & a,
+					const std::pair<uint64_t, std::shared_ptr<SlabPeerData> > & b ) {
+				return a.first < b.first;
+			});
+
+	for (const auto & candidate : candidates) {
+		if (ranked.size() >= max_peers) {
+			break;
+		}
+		ranked.push_back(candidate.second->getKey());
+	}
+
+	if (candidates.empty() == false) {
+		candidates.front().second->GetHistory()->nAssigned++;
+	}
+}
+
+void MetaFileManager::AddPeerReads(const std::shared_ptr<SlabPeerData> & oReporter) {
+	static const std::string prefix = "peer_read_count@";
+
+	uint64_t window_usec = oReporter->GetMetric("peer_read_window_usec");
+
+	for (const auto & metric : oReporter->GetMetrics()) {
+		if (metric.first.compare(0, prefix.size(), prefix) != 0) {
+			continue;
+		}
+
+		std::string peer = metric.first.substr(prefix.size());
+
+		std::shared_ptr<SlabPeerData> oPeerData;
+		oSlabPeers_m.get(peer, oPeerData);
+		if (oPeerData.get() == NULL) {
+			continue;
+		}
+
+		oPeerData->GetHistory()->AddReads(oReporter->getKey(), metric.second,
+				oReporter->GetMetric("peer_read_usec@" + peer), window_usec);
+	}
+}
+
 std::string MetaFileManager::GetStatus(const std::string& key) {
 	std::string value;
 	if (oStatusContainer.get(key, value) == true) {
@@ -467,11 +704,128 @@ bool SlabPeerData::ParseStatus(const std::shared_ptr<stringbuffer> & input) {
 	}
 
 	if (input->read_uint64(num_files) == false) {
+		return true;
+	}
+
+	/**
+	 * 可选的运行计数器，旧版本节点没有
+	 */
+	uint32_t nMetrics = 0;
+	if (input->read_uint32(nMetrics) == false) {
+		return true;
+	}
+
+	for (uint32_t i = 0; i < nMetrics; i++) {
+		std::string name;
+		uint64_t value = 0;
+		if (input->read_str(name) == false || input->read_uint64(value) == false) {
+			break;
+		}
+		metrics[name] = value;
 	}
 
 	return true;
 }
 
+void SlabPeerData::Inherit(const std::shared_ptr<SlabPeerData> & oLastData) {
+	if (oLastData.get() != NULL) {
+		oHistory = oLastData->oHistory;
+		/**
+		 * 汇报周期内分配的读取已经由发出读取的节点按周期汇报为在途读取数
+		 */
+		oHistory->nAssigned = 0;
+	}
+}
+
+void SlabPeerHistory::AddReads(const std::string & reporter, uint64_t count, uint64_t total_usec,
+		uint64_t window_usec) {
+
+	if (count > 0) {
+		oHistogram.Add(total_usec / count, count > HISTOGRAM_MAX_COUNT ? HISTOGRAM_MAX_COUNT : count);
+	}
+
+	if (window_usec == 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+	oInflights[reporter] = std::make_pair(total_usec * 1000 / window_usec, SystemUtils::now());
+}
+
+uint64_t SlabPeerHistory::GetInflightReads() {
+	time_t now = SystemUtils::now();
+	uint64_t inflights = 0;
+
+	std::lock_guard<std::mutex> lock(mtx);
+	for (auto iter = oInflights.begin(); iter != oInflights.end();) {
+		if (now - iter->second.second > NODE_TIMEOUT) {
+			iter = oInflights.erase(iter);
+			continue;
+		}
+		inflights += iter->second.first;
+		iter++;
+	}
+
+	return (inflights + 999) / 1000;
+}
+
+uint64_t SlabPeerData::GetExpectedUsec() const {
+	uint64_t usec = oHistory->oHistogram.Percentile(90);
+	if (usec == 0) {
+		usec = network_delay_usec;
+	}
+
+	usec = usec * (PEER_PARALLEL_READS + GetOutstandingReads()) / PEER_PARALLEL_READS;
+
+	if (mem_free_blocks == 0) {
+		usec *= 2;
+	}
+
+	return usec;
+}
+
+void LatencyHistogram::Add(uint64_t usec, uint32_t count) {
+	int idx = 0;
+	while (usec > 1 && idx < HISTOGRAM_BUCKETS - 1) {
+		usec >>= 1;
+		idx++;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+
+	if (total >= HISTOGRAM_MAX_COUNT) {
+		/**
+		 * 衰减旧样本
+		 */
+		total = 0;
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+			buckets[i] /= 2;
+			total += buckets[i];
+		}
+	}
+
+	buckets[idx] += count;
+	total += count;
+}
+
+uint64_t LatencyHistogram::Percentile(uint32_t percentile) const {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t target = (uint64_t) total * std::min<uint32_t>(percentile, 100) / 100;
+	uint64_t count = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		count += buckets[i];
+		if (count > target || count == total) {
+			return 1ULL << (i + 1);
+		}
+	}
+
+	return 1ULL << HISTOGRAM_BUCKETS;
+}
+
 void StatusContainer::add(const std::string& key, const std::string& val) {
 	oStatusData.put(key, val);
 }
@@ -10,6 +10,10 @@
 
 #include <memory>
 #include <atomic>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <vector>
 #include <json/json.h>
 
 #include <databox/mtsafe_object.hpp>
@@ -34,11 +38,70 @@
 #define  NODE_TIMEOUT   3
 #define  FILE_TIMEOUT   2 * 60
 
+/**
+ * 节点延迟直方图，按 2 的幂划分微秒区间，样本过多时减半衰减，多线程访问
+ */
+#define HISTOGRAM_BUCKETS    32
+#define HISTOGRAM_MAX_COUNT  1024
+
+class LatencyHistogram {
+private:
+	mutable std::mutex mtx;
+	uint32_t buckets[HISTOGRAM_BUCKETS] { 0 };
+	uint32_t total { 0 };
+public:
+	void Add(uint64_t usec, uint32_t count = 1);
+
+	/**
+	 * 百分位延迟，返回所在区间的上限，没有样本返回 0
+	 */
+	uint64_t Percentile(uint32_t percentile) const;
+};
+
+/**
+ * 期望完成时间计算，单个节点同时处理的邻居读取数，超过后延迟按比例增加
+ */
+#define PEER_PARALLEL_READS  16
+
+/**
+ * 返回给数据节点的最多邻居数
+ */
+#define MAX_META_PEERS       4
+
+/**
+ * 待发送消息队列上限，超过时 PostMessage 拒绝新消息
+ */
+#define MAX_META_MESSAGES    4096
+
+/**
+ * 节点多次状态汇报之间保留的信息
+ * 延迟和在途读取数来自其他数据节点汇报的、对该节点实际发出的邻居读取
+ */
+class SlabPeerHistory {
+private:
+	std::mutex mtx;
+	std::map<std::string, std::pair<uint64_t, time_t> > oInflights; //汇报节点 -> 平均在途读取数（千分之一）和汇报时间，mtx 保护
+public:
+	LatencyHistogram oHistogram; //邻居读取延迟直方图
+	std::atomic<uint64_t> nAssigned { 0 }; //最近一次汇报后分配到该节点的邻居读取数
+
+	/**
+	 * 记入 reporter 一个汇报周期内对该节点的邻居读取：次数、总耗时、周期长度，微秒
+	 */
+	void AddReads(const std::string & reporter, uint64_t count, uint64_t total_usec, uint64_t window_usec);
+
+	/**
+	 * 各汇报节点到该节点的平均在途读取数之和，忽略超时未汇报的节点
+	 */
+	uint64_t GetInflightReads();
+};
+
 class SlabPeerData: public SlabPeer {
 public:
 	SlabPeerData(const std::string & host_, unsigned short int port_) :
 			SlabPeer::SlabPeer(host_, port_) {
 		nLastActivity = SystemUtils::now();
+		oHistory = std::make_shared<SlabPeerHistory>();
 	}
 
 	/**
@@ -94,6 +157,43 @@ public:
 	size_t GetNumFiles() const {
 		return num_files;
 	}
+
+	/**
+	 * 节点运行计数器，name = value
+	 */
+	const std::map<std::string, uint64_t>& GetMetrics() const {
+		return metrics;
+	}
+
+	uint64_t GetMetric(const std::string & name) const {
+		auto iter = metrics.find(name);
+		if (iter == metrics.end()) {
+			return 0;
+		}
+		return iter->second;
+	}
+
+	/**
+	 * 继承上次汇报的延迟直方图和在途读取数
+	 */
+	void Inherit(const std::shared_ptr<SlabPeerData> & oLastData);
+
+	const std::shared_ptr<SlabPeerHistory>& GetHistory() const {
+		return oHistory;
+	}
+
+	/**
+	 * 未完成的邻居读取数：其他节点汇报的平均在途读取数 + 汇报后新分配的
+	 */
+	uint64_t GetOutstandingReads() const {
+		return oHistory->GetInflightReads() + oHistory->nAssigned;
+	}
+
+	/**
+	 * 期望完成时间，微秒
+	 * 延迟取直方图 90 分位，没有邻居读取样本时取网络延迟，按未完成读取数放大，节点内存块用尽时数据来自磁盘交换，再放大一倍
+	 */
+	uint64_t GetExpectedUsec() const;
 private:
 	time_t nLastActivity { 0 };
 
@@ -109,6 +209,10 @@ private:
 
 	size_t num_files { 0 }; /* 总文件数量 */
 
+	std::map<std::string, uint64_t> metrics; /* 节点运行计数器 */
+
+	std::shared_ptr<SlabPeerHistory> oHistory;
+
 	std::atomic<uint64_t> network_delay_usec { 0 }; //网络通讯时间
 };
 
@@ -121,6 +225,20 @@ public:
 	bool get(const std::string & key, std::string & val);
 };
 
+/**
+ * 一次租约失效通知的等待状态，持有节点全部确认，或者通知失败节点的租约到期后回调 fDone，只回调一次
+ */
+class LeaseInvalidation {
+public:
+	std::mutex mtx;
+	size_t nPending { 0 }; //尚未返回的节点数
+	time_t nFailedExpire { 0 }; //通知失败节点的最晚租约到期时间
+	bool bDone { false };
+
+	std::function<void(void)> fDone;
+	std::shared_ptr<boost::asio::deadline_timer> oTimer;
+};
+
 class MetaFileManager: public std::enable_shared_from_this<MetaFileManager> {
 private:
 	std::shared_ptr<MetaServerData> oServerData;
@@ -134,10 +252,12 @@ private:
 	std::shared_ptr<boost::asio::deadline_timer> timer_Nodes;
 
 	/**
-	 * 消息发送链，每次发送一条，如果消息队列内容太多，需要降低速度
+	 * 消息发送链，每次发送一条，发送完成后取下一条，PostMessage 不等待
 	 */
 	std::mutex mtx_loop;
 	bool bMessagerLoop { false };
+	std::atomic<uint64_t> nMaxMessages { 0 }; //待发送消息队列的最大长度
+	std::atomic<uint64_t> nRejectedMessages { 0 }; //队列已满被拒绝的消息数
 
 	mtsafe::thread_safe_queue<std::shared_ptr<TcpMessage> > oSlabMessages;
 	std::shared_ptr<TcpMessager> oSlabMessager;
@@ -160,6 +280,13 @@ protected:
 
 	void TraceTrushes(float factor);
 
+	/**
+	 * 租约失效通知等待到 expire 时刻
+	 */
+	void WaitInvalidation(const std::shared_ptr<LeaseInvalidation> & oWaiting, time_t expire);
+
+	void FinishInvalidation(const std::shared_ptr<LeaseInvalidation> & oWaiting);
+
 	void EnterMessageLoop();
 
 	void LeaveMessageLoop();
@@ -175,7 +302,10 @@ public:
 
 	~MetaFileManager();
 
-	void PostMessage(const std::shared_ptr<TcpMessage> & message);
+	/**
+	 * 队列已满返回 false（EBUSY），消息没有入队，回调不会被调用
+	 */
+	bool PostMessage(const std::shared_ptr<TcpMessage> & message);
 
 	std::shared_ptr<MetaFile> GetOrCreate(const std::string& filename, int32_t uuid);
 
@@ -185,6 +315,24 @@ public:
 
 	bool GetSlabPeer(const std::string & peer, uint64_t & ns_usec);
 
+	/**
+	 * 把 oReporter 汇报的到各邻居的读取耗时记入对应邻居的历史
+	 */
+	void AddPeerReads(const std::shared_ptr<SlabPeerData> & oReporter);
+
+	/**
+	 * 按期望完成时间对邻居排序，忽略已经掉线的节点，最多返回 max_peers 个
+	 * 第一个邻居记为一次分配，用于在下次状态汇报前分散读取
+	 */
+	void RankSlabPeers(const std::vector<std::string> & peers, std::vector<std::string> & ranked, size_t max_peers);
+
+	/**
+	 * 通知持有租约的节点元数据失效，block_ids 为空代表整个文件
+	 * 所有节点确认后回调 fDone；通知失败时，等到该节点的租约到期后回调，没有持有节点时直接回调
+	 */
+	void InvalidateLeases(const std::shared_ptr<MetaFile> & oMetaFile, const std::vector<uint32_t> & block_ids,
+			const std::function<void(void)> & fDone);
+
 	/**
 	 * 解析节点资源情况，如果是新节点进行资源注册
 	 */
@@ -78,6 +78,8 @@ private:
 	std::atomic<time_t> stat_mtime { time(NULL) }; // 会被多线程修改，只针对内存文件
 	std::atomic<off_t> stat_size { 0 }; // 会被多线程修改，只针对内存文件
 
+	mtsafe::thread_safe_map<std::string, time_t> oLeases; //持有元数据租约的节点及到期时间
+
 public:
 	MetaFile(const std::shared_ptr<MetaFileManager> & oMetaFileManager_, const std::string & filename_, int32_t uuid_);
 
@@ -91,6 +93,16 @@ public:
 
 	void RemovePeer(uint32_t block_offset_id, const std::string & peer);
 
+	/**
+	 * 授予节点元数据租约
+	 */
+	void GrantLease(const std::string & peer, uint32_t ttl);
+
+	/**
+	 * 获取租约未到期的节点及到期时间，同时清除已到期的租约
+	 */
+	void GetLeases(std::vector<std::pair<std::string, time_t> > & leases);
+
 	const std::string& GetFilename() const {
 		return filename;
 	}
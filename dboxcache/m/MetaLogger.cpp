@@ -6,6 +6,8 @@
  */
 
 #include <thread>
+#include <errno.h>
+#include <string.h>
 
 #include "MetaLogger.hpp"
 
@@ -90,6 +92,30 @@ int LeveldbContext::put_log(const std::string& key, const std::string& keydata)
 	}
 }
 
+int LeveldbContext::put_logs(const std::vector<std::pair<std::string, std::string> > & keydatas) {
+	if (level_metadb == NULL) {
+		LOGGER_ERROR("#" << __LINE__ << ", LeveldbContext::put_logs, null")
+		return -1;
+	}
+
+	leveldb::WriteBatch wb;
+	for (const auto & keydata : keydatas) {
+		wb.Put(keydata.first + ":", keydata.second);
+	}
+
+	leveldb::WriteOptions wo;
+	leveldb::Status s = level_metadb->Write(wo, &wb);
+	if (s.ok() == false) {
+		const std::string message = s.ToString();
+		CRITICAL_ERROR("#" << __LINE__ << ", LeveldbContext::put_logs, error, put: " << keydatas.size() << ", " << message)
+		exit(-1);
+		return 0;
+	} else {
+		LOGGER_TRACE("#" << __LINE__ << ", LeveldbContext::put_logs, success, put: " << keydatas.size());
+		return 1;
+	}
+}
+
 int LeveldbContext::iter_logs(
 		std::function<bool(int index, const std::string & key, const std::string & val)> const & callback) {
 	if (level_metadb == NULL) {
@@ -273,6 +299,29 @@ int MetaLogger::sync_write(const std::shared_ptr<MetaLogData> & logdata) {
 		return oLeveldbContext->put_log(s_key.str(), s_val.str());
 	}
 
+	if (logdata->action == MetaAction::maPutBlocks) {
+		std::vector<std::pair<std::string, std::string> > keydatas;
+
+		s_key << logdata->filename << ":00";
+		s_val.write_int32(logdata->uuid);
+		s_val.write_int64(logdata->mtime);
+		s_val.write_int64(logdata->newsize);
+		keydatas.push_back(std::make_pair(s_key.str(), s_val.str()));
+
+		for (const auto & block : logdata->blocks) {
+			std::stringstream b_key;
+			b_key << logdata->filename << ":" << block.first << ":" << logdata->peer << ":01";
+
+			stringbuffer b_val;
+			b_val.write_int32(logdata->uuid);
+			b_val.write_int32(block.second);
+			b_val.write_uint16(logdata->peer_port);
+			keydatas.push_back(std::make_pair(b_key.str(), b_val.str()));
+		}
+
+		return oLeveldbContext->put_logs(keydatas);
+	}
+
 	if (logdata->action == MetaAction::maRemoveFile) {
 		s_key << logdata->filename;
 		return oLeveldbContext->del_logs(s_key.str());
@@ -445,18 +494,46 @@ void MetaLogger::RemoveBlock(const std::string& filename, int32_t uuid, uint32_t
 	Store(logdata);
 }
 
-void MetaLogger::Store(const std::shared_ptr<MetaLogData> & logdata) {
+void MetaLogger::PutBlocks(const std::string& filename, int32_t uuid, time_t mtime, off_t newsize,
+		const std::vector<std::pair<uint32_t, int32_t> >& blocks, const std::string& peer, uint16_t port) {
 
-	size_t qsize = oLogDatas.push_back(logdata);
-	oTimer->notify_one();
+	if (bOk == false) {
+		return;
+	}
 
-	int nms = qsize / MAX_QSIZE; //待刷新的数据过多，需要降低 put 速度，以方便 flush 线程持久化写入
-	if (nms > 0) {
+	std::shared_ptr<MetaLogData> logdata(new MetaLogData);
+	logdata->action = MetaAction::maPutBlocks;
+	logdata->filename = filename;
+	logdata->uuid = uuid;
+	logdata->mtime = mtime;
+	logdata->newsize = newsize;
+	logdata->blocks = blocks;
+	logdata->peer = peer;
+	logdata->peer_port = port;
+
+	Store(logdata);
+}
+
+void MetaLogger::Store(const std::shared_ptr<MetaLogData> & logdata) {
+	/**
+	 * 调用者是 io 线程，不能等待；队列已满时拒绝，同 PostMessage，
+	 * 被拒绝的日志只影响重启后从日志恢复的元数据，由 log_queue_overflows 导出
+	 */
+	if (oLogDatas.qsize() >= MAX_QSIZE) {
+		if (nOverflows++ % MAX_QSIZE == 0) {
+			LOGGER_ERROR("#" << __LINE__ << ", MetaLogger::Store, " << strerror(EBUSY) << ", Rejected: " << nOverflows)
+
+			SYSLOG_ERROR("#" << __LINE__ << ", MetaLogger::Store, " << strerror(EBUSY) << ", Rejected: " << nOverflows)
+		}
 
-		LOGGER_ERROR("#" << __LINE__ << ", MetaLogger::Store, slow down: " << nms << " ms, queue overflow: " << qsize)
+		oTimer->notify_one();
+		return;
+	}
 
-		SYSLOG_ERROR("#" << __LINE__ << ", MetaLogger::Store, slow down: " << nms << " ms, queue overflow: " << qsize)
+	size_t qsize = oLogDatas.push_back(logdata);
+	oTimer->notify_one();
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(nms));
+	if (qsize > nMaxQueue) {
+		nMaxQueue = qsize;
 	}
 }
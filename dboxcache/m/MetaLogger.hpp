@@ -9,6 +9,7 @@
 #define M_METALOGGER_HPP_
 
 #include <memory>
+#include <atomic>
 #include <functional>
 #include <vector>
 
@@ -45,6 +46,11 @@ public:
 
 	int put_log(const std::string & key, const std::string & keydata);
 
+	/**
+	 * 多条记录作为一个 WriteBatch 写入
+	 */
+	int put_logs(const std::vector<std::pair<std::string, std::string> > & keydatas);
+
 	int del_logs(const std::string& key);
 
 	int iter_logs(std::function<bool(int index, const std::string & key, const std::string & val)> const & callback);
@@ -62,7 +68,8 @@ enum MetaAction {
 	maPutFile = 0, //
 	maRemoveFile = 1, //
 	maPutBlock = 2, //
-	maRemoveBlock = 3 //
+	maRemoveBlock = 3, //
+	maPutBlocks = 4 // 文件属性和多块信息，一次写入
 };
 
 struct MetaLogData {
@@ -89,6 +96,12 @@ struct MetaLogData {
 	};
 
 	std::string peer;
+
+	/**
+	 * maPutBlocks: mtime/newsize 占用了 union，块编号、版本和端口单独保存
+	 */
+	std::vector<std::pair<uint32_t, int32_t> > blocks;
+	uint16_t peer_port { 0 };
 };
 
 class MetaLogger {
@@ -110,8 +123,15 @@ protected:
 	void Store(const std::shared_ptr<MetaLogData> & data);
 
 public:
+	std::atomic<uint64_t> nMaxQueue { 0 }; //待写入队列的最大长度
+	std::atomic<uint64_t> nOverflows { 0 }; //写入时队列已满被拒绝的日志数
+
 	MetaLogger(const std::string & path);
 
+	size_t GetQueueSize() {
+		return oLogDatas.qsize();
+	}
+
 	~MetaLogger();
 
 	void Load(std::function<bool(const std::shared_ptr<MetaLogData> & logdata)> const & callback);
@@ -124,6 +144,12 @@ public:
 			const std::string & peer, uint16_t port);
 
 	void RemoveBlock(const std::string & filename, int32_t uuid, uint32_t block_offset_id, const std::string & peer);
+
+	/**
+	 * 文件属性和多块信息作为一条日志，持久化为一个 leveldb WriteBatch
+	 */
+	void PutBlocks(const std::string & filename, int32_t uuid, time_t mtime, off_t newsize,
+			const std::vector<std::pair<uint32_t, int32_t> > & blocks, const std::string & peer, uint16_t port);
 };
 
 #endif /* M_METALOGGER_HPP_ */
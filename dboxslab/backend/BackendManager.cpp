@@ -7,8 +7,12 @@
 
 //#define STATIC_BACKEND_PLUGINS
 
+#include <sys/resource.h>
+
 #include "BackendManager.hpp"
 
+#include <tier/tier_backend.hpp>
+
 #ifdef STATIC_BACKEND_PLUGINS
 #include <rados/rados_backend.hpp>
 #include <local/local_backend.hpp>
@@ -16,8 +20,142 @@
 
 #include <header.h>
 
+BackendHandleCache::BackendHandleCache(size_t capacity, size_t shards, uint32_t idle_ttl_) :
+		idle_ttl(idle_ttl_) {
+	if (capacity == 0) {
+		capacity = GetDefaultCapacity();
+	}
+
+	shards = std::max<size_t>(1, std::min(shards, capacity));
+	for (size_t i = 0; i < shards; i++) {
+		oShards.push_back(std::unique_ptr<Shard>(new Shard()));
+	}
+	nShardCapacity = std::max<size_t>(1, capacity / shards);
+
+	LOGGER_INFO(
+			"#" << __LINE__ << ", BackendHandleCache::BackendHandleCache, capacity: " << getCapacity() << ", shards: " << shards << ", idle_ttl: " << idle_ttl);
+}
+
+size_t BackendHandleCache::GetDefaultCapacity() {
+	struct rlimit rt;
+	if (getrlimit(RLIMIT_NOFILE, &rt) != 0 || rt.rlim_cur == RLIM_INFINITY) {
+		return MAXBACKENDS;
+	}
+	return std::max<size_t>(64, std::min<size_t>(MAXBACKENDS, rt.rlim_cur / 2));
+}
+
+void BackendHandleCache::Evict(Shard & shard, time_t now, std::vector<std::shared_ptr<Backend> > & released) {
+	while (shard.oEntries.size() > nShardCapacity) {
+		released.push_back(shard.oEntries.back().oBackend);
+		shard.oIndex.erase(shard.oEntries.back().filename);
+		shard.oEntries.pop_back();
+		nEvicts++;
+	}
+
+	shard.nSweepTime = now;
+	if (idle_ttl == 0) {
+		return;
+	}
+
+	while (shard.oEntries.empty() == false && shard.oEntries.back().atime + (time_t) idle_ttl < now) {
+		released.push_back(shard.oEntries.back().oBackend);
+		shard.oIndex.erase(shard.oEntries.back().filename);
+		shard.oEntries.pop_back();
+		nIdles++;
+	}
+}
+
+bool BackendHandleCache::Get(const std::string & filename, std::shared_ptr<Backend> & oBackend) {
+	Shard & shard = GetShard(filename);
+
+	std::lock_guard<std::mutex> lock(shard.mtx);
+	auto iter = shard.oIndex.find(filename);
+	if (iter == shard.oIndex.end()) {
+		nMisses++;
+		return false;
+	}
+
+	iter->second->atime = time(NULL);
+	shard.oEntries.splice(shard.oEntries.begin(), shard.oEntries, iter->second);
+	oBackend = iter->second->oBackend;
+	nHits++;
+	return true;
+}
+
+void BackendHandleCache::Put(const std::string & filename, const std::shared_ptr<Backend> & oBackend) {
+	Shard & shard = GetShard(filename);
+	time_t now = time(NULL);
+
+	std::vector<std::shared_ptr<Backend> > released; //锁外释放，后端析构可能阻塞
+	{
+		std::lock_guard<std::mutex> lock(shard.mtx);
+		auto iter = shard.oIndex.find(filename);
+		if (iter != shard.oIndex.end()) {
+			released.push_back(iter->second->oBackend);
+			iter->second->oBackend = oBackend;
+			iter->second->atime = now;
+			shard.oEntries.splice(shard.oEntries.begin(), shard.oEntries, iter->second);
+			return;
+		}
+
+		Entry entry;
+		entry.filename = filename;
+		entry.oBackend = oBackend;
+		entry.atime = now;
+		shard.oEntries.push_front(entry);
+		shard.oIndex[filename] = shard.oEntries.begin();
+
+		Evict(shard, now, released);
+	}
+}
+
+void BackendHandleCache::Erase(const std::string & filename) {
+	Shard & shard = GetShard(filename);
+
+	std::shared_ptr<Backend> oBackend; //锁外释放
+	{
+		std::lock_guard<std::mutex> lock(shard.mtx);
+		auto iter = shard.oIndex.find(filename);
+		if (iter == shard.oIndex.end()) {
+			return;
+		}
+		oBackend = iter->second->oBackend;
+		shard.oEntries.erase(iter->second);
+		shard.oIndex.erase(iter);
+	}
+}
+
+void BackendHandleCache::Sweep() {
+	if (idle_ttl == 0) {
+		return;
+	}
+
+	time_t now = time(NULL);
+	for (const std::unique_ptr<Shard> & shard : oShards) {
+		std::vector<std::shared_ptr<Backend> > released;
+		{
+			std::lock_guard<std::mutex> lock(shard->mtx);
+			if (shard->nSweepTime == now) {
+				continue;
+			}
+			Evict(*shard, now, released);
+		}
+	}
+}
+
+size_t BackendHandleCache::Size() {
+	size_t size = 0;
+	for (const std::unique_ptr<Shard> & shard : oShards) {
+		std::lock_guard<std::mutex> lock(shard->mtx);
+		size += shard->oEntries.size();
+	}
+	return size;
+}
+
 BackendManager::BackendManager(const ConfReader & conf_) :
-		oBackends( MAXBACKENDS) {
+		oBackends(std::max<int>(0, conf_.get_int("backend_handles", 0)),
+				std::max<int>(1, conf_.get_int("backend_handle_shards", BACKEND_HANDLE_SHARDS)),
+				std::max<int>(0, conf_.get_int("backend_idle_ttl", BACKEND_IDLE_TTL))) {
 
 #ifdef STATIC_BACKEND_PLUGINS
 	{
@@ -66,6 +204,7 @@ BackendManager::BackendManager(const ConfReader & conf_) :
 						"#" << __LINE__ << ", BackendManager::BackendManager, Add BackendFactory: " << oBackendFactory->Prefix() << " from " << plugin_filename)
 				oBackendFactorys[oBackendFactory->Prefix()] = oBackendFactory;
 				oPluginInfos.push_back(plugin_info);
+				LoadWriteConf(conf_, plugin_name, oBackendFactory->Prefix());
 				continue;
 			}
 
@@ -76,17 +215,85 @@ BackendManager::BackendManager(const ConfReader & conf_) :
 #endif
 
 	for (const auto & iter : oBackendFactorys) {
-		iter.second->Start();
+		StartFactory(iter.first, iter.second);
 	}
 
+	LoadTiers(conf_);
 }
 
 BackendManager::~BackendManager() {
+	/**
+	 * 分层前缀停止前上传待上传的数据，被包装的前缀需要仍然可用
+	 */
+	for (const std::string & prefix : oTierPrefixes) {
+		oBackendFactorys[prefix]->Stop();
+	}
+
 	for (const auto iter : oBackendFactorys) {
 		iter.second->Stop();
 	}
 }
 
+void BackendManager::StartFactory(const std::string & prefix,
+		const std::shared_ptr<BackendFactory> & oBackendFactory) {
+	oBackendFactory->Start();
+
+	if (oBackendFactory->getNegativeTtl() > 0 && oBackendFactory->getNegativeSize() > 0) {
+		oNegativeCaches[prefix] = std::make_shared<NegativeCache>(oBackendFactory->getNegativeSize(),
+				oBackendFactory->getNegativeTtl());
+	}
+
+	if (oBackendFactory->getQueueLimit() > 0) {
+		oBackendQueues[prefix] = std::make_shared<BackendQueue>(oBackendFactory->getQueueLimit());
+	}
+}
+
+/**
+ * 格式: backend_tier = <name>, ...，<name>_conf 为分层配置文件，其中 upper 和 lower 为两个已加载的前缀
+ */
+void BackendManager::LoadTiers(const ConfReader & conf_) {
+	std::vector<std::string> tiers;
+	conf_.get_strings("backend_tier", ",", tiers);
+
+	for (std::string & tier_name : tiers) {
+		if (tier_name.empty() == true) {
+			continue;
+		}
+
+		std::string tier_confname = conf_.get_string(tier_name + "_conf", "");
+		if (tier_confname.empty() == true) {
+			continue;
+		}
+
+		ConfReader cr;
+		cr.load(tier_confname);
+
+		std::shared_ptr<BackendFactory> oUpperFactory = GetBackendFactory(cr.get_string("upper", ""));
+		std::shared_ptr<BackendFactory> oLowerFactory = GetBackendFactory(cr.get_string("lower", ""));
+		if (oUpperFactory.get() == NULL || oLowerFactory.get() == NULL || oUpperFactory == oLowerFactory) {
+			LOGGER_WARN(
+					"#" << __LINE__ << ", BackendManager::LoadTiers, Invalid upper or lower prefix: " << tier_confname)
+			continue;
+		}
+
+		std::shared_ptr<BackendFactory> oBackendFactory(
+				new TierBackendFactory(tier_confname, oUpperFactory, oLowerFactory));
+		if (oBackendFactory->Prefix().empty() == true || oBackendFactorys.count(oBackendFactory->Prefix()) > 0) {
+			LOGGER_WARN(
+					"#" << __LINE__ << ", BackendManager::LoadTiers, Duplicated BackendFactory: " << oBackendFactory->Prefix() << " from " << tier_confname)
+			continue;
+		}
+
+		LOGGER_TRACE(
+				"#" << __LINE__ << ", BackendManager::LoadTiers, Add BackendFactory: " << oBackendFactory->Prefix() << " over " << oUpperFactory->Prefix() << ", " << oLowerFactory->Prefix())
+
+		oBackendFactorys[oBackendFactory->Prefix()] = oBackendFactory;
+		oTierPrefixes.push_back(oBackendFactory->Prefix());
+		LoadWriteConf(conf_, tier_name, oBackendFactory->Prefix());
+		StartFactory(oBackendFactory->Prefix(), oBackendFactory);
+	}
+}
+
 std::shared_ptr<BackendFactory> BackendManager::GetBackendFactory(const std::string & prefix) {
 	auto iter = oBackendFactorys.find(prefix);
 	if (iter == oBackendFactorys.end()) {
@@ -96,8 +303,15 @@ std::shared_ptr<BackendFactory> BackendManager::GetBackendFactory(const std::str
 }
 
 std::shared_ptr<Backend> BackendManager::Open(const std::string & filename, bool create_if_not_exists) {
+	/**
+	 * 为写入打开时，先清除否定缓存，已缓存的句柄同样需要
+	 */
+	if (create_if_not_exists == true) {
+		ClearNegative(filename);
+	}
+
 	std::shared_ptr<Backend> oBackend;
-	if (oBackends.get(filename, oBackend) == true) {
+	if (oBackends.Get(filename, oBackend) == true) {
 		return oBackend;
 	}
 
@@ -123,7 +337,10 @@ std::shared_ptr<Backend> BackendManager::Open(const std::string & filename, bool
 	oBackend->oBackendFactory = oFactory;
 
 	if (oBackend->isValid(create_if_not_exists)) {
-		oBackends.put(filename, oBackend, 0);
+		oBackends.Put(filename, oBackend);
+	} else if (oBackend->code == EMFILE || oBackend->code == ENFILE) {
+		LOGGER_WARN(
+				"#" << __LINE__ << ", BackendManager::Open: " << filename << ", Error: " << oBackend->message << ", handles: " << oBackends.Size() << "/" << oBackends.getCapacity())
 	}
 
 	return oBackend;
@@ -166,10 +383,17 @@ bool BackendManager::Unlink(const std::string& filename, int & code, std::string
 		return false;
 	}
 
-	oBackends.erase(filename);
+	oBackends.Erase(filename);
 
 	LOGGER_TRACE("#" << __LINE__ << ", BackendManager::Unlink: " << name);
-	if (oBackend->Unlink(name) == false) {
+	bool bOk = oBackend->Unlink(name);
+
+	/**
+	 * 删除过程中的读取可能放入了删除前的长度，完成后再清除
+	 */
+	ClearNegative(filename);
+
+	if (bOk == false) {
 		code = oBackend->code;
 		message = oBackend->message;
 		return false;
@@ -253,7 +477,14 @@ bool BackendManager::Truncate(const std::string& filename, off_t length, int & c
 	}
 
 	LOGGER_TRACE("#" << __LINE__ << ", BackendManager::Truncate: " << name);
-	if (oBackend->Truncate(name, length) == false) {
+	bool bOk = oBackend->Truncate(name, length);
+
+	/**
+	 * 截断过程中的读取可能放入了截断前的长度，完成后再清除
+	 */
+	ClearNegative(filename);
+
+	if (bOk == false) {
 		code = oBackend->code;
 		message = oBackend->message;
 		return false;
@@ -270,10 +501,18 @@ bool BackendManager::GetAttr(const std::string& filename, struct stat* st, int &
 		return false;
 	}
 
+	if (GetNegative(filename, -1, code) == true) {
+		message = strerror(code);
+		return false;
+	}
+
 	LOGGER_TRACE("#" << __LINE__ << ", BackendManager::GetAttr: " << name);
 	if (oBackend->GetAttr(name, st) == false) {
 		code = oBackend->code;
 		message = oBackend->message;
+		if (code == ENOENT) {
+			PutNegative(filename, -1);
+		}
 		return false;
 	}
 
@@ -283,6 +522,8 @@ bool BackendManager::GetAttr(const std::string& filename, struct stat* st, int &
 		return false;
 	}
 
+	PutNegative(filename, st->st_size);
+
 	return true;
 }
 
@@ -302,7 +543,7 @@ bool BackendManager::GetBackend(const std::string& filename, std::string & prefi
 	}
 
 	name = FileSystemUtils::NormalizePath(name);
-	if (oBackends.get(filename, oBackend) == true) {
+	if (oBackends.Get(filename, oBackend) == true) {
 		return true;
 	}
 
@@ -317,6 +558,62 @@ bool BackendManager::GetBackend(const std::string& filename, std::string & prefi
 	return true;
 }
 
+/**
+ * 格式: <plugin>_write_policy = write-through | write-back | write-around，
+ * <plugin>_flush_merge_blocks, <plugin>_flush_delay, <plugin>_read_merge_kb
+ */
+void BackendManager::LoadWriteConf(const ConfReader & conf_, const std::string & plugin_name,
+		const std::string & prefix) {
+	WriteConf oWriteConf;
+
+	std::string policy = conf_.get_string(plugin_name + "_write_policy", "");
+	if (policy == "write-through") {
+		oWriteConf.policy = WritePolicy::wpWriteThrough;
+	} else if (policy == "write-back") {
+		oWriteConf.policy = WritePolicy::wpWriteBack;
+	} else if (policy == "write-around") {
+		oWriteConf.policy = WritePolicy::wpWriteAround;
+	} else if (policy.empty() == false && policy != "client") {
+		LOGGER_WARN(
+				"#" << __LINE__ << ", BackendManager::LoadWriteConf, Invalid write policy: " << policy << " for " << plugin_name)
+	}
+
+	oWriteConf.flush_merge_blocks = std::max<int>(0, conf_.get_int(plugin_name + "_flush_merge_blocks", 0));
+	oWriteConf.flush_delay = std::max<int>(0, conf_.get_int(plugin_name + "_flush_delay", 0));
+	oWriteConf.read_merge_kb = std::max<int>(0, conf_.get_int(plugin_name + "_read_merge_kb", 0));
+
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", BackendManager::LoadWriteConf: " << prefix << ", policy: " << GetWritePolicyName(oWriteConf.policy))
+
+	oWriteConfs[prefix] = oWriteConf;
+}
+
+const WriteConf & BackendManager::GetWriteConf(const std::string& filename) {
+	std::string::size_type pos = filename.find("://");
+	if (pos == std::string::npos || filename.find( MEM_PREFIX) == 0) {
+		return oDefaultWriteConf;
+	}
+
+	auto iter = oWriteConfs.find(filename.substr(0, pos));
+	if (iter == oWriteConfs.end()) {
+		return oDefaultWriteConf;
+	}
+	return iter->second;
+}
+
+const char * BackendManager::GetWritePolicyName(WritePolicy policy) {
+	switch (policy) {
+	case WritePolicy::wpWriteThrough:
+		return "write_through";
+	case WritePolicy::wpWriteBack:
+		return "write_back";
+	case WritePolicy::wpWriteAround:
+		return "write_around";
+	default:
+		return "client";
+	}
+}
+
 bool BackendManager::IsValid(const std::string& filename) {
 	if (filename.find( MEM_PREFIX) == 0) { //内存文件
 		return true;
@@ -342,7 +639,20 @@ bool BackendManager::IsValid(const std::string& filename) {
 }
 
 void BackendManager::Close(const std::string& filename) {
-	oBackends.erase(filename);
+	oBackends.Erase(filename);
+}
+
+void BackendManager::SweepBackends() {
+	oBackends.Sweep();
+}
+
+void BackendManager::GetHandleMetrics(std::map<std::string, uint64_t>& metrics) {
+	metrics["backend_handles"] = oBackends.Size();
+	metrics["backend_handle_capacity"] = oBackends.getCapacity();
+	metrics["backend_handle_hits"] = oBackends.nHits;
+	metrics["backend_handle_misses"] = oBackends.nMisses;
+	metrics["backend_handle_evicts"] = oBackends.nEvicts;
+	metrics["backend_handle_idles"] = oBackends.nIdles;
 }
 
 bool BackendManager::IsReadOnly(const std::string& filename) {
@@ -368,3 +678,131 @@ bool BackendManager::IsReadOnly(const std::string& filename) {
 
 	return oFactory->isReadOnly();
 }
+
+std::shared_ptr<NegativeCache> BackendManager::GetNegativeCache(const std::string& filename) {
+	std::string::size_type pos = filename.find("://");
+	if (pos == std::string::npos) {
+		return std::shared_ptr<NegativeCache>();
+	}
+
+	auto iter = oNegativeCaches.find(filename.substr(0, pos));
+	if (iter == oNegativeCaches.end()) {
+		return std::shared_ptr<NegativeCache>();
+	}
+	return iter->second;
+}
+
+bool BackendManager::GetNegative(const std::string& filename, off_t offset, int & code) {
+	std::shared_ptr<NegativeCache> oNegativeCache = GetNegativeCache(filename);
+	if (oNegativeCache.get() == NULL) {
+		return false;
+	}
+
+	off_t eof;
+	if (oNegativeCache->Get(filename, eof) == false) {
+		return false;
+	}
+
+	if (eof < 0) {
+		code = ENOENT;
+	} else if (offset >= 0 && offset >= eof) {
+		code = 0;
+	} else {
+		return false;
+	}
+
+	oNegativeCache->nHits++;
+	return true;
+}
+
+void BackendManager::PutNegative(const std::string& filename, off_t eof) {
+	std::shared_ptr<NegativeCache> oNegativeCache = GetNegativeCache(filename);
+	if (oNegativeCache.get() != NULL) {
+		oNegativeCache->Put(filename, eof);
+	}
+}
+
+void BackendManager::ClearNegative(const std::string& filename) {
+	std::shared_ptr<NegativeCache> oNegativeCache = GetNegativeCache(filename);
+	if (oNegativeCache.get() != NULL) {
+		oNegativeCache->Erase(filename);
+	}
+}
+
+void BackendManager::GetNegativeMetrics(std::map<std::string, uint64_t>& metrics) {
+	for (const auto & iter : oNegativeCaches) {
+		metrics["negative_hits_" + iter.first] = iter.second->nHits;
+		metrics["negative_puts_" + iter.first] = iter.second->nPuts;
+	}
+}
+
+std::shared_ptr<BackendQueue> BackendManager::GetBackendQueue(const std::string& filename) {
+	std::string::size_type pos = filename.find("://");
+	if (pos == std::string::npos) {
+		return std::shared_ptr<BackendQueue>();
+	}
+
+	auto iter = oBackendQueues.find(filename.substr(0, pos));
+	if (iter == oBackendQueues.end()) {
+		return std::shared_ptr<BackendQueue>();
+	}
+	return iter->second;
+}
+
+void BackendManager::GetQueueMetrics(std::map<std::string, uint64_t>& metrics) {
+	for (const auto & iter : oBackendQueues) {
+		uint32_t inflight = 0;
+		uint32_t waiting = 0;
+		iter.second->GetDepth(inflight, waiting);
+
+		metrics["queue_inflight_" + iter.first] = inflight;
+		metrics["queue_waiting_" + iter.first] = waiting;
+		metrics["queue_max_waiting_" + iter.first] = iter.second->nMaxWaiting;
+		metrics["queue_parked_" + iter.first] = iter.second->nParked;
+	}
+
+	for (const auto & iter : oBackendFactorys) {
+		AsyncWriters & oWorkerPool = iter.second->getWorkerPool();
+
+		metrics["worker_threads_" + iter.first] = oWorkerPool.getWorkers();
+		metrics["worker_pending_" + iter.first] = oWorkerPool.getPending();
+		metrics["worker_waiting_" + iter.first] = oWorkerPool.getWaiting();
+		metrics["worker_parked_" + iter.first] = oWorkerPool.nParked;
+		metrics["worker_shutdowns_" + iter.first] = oWorkerPool.nShutdowns;
+		metrics["worker_calls_" + iter.first] = oWorkerPool.nCompleted;
+
+		iter.second->GetMetrics(metrics);
+	}
+}
+
+bool BackendManager::Submit(const std::string& filename, const std::function<void(void)> & callback) {
+	std::string prefix;
+	std::string name;
+
+	if (Parse(filename, prefix, name) == false) {
+		return false;
+	}
+
+	std::shared_ptr<BackendFactory> oFactory = GetBackendFactory(prefix);
+	if (oFactory.get() == NULL) {
+		return false;
+	}
+
+	return oFactory->Submit(callback);
+}
+
+uint32_t BackendManager::GetFlushConcurrency(const std::string& filename) {
+	std::string prefix;
+	std::string name;
+
+	if (Parse(filename, prefix, name) == false) {
+		return 1;
+	}
+
+	std::shared_ptr<BackendFactory> oFactory = GetBackendFactory(prefix);
+	if (oFactory.get() == NULL) {
+		return 1;
+	}
+
+	return oFactory->getFlushConcurrency();
+}
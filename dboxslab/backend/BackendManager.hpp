@@ -8,8 +8,18 @@
 #ifndef BACKEND_MANAGER_HPP_
 #define BACKEND_MANAGER_HPP_
 
+#include <time.h>
+
 #include <string>
 #include <map>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
 
 #include <databox/cpl_conf.hpp>
 #include <databox/filesystemutils.hpp>
@@ -22,7 +32,185 @@
 using CreateBackend =std::shared_ptr<BackendFactory> (*) ( const std::string & conf );
 
 #define MAXBACKENDS 1024 * 64
-//最大可打开backend句柄数
+//最大可打开backend句柄数，backend_handles = 0 时按 RLIMIT_NOFILE 计算，不超过该值
+
+#define BACKEND_HANDLE_SHARDS 16
+#define BACKEND_IDLE_TTL 300
+
+/**
+ * 一个后端前缀的否定缓存，记录不存在的文件和文件结束位置，有效期内不再访问后端存储
+ */
+class NegativeCache {
+private:
+	cache::concurrent_lru_cache_count_num<off_t> oEntries; //文件结束位置，-1 为文件不存在
+	uint32_t ttl;
+public:
+	std::atomic<uint64_t> nHits { 0 };
+	std::atomic<uint64_t> nPuts { 0 };
+
+	NegativeCache(uint32_t size, uint32_t ttl_) :
+			oEntries(size), ttl(ttl_) {
+	}
+
+	bool Get(const std::string & filename, off_t & eof) {
+		return oEntries.get(filename, eof);
+	}
+
+	void Put(const std::string & filename, off_t eof) {
+		nPuts++;
+		oEntries.put(filename, eof, ttl);
+	}
+
+	void Erase(const std::string & filename) {
+		oEntries.erase(filename);
+	}
+};
+
+/**
+ * 打开的后端句柄缓存，按文件名哈希分片，每片一把锁和一个 LRU，不同文件的打开不争用同一把锁
+ * 超过容量或空闲超过 idle_ttl 秒的句柄从缓存中移除，最后一个引用释放时由后端析构关闭
+ */
+class BackendHandleCache {
+private:
+	struct Entry {
+		std::string filename;
+		std::shared_ptr<Backend> oBackend;
+		time_t atime { 0 }; //最近访问时间
+	};
+
+	struct Shard {
+		std::mutex mtx;
+		std::list<Entry> oEntries; //最近访问的在前，mtx 保护
+		std::unordered_map<std::string, std::list<Entry>::iterator> oIndex; //mtx 保护
+		time_t nSweepTime { 0 }; //mtx 保护
+	};
+
+	std::vector<std::unique_ptr<Shard> > oShards;
+	size_t nShardCapacity;
+	uint32_t idle_ttl;
+
+protected:
+	Shard & GetShard(const std::string & filename) {
+		return *oShards[std::hash<std::string>()(filename) % oShards.size()];
+	}
+
+	/**
+	 * 从 LRU 尾部移除超过容量和空闲超时的句柄，移到 released 中在锁外释放，需持有 shard.mtx
+	 */
+	void Evict(Shard & shard, time_t now, std::vector<std::shared_ptr<Backend> > & released);
+
+public:
+	std::atomic<uint64_t> nHits { 0 };
+	std::atomic<uint64_t> nMisses { 0 };
+	std::atomic<uint64_t> nEvicts { 0 }; //超过容量移除
+	std::atomic<uint64_t> nIdles { 0 }; //空闲超时移除
+
+	/**
+	 * capacity = 0 时按 RLIMIT_NOFILE 计算，idle_ttl = 0 为不按空闲时间移除
+	 */
+	BackendHandleCache(size_t capacity, size_t shards, uint32_t idle_ttl);
+
+	bool Get(const std::string & filename, std::shared_ptr<Backend> & oBackend);
+
+	void Put(const std::string & filename, const std::shared_ptr<Backend> & oBackend);
+
+	void Erase(const std::string & filename);
+
+	/**
+	 * 移除所有分片中空闲超时的句柄，定时调用，没有访问的分片也会关闭空闲句柄
+	 */
+	void Sweep();
+
+	size_t Size();
+
+	size_t getCapacity() const {
+		return nShardCapacity * oShards.size();
+	}
+
+	/**
+	 * 软限制 RLIMIT_NOFILE 的一半，其余留给网络连接、交换文件和日志
+	 */
+	static size_t GetDefaultCapacity();
+};
+
+/**
+ * 一个后端前缀的刷新写入队列，同时进行的写入不超过 limit
+ * 没有空位时登记继续执行的回调并返回，不阻塞工作线程，其他写入完成时把空位直接交给等待者
+ */
+class BackendQueue {
+private:
+	std::mutex mtx;
+	uint32_t limit;
+	uint32_t nInflight { 0 }; //mtx 保护
+	std::deque<std::function<void(void)> > oWaitings; //mtx 保护
+public:
+	std::atomic<uint64_t> nParked { 0 };
+	std::atomic<uint64_t> nMaxWaiting { 0 };
+
+	BackendQueue(uint32_t limit_) :
+			limit(limit_) {
+	}
+
+	/**
+	 * 获得空位返回 true；否则登记 resume 并返回 false，其他写入完成后调用 resume（已持有空位）
+	 * 持有空位的写入完成后必须调用 Release
+	 */
+	bool Acquire(const std::function<void(void)> & resume) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (nInflight < limit) {
+			nInflight++;
+			return true;
+		}
+
+		oWaitings.push_back(resume);
+		nParked++;
+		if (oWaitings.size() > nMaxWaiting) {
+			nMaxWaiting = oWaitings.size();
+		}
+		return false;
+	}
+
+	void Release() {
+		std::function<void(void)> resume;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (oWaitings.empty() == true) {
+				nInflight--;
+				return;
+			}
+			resume = oWaitings.front();
+			oWaitings.pop_front();
+		}
+		resume();
+	}
+
+	void GetDepth(uint32_t & inflight, uint32_t & waiting) {
+		std::lock_guard<std::mutex> lock(mtx);
+		inflight = nInflight;
+		waiting = oWaitings.size();
+	}
+};
+
+/**
+ * 后端前缀的写入策略，在 dboxslab.conf 中按插件配置: <plugin>_write_policy
+ */
+enum WritePolicy {
+	wpClient = 0, //由客户端请求的 write_async 决定
+	wpWriteThrough = 1, //同步写入后端存储，同时缓存
+	wpWriteBack = 2, //只写入缓存，延迟批量刷新到后端存储
+	wpWriteAround = 3, //直接写入后端存储，不缓存，其他节点的缓存失效
+	wpCount = 4
+};
+
+/**
+ * 一个后端前缀的读写配置
+ */
+struct WriteConf {
+	WritePolicy policy { WritePolicy::wpClient };
+	uint32_t flush_merge_blocks { 0 }; //刷新时合并为一次后端写入的最大块数，0 为 FLUSH_MERGE_BLOCKS
+	uint32_t flush_delay { 0 }; //异步写入后延迟刷新的时间，秒，0 为 TIMER_FLUSH_TTL
+	uint32_t read_merge_kb { 0 }; //相邻未命中块合并为一次后端读取的最大长度，KB，0 为 READ_MERGE_BLOCKS 块
+};
 
 /**
  * TODO 针对相同文件的多并发快速操作会有问题
@@ -36,11 +224,31 @@ private:
 	std::shared_ptr<Backend> oNullBackend;
 	std::shared_ptr<BackendFactory> oNullFactory;
 
-	cache::concurrent_lru_cache_count_num<std::shared_ptr<Backend> > oBackends;
+	BackendHandleCache oBackends;
+
+	std::map<std::string, std::shared_ptr<NegativeCache> > oNegativeCaches; //按前缀，构造后只读
+	std::map<std::string, WriteConf> oWriteConfs; //按前缀，构造后只读
+	std::map<std::string, std::shared_ptr<BackendQueue> > oBackendQueues; //按前缀，构造后只读
+	std::vector<std::string> oTierPrefixes; //分层前缀，先于被包装的前缀停止
+	WriteConf oDefaultWriteConf;
 protected:
+	std::shared_ptr<NegativeCache> GetNegativeCache(const std::string & filename);
+
 	bool GetBackend(const std::string& filename, std::string & prefix, std::string & name,
 			std::shared_ptr<Backend>& oBackend, int & code, std::string& message);
 
+	void LoadWriteConf(const ConfReader & conf_, const std::string & plugin_name, const std::string & prefix);
+
+	/**
+	 * 启动后端线程池，建立否定缓存和刷新写入队列
+	 */
+	void StartFactory(const std::string & prefix, const std::shared_ptr<BackendFactory> & oBackendFactory);
+
+	/**
+	 * 所有插件加载并启动后，按 backend_tier 创建包装两个已有前缀的分层前缀
+	 */
+	void LoadTiers(const ConfReader & conf_);
+
 public:
 
 	BackendManager(const ConfReader & conf_);
@@ -74,6 +282,62 @@ public:
 
 	void Close(const std::string & filename);
 
+	/**
+	 * 关闭空闲超时的后端句柄
+	 */
+	void SweepBackends();
+
+	/**
+	 * 后端句柄缓存的命中、未命中、移除计数
+	 */
+	void GetHandleMetrics(std::map<std::string, uint64_t> & metrics);
+
+	/**
+	 * 否定缓存命中返回 true，文件不存在时 code = ENOENT，offset 不小于文件结束位置时 code = 0
+	 * offset < 0 时只检查文件是否不存在
+	 */
+	bool GetNegative(const std::string & filename, off_t offset, int & code);
+
+	/**
+	 * 记录文件结束位置，eof = -1 为文件不存在
+	 */
+	void PutNegative(const std::string & filename, off_t eof);
+
+	/**
+	 * 写入、截取、删除文件时清除否定缓存
+	 */
+	void ClearNegative(const std::string & filename);
+
+	void GetNegativeMetrics(std::map<std::string, uint64_t> & metrics);
+
+	/**
+	 * 文件所在前缀的刷新写入队列，没有限制时为空
+	 */
+	std::shared_ptr<BackendQueue> GetBackendQueue(const std::string & filename);
+
+	/**
+	 * 刷新写入队列和每个前缀后端线程池的深度
+	 */
+	void GetQueueMetrics(std::map<std::string, uint64_t> & metrics);
+
+	/**
+	 * 在文件所在前缀的后端线程池中执行，没有对应后端、线程池未启动或已停止时返回 false
+	 * 停止时仍未执行的调用在停止线程中执行
+	 */
+	bool Submit(const std::string & filename, const std::function<void(void)> & callback);
+
+	/**
+	 * 文件所在前缀的刷新并发数，没有对应后端时为 1
+	 */
+	uint32_t GetFlushConcurrency(const std::string & filename);
+
+	/**
+	 * 文件所在前缀的写入配置，内存文件和没有配置的前缀为 wpClient
+	 */
+	const WriteConf & GetWriteConf(const std::string & filename);
+
+	static const char * GetWritePolicyName(WritePolicy policy);
+
 };
 
 #endif /* BACKEND_MANAGER_HPP_ */
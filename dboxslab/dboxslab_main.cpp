@@ -33,6 +33,13 @@ int run_master(int argc, char **argv, std::shared_ptr<SlabServerData> server_dat
 	ConfReader conf_;
 	conf_.load(cnf_file);
 
+	server_data->hedge_percentile = conf_.get_int("hedge_percentile", server_data->hedge_percentile);
+	server_data->hedge_min_usec = conf_.get_int("hedge_min_usec", server_data->hedge_min_usec);
+
+	server_data->journal_path = conf_.get_string("journal_path", server_data->journal_path);
+	server_data->journal_sync = conf_.get_int("journal_sync", server_data->journal_sync ? 1 : 0) != 0;
+	server_data->journal_segment_mb = conf_.get_int("journal_segment_mb", server_data->journal_segment_mb);
+
 	LOGGER_INFO(
 			"#" << __LINE__ << ", run_master, memory_size: " << server_data->max_memory_slabs << ", swap_size: " << server_data->max_swap_slabs << ", swap_path: " << server_data->swap_path);
 
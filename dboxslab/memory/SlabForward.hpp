@@ -11,6 +11,11 @@
 #include <functional>
 #include <mutex>
 #include <memory>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
 
 // 默认管理 1024 * 1 内存块，每块 256 KB，共 256 MB
 // 对应 CacheClient.hpp 里面需要一致
@@ -79,6 +84,74 @@ public:
 	 */
 	virtual int Read(uint64_t offset, uint32_t block_offset_id, size_t size, std::string & ptr_dst) = 0;
 
+	/**
+	 * 只有部分数据的块合并后端存储读取的完整块数据，已写入的区间保持不变，合并后不再是部分块
+	 * 内部加锁，多线程安全
+	 */
+	virtual int MergeBlock(const char* ptr_src, size_t size) = 0;
+
+	/**
+	 * 写入时没有从后端加载数据，块中只有写入的区间有效，需要在写入之前设置
+	 */
+	void SetPartial() {
+		std::lock_guard<std::mutex> lock(mtx);
+		this->bPartial = true;
+		this->oValidRanges.clear();
+	}
+
+	/**
+	 * 是否只有部分数据，读取之前需要合并后端数据
+	 */
+	bool IsPartial() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return this->bPartial;
+	}
+
+	/**
+	 * 合并区间 [start, end) 到区间表，相交或相邻的区间合并为一个
+	 */
+	static void AddRange(std::map<uint32_t, uint32_t> & ranges, uint32_t start, uint32_t end) {
+		if (start >= end) {
+			return;
+		}
+
+		auto iter = ranges.upper_bound(start);
+		if (iter != ranges.begin()) {
+			auto prev = std::prev(iter);
+			if (prev->second >= start) {
+				start = prev->first;
+				end = std::max(end, prev->second);
+				iter = ranges.erase(prev);
+			}
+		}
+
+		while (iter != ranges.end() && iter->first <= end) {
+			end = std::max(end, iter->second);
+			iter = ranges.erase(iter);
+		}
+
+		ranges[start] = end;
+	}
+
+	/**
+	 * 取出已修改未刷新的区间 [start, end)，刷新时只写入这些区间
+	 */
+	void TakeDirtyRanges(std::vector<std::pair<uint32_t, uint32_t> > & ranges) {
+		std::lock_guard<std::mutex> lock(mtx);
+		ranges.assign(this->oDirtyRanges.begin(), this->oDirtyRanges.end());
+		this->oDirtyRanges.clear();
+	}
+
+	/**
+	 * 刷新失败时放回取出的区间
+	 */
+	void RestoreDirtyRanges(const std::vector<std::pair<uint32_t, uint32_t> > & ranges) {
+		std::lock_guard<std::mutex> lock(mtx);
+		for (const auto & range : ranges) {
+			AddRange(this->oDirtyRanges, range.first, range.second);
+		}
+	}
+
 //	void ClearDirty() {
 //		this->bDirty = false;
 //	}
@@ -129,6 +202,63 @@ public:
 	virtual void SetEditable(bool t) = 0;
 
 protected:
+	/**
+	 * 修改数据时调用，记录修改的区间，部分块同时记录有效区间，已经持有 mtx
+	 */
+	void AddDirtyRange(uint32_t start, uint32_t end) {
+		AddRange(this->oDirtyRanges, start, end);
+
+		if (this->bPartial == true) {
+			AddRange(this->oValidRanges, start, end);
+
+			auto iter = this->oValidRanges.begin();
+			if (iter->first == 0 && iter->second >= SIZEOFBLOCK) { //整块都已写入
+				this->bPartial = false;
+				this->oValidRanges.clear();
+			}
+		}
+	}
+
+	/**
+	 * 合并时需要填充的区间，即 [0, max(size, used_size)) 中没有写入过的部分，已经持有 mtx
+	 * size 为后端数据长度，size 之后的空白在后端文件结束位置之后，由调用者填零
+	 */
+	void GetMergeGaps(size_t size, std::vector<std::pair<uint32_t, uint32_t> > & gaps) const {
+		uint32_t end = std::max<size_t>(size, this->used_size);
+
+		uint32_t pos = 0;
+		for (const auto & range : this->oValidRanges) {
+			if (range.first >= end) {
+				break;
+			}
+			if (range.first > pos) {
+				gaps.push_back(std::make_pair(pos, range.first));
+			}
+			pos = std::max(pos, range.second);
+		}
+		if (pos < end) {
+			gaps.push_back(std::make_pair(pos, end));
+		}
+	}
+
+	/**
+	 * 根据数据序列的偏移位置计算当前块中的区间，slab_offset 为块中偏移，buff_offset 为数据中偏移
+	 */
+	static void GetSlabRange(uint64_t offset, uint32_t block_offset_id, size_t data_size, int & slab_offset,
+			int & slab_length, int & buff_offset) {
+		uint32_t block0_offset_id = offset / SIZEOFBLOCK;
+
+		slab_offset = offset - (block0_offset_id * SIZEOFBLOCK); //第一块内存块中偏移
+		slab_length = std::min<int>(data_size, SIZEOFBLOCK - slab_offset); //第一块内存块中剩余长度
+		buff_offset = 0; //第一块源数据中的偏移位置
+
+		if (block_offset_id > block0_offset_id) { //第一块以后
+			slab_offset = 0; //其他内存块中偏移
+			buff_offset = slab_length + (block_offset_id - block0_offset_id - 1) * SIZEOFBLOCK; //第一块内存块中剩余长度 + 之间完整块长度
+			slab_length = std::min<int>(data_size - buff_offset, SIZEOFBLOCK);
+		}
+	}
+
 //	std::atomic<bool> bDirty { false }; //是否数据被修改
 	std::atomic<bool> bEditable { false }; //是否需要修改
 
@@ -138,6 +268,10 @@ protected:
 	size_t used_size { 0 }; //当前块的使用大小
 	std::atomic<int32_t> version { 1 }; //存在多线程设置该值，需要保证原子操作
 
+	bool bPartial { false }; //只有部分数据，mtx 保护
+	std::map<uint32_t, uint32_t> oDirtyRanges; //已修改未刷新的区间 [start, end)，mtx 保护
+	std::map<uint32_t, uint32_t> oValidRanges; //部分块中已写入的区间，mtx 保护
+
 	std::mutex mtx;
 };
 
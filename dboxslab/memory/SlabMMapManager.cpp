@@ -322,6 +322,77 @@ int SlabMMapBlock::Write(uint64_t offset, uint32_t block_offset_id, const std::s
 	version = oSlabMemBlock->GetVersion();
 //	bDirty = true;
 
+	if (bytes > 0) {
+		/**
+		 * 修改区间记录在磁盘块上，内存块可能被 gc 替换
+		 */
+		int slab_offset, slab_length, buff_offset;
+		GetSlabRange(offset, block_offset_id, data.size(), slab_offset, slab_length, buff_offset);
+		this->AddDirtyRange(slab_offset, slab_offset + bytes);
+	}
+
+	if (oNewSlabBlock.get() != NULL) {
+		oNewSlabBlock->Commit();
+	}
+
+	return bytes;
+}
+
+/**
+ * 有效区间记录在磁盘块上，空白区间通过内存块的 WriteBlock 写入，version 不变
+ * 存在多线程调用，加锁
+ */
+int SlabMMapBlock::MergeBlock(const char* ptr_src, size_t size) {
+	std::lock_guard<std::mutex> lock(mtx); //防止多线读写冲突
+	if (this->IsValid() == false) { //  可能 Clone 已经调用，将自己 gc 或 free 了
+		return -1;
+	}
+
+	if (this->bPartial == false) {
+		return 0;
+	}
+
+	std::shared_ptr<SlabBlock> oNewSlabBlock = CheckForIO();
+	if (oSlabMemBlock.get() == NULL) {
+		return -1;
+	}
+
+	size = std::min<size_t>(size, SIZEOFBLOCK);
+
+	std::vector<std::pair<uint32_t, uint32_t> > gaps;
+	this->GetMergeGaps(size, gaps);
+
+	int bytes = 0;
+	for (const auto & gap : gaps) {
+		/**
+		 * 后端数据之后的空白填零，不能留下磁盘块之前的内容
+		 */
+		uint32_t copy_end = std::min<size_t>(gap.second, size);
+		if (copy_end > gap.first) {
+			int written = oSlabMemBlock->WriteBlock(ptr_src + gap.first, copy_end - gap.first, gap.first);
+			if (written < 0) {
+				ResetSlabMem();
+				return written;
+			}
+			bytes += written;
+		}
+
+		uint32_t zero_start = std::max<size_t>(gap.first, size);
+		if (gap.second > zero_start) {
+			const std::string zeros(gap.second - zero_start, '\0');
+			int written = oSlabMemBlock->WriteBlock(zeros.c_str(), zeros.size(), zero_start);
+			if (written < 0) {
+				ResetSlabMem();
+				return written;
+			}
+			bytes += written;
+		}
+	}
+
+	used_size = oSlabMemBlock->GetUsedSize();
+	this->bPartial = false;
+	this->oValidRanges.clear();
+
 	if (oNewSlabBlock.get() != NULL) {
 		oNewSlabBlock->Commit();
 	}
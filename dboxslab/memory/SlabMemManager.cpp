@@ -221,17 +221,8 @@ int SlabMemBlock::Write(uint64_t offset, uint32_t block_offset_id, const std::st
 
 	const char * data_ptr = data.c_str();
 
-	uint32_t block0_offset_id = offset / SIZEOFBLOCK;
-
-	int slab_offset = offset - (block0_offset_id * SIZEOFBLOCK); //第一块内存块中偏移
-	int slab_length = std::min<int>(data_size, SIZEOFBLOCK - slab_offset); //第一块内存块中剩余长度
-	int buff_offset = 0; //第一块源数据中的偏移位置
-
-	if (block_offset_id > block0_offset_id) { //第一块以后
-		slab_offset = 0; //其他内存块中偏移
-		buff_offset = slab_length + (block_offset_id - block0_offset_id - 1) * SIZEOFBLOCK; //第一块内存块中剩余长度 + 之间完整块长度
-		slab_length = std::min<int>(data_size - buff_offset, SIZEOFBLOCK);
-	}
+	int slab_offset, slab_length, buff_offset;
+	GetSlabRange(offset, block_offset_id, data_size, slab_offset, slab_length, buff_offset);
 
 	if (slab_offset < 0 || slab_length <= 0) {
 		return 0;
@@ -243,6 +234,7 @@ int SlabMemBlock::Write(uint64_t offset, uint32_t block_offset_id, const std::st
 	memcpy(ptr_dst, ptr_src, slab_length);
 
 	this->used_size = std::max<size_t>(this->used_size, slab_offset + slab_length);
+	this->AddDirtyRange(slab_offset, slab_offset + slab_length);
 
 	this->version++;
 //	this->bDirty = true;
@@ -250,6 +242,49 @@ int SlabMemBlock::Write(uint64_t offset, uint32_t block_offset_id, const std::st
 	return slab_length;
 }
 
+/**
+ * 只复制没有写入过的区间，version 不变
+ * 存在多线程调用，加锁
+ */
+int SlabMemBlock::MergeBlock(const char* ptr_src, size_t size) {
+	std::lock_guard<std::mutex> lock(mtx); //防止多线读写冲突
+	if (this->IsValid() == false) { //  可能 Clone 已经调用，将自己 gc 或 free 了
+		return -1;
+	}
+
+	if (this->bPartial == false) {
+		return 0;
+	}
+
+	size = std::min<size_t>(size, SIZEOFBLOCK);
+
+	std::vector<std::pair<uint32_t, uint32_t> > gaps;
+	this->GetMergeGaps(size, gaps);
+
+	int bytes = 0;
+	for (const auto & gap : gaps) {
+		/**
+		 * 后端数据之后的空白填零，不能留下内存块之前的内容
+		 */
+		uint32_t copy_end = std::min<size_t>(gap.second, size);
+		if (copy_end > gap.first) {
+			memcpy(this->pBuffer + gap.first, ptr_src + gap.first, copy_end - gap.first);
+		}
+
+		uint32_t zero_start = std::max<size_t>(gap.first, size);
+		if (gap.second > zero_start) {
+			memset(this->pBuffer + zero_start, 0, gap.second - zero_start);
+		}
+		bytes += gap.second - gap.first;
+	}
+
+	this->used_size = std::max<size_t>(this->used_size, size);
+	this->bPartial = false;
+	this->oValidRanges.clear();
+
+	return bytes;
+}
+
 void SlabMemBlock::SetCallback(
 		const std::function<void(const std::shared_ptr<SlabMemBlock> & oSlabBlock)> & callback_) {
 	std::lock_guard<std::mutex> lock(mtx); //防止多线读写冲突
@@ -75,6 +75,11 @@ public:
 	 */
 	int Write(uint64_t offset, uint32_t block_offset_id, const std::string & data);
 
+	/**
+	 * 合并后端存储读取的完整块数据，只复制没有写入过的区间
+	 */
+	int MergeBlock(const char* ptr_src, size_t size);
+
 	/**
 	 * 在内存块上读取数据，version 不会变化
 	 * ptr_dst 待读取的数据缓存
@@ -1,3 +1,5 @@
+class SlabHedge;
+
 class SlabChainOp: public std::enable_shared_from_this<SlabChainOp> {
 protected:
 	std::shared_ptr<SlabFileManager> oSlabFileManager;
@@ -9,15 +11,17 @@ protected:
 
 	std::string filename;
 	off_t offset;
-	/**
-	 * 用于从后端读取数据的缓存
-	 */
-	std::shared_array_ptr<char> read_buffer;
-
-	bool bBackendMore { true };
 
 	std::list<uint32_t> oBlockOffsetIds;
-	std::map<uint32_t, SlabMeta> oSlabOffsetMetas;
+
+	std::mutex mtx_metas;
+	std::map<uint32_t, SlabMeta> oSlabOffsetMetas; //各块的元数据，各块并行读写时 mtx_metas 保护
+
+	/**
+	 * 各块开始读取前元数据中有邻居的块，读取开始时邻居会被取出，合并读取按该快照判断，mtx_metas 保护
+	 */
+	bool bPeerSnapshot { false };
+	std::set<uint32_t> oPeerBlockIds;
 
 	uint32_t iFisrtBlockOffsetId { 0 }; //开头一块编号
 	uint32_t iLastBlockOffsetId { 0 }; //最后一块编号
@@ -25,6 +29,22 @@ protected:
 	std::shared_ptr<boost::asio::io_context::strand> io_strand;
 	std::shared_ptr<SlabBlock> oNullSlabBlock;
 
+	std::mutex mtx_report;
+	std::map<uint32_t, int32_t> oReportVersions; //待汇报给元数据服务器的块版本，可能被多线程修改
+
+	/**
+	 * 读取请求为 true，后端读取未命中时把后面连续未命中的块合并为一次读取
+	 */
+	bool bMergeRead { false };
+
+	/**
+	 * 后端读取到文件不存在或结束位置时放入否定缓存，写入请求的预读为 false，避免写入后缓存的仍是写入前的长度
+	 */
+	bool bPutNegative { true };
+
+	std::mutex mtx_merged;
+	std::set<uint32_t> oMergedBlockIds; //本次请求合并读取加载的块，mtx_merged 保护
+
 public:
 
 	typedef std::function<void(int state, const std::string & message, std::shared_ptr<SlabBlock> oSlabBlock)> SlabCallback;
@@ -52,6 +72,36 @@ public:
 
 protected:
 
+	/**
+	 * 一块在元数据中的版本和是否需要汇报，没有该块的元数据时 version 为 0
+	 */
+	void GetSlabMeta(uint32_t block_offset_id, int32_t & version, bool & bReport);
+
+	/**
+	 * 元数据中该块是否还有邻居
+	 */
+	bool HasSlabPeers(uint32_t block_offset_id);
+
+	/**
+	 * 记录有邻居的块，并行读取投递各块之前调用，顺序读取在第一次合并时调用
+	 */
+	void SnapshotSlabPeers();
+
+	/**
+	 * 该块的起始位置不小于已知的后端文件长度，不需要读取后端存储
+	 */
+	bool BeyondBackendEnd(uint32_t block_offset_id);
+
+	/**
+	 * 记录本地块版本，稍后与其他块一起汇报给元数据服务器
+	 */
+	void ReportSlabMeta(uint32_t block_offset_id, const std::shared_ptr<SlabBlock> & oSlabBlock);
+
+	/**
+	 * 一个 caSlabPutMetaBatch 请求汇报所有已记录的块，操作结束返回前调用
+	 */
+	void FlushSlabMeta();
+
 	/**
 	 * 删除一块数据缓存邻居信息，这些邻居不可用，直接从底部存储读取数据
 	 */
@@ -60,21 +110,151 @@ protected:
 	/**
 	 * 异步方式从各 peer 读取数据，如果没有，调用后台 backend 读取数据
 	 * 离线模式下网络故障 不会调用该函数
+	 *
+	 * 邻居超过最近读取耗时的百分位仍未返回，启动第二路读取（下一个邻居或后端存储），先完成者返回
 	 */
 	void ReadOneSlabPeer(uint32_t block_offset_id, int32_t mVersion, const SlabCallback & callback, bool offline);
 
 	/**
-	 * 从后端存储读取数据
+	 * 从一个邻居读取数据块，失败时不做后续尝试，oHedge 已经完成时丢弃数据
+	 */
+	void ReadSlabPeer(const std::shared_ptr<SlabPeer> & oSlabPeer, uint32_t block_offset_id, int32_t mVersion,
+			const std::shared_ptr<SlabHedge> & oHedge, const SlabCallback & callback);
+
+	/**
+	 * 启动对冲定时器，超时后启动第二路读取
 	 */
-	void ReadBackend(uint32_t block_offset_id, int32_t mVersion, const SlabCallback & callback, bool offline);
+	void StartHedge(const std::shared_ptr<SlabHedge> & oHedge, const std::shared_ptr<SlabPeer> & oHedgePeer,
+			uint32_t block_offset_id, int32_t mVersion, bool offline);
 
 	/**
-	 * 保存从邻居或后端存储得到的数据到内存块
+	 * 从后端存储读取数据，后端读取在后端线程中进行，不阻塞网络线程
+	 */
+	void ReadBackend(uint32_t block_offset_id, int32_t mVersion, const SlabCallback & callback, bool offline,
+			const std::shared_ptr<SlabHedge> & oHedge = std::shared_ptr<SlabHedge>());
+
+	/**
+	 * 合并读取的候选块：紧跟 block_offset_id 之后、仍在本次请求中、本地没有缓存且读取开始前没有邻居的连续块，
+	 * 返回块编号和加载时使用的版本，长度受前缀的 read_merge_kb 限制
+	 */
+	void GetMergeCandidates(uint32_t block_offset_id, bool offline,
+			std::vector<std::pair<uint32_t, int32_t> > & oCandidates);
+
+	/**
+	 * 合并读取完成，拆分数据保存到附带读取的块，然后放行等待这些块的读取
+	 */
+	void ReadMergedDone(uint32_t block_offset_id, const std::vector<std::pair<uint32_t, int32_t> > & oMergeIds,
+			const std::shared_ptr<char> & read_buffer, int bytes_readed);
+
+	/**
+	 * 取出本次请求合并读取加载的块，没有时返回空
+	 */
+	std::shared_ptr<SlabBlock> TakeMergedBlock(uint32_t block_offset_id);
+
+	/**
+	 * 后端读取完成后在 io_service 中调用，在块的串行调用中保存数据，然后放行等待相同块的读取
+	 * 对冲读取时，只有 oHedge 认领成功的一路写入缓存块
+	 */
+	void ReadBackendDone(uint32_t block_offset_id, int32_t mVersion, const char * ptr, int bytes_readed, int e_code,
+			const std::string & e_message, const SlabCallback & callback, const std::shared_ptr<SlabHedge> & oHedge);
+
+	/**
+	 * 保存从邻居或后端存储得到的数据到内存块，加载的数据不是修改数据
+	 * 邻居的修改由邻居自己刷新到后端，之后修改该块时只写入修改的区间
 	 */
 	void LoadDataToSlab(const char * buffer, size_t buffer_size, uint32_t block_offset_id, int32_t mVersion,
 			const SlabCallback & callback);
 };
 
+/**
+ * 一块数据的对冲读取状态，第一路为邻居，第二路为下一个邻居或后端存储
+ * 两路在不同线程回调，只有第一个成功者（或全部失败后的最后一个）回调上层
+ */
+class SlabHedge {
+private:
+	SlabChainOp::SlabCallback callback;
+
+	std::mutex mtx;
+	std::atomic<bool> bDone { false };
+	bool bLaunched { false }; //第二路是否已经启动，mtx 保护
+	bool bClaimed { false }; //已有一路拿到数据并写入缓存，mtx 保护
+	int nPending { 1 }; //未完成的读取路数，mtx 保护
+
+public:
+	std::shared_ptr<boost::asio::deadline_timer> timer;
+
+	SlabHedge(boost::asio::io_service & ios, const SlabChainOp::SlabCallback & callback_) :
+			callback(callback_) {
+		timer = std::make_shared<boost::asio::deadline_timer>(ios);
+	}
+
+	/**
+	 * 对冲超时，启动第二路，返回 false 说明第二路已经启动或已经完成
+	 * 只有启动第二路的调用增加未完成路数
+	 */
+	bool Hedge() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (bLaunched == true || bDone == true) {
+			return false;
+		}
+		bLaunched = true;
+		nPending++;
+		return true;
+	}
+
+	/**
+	 * 第一路失败，接替为第二路，返回 false 说明第二路已经启动
+	 */
+	bool Fallback() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (bLaunched == true) {
+			return false;
+		}
+		bLaunched = true;
+		return true;
+	}
+
+	/**
+	 * 拿到数据后写入缓存前调用，只有第一个调用者可以写入缓存块，返回 false 的一路丢弃数据并以失败调用 Done
+	 */
+	bool Claim() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (bClaimed == true || bDone == true) {
+			return false;
+		}
+		bClaimed = true;
+		return true;
+	}
+
+	/**
+	 * 一路读取完成，返回 true 说明本次结果被采用
+	 * 失败时，如果还有其他路未完成，等待其他路
+	 */
+	bool Done(int state, const std::string & message, const std::shared_ptr<SlabBlock> & oSlabBlock) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (state != tsSuccess && --nPending > 0) {
+				return false;
+			}
+
+			if (bDone == true) {
+				return false;
+			}
+			bDone = true;
+		}
+
+		boost::system::error_code ec;
+		timer->cancel(ec);
+
+		callback(state, message, oSlabBlock);
+		return true;
+	}
+
+	bool IsDone() const {
+		return bDone;
+	}
+};
+
 /**
  * 局部自引用对象，无多线程使用
  */
@@ -83,14 +263,38 @@ private:
 
 	std::stringstream rb_buffer; //读取数据所需的临时缓存
 
+protected:
+	bool bDataEnd { false }; //已经读到不满一块的文件最后一块，后面的块不再读取
+
 	size_t bytes_to_read { 0 }; //待读取的长度，对于写入无效
+
+	/**
+	 * 一块数据读取完成，默认放入临时缓存
+	 */
+	virtual void ReadSlabData(uint32_t block_offset_id, const std::shared_ptr<SlabBlock> & oSlabBlock);
+
+	/**
+	 * 当前块列表读取完成，默认直接返回
+	 */
+	virtual void ReadBlocksDone(bool offline);
+
+	/**
+	 * 返回结果，state < tsSuccess 时 message 为错误信息
+	 */
+	virtual void Finish(int state, const std::string & message);
+
+	/**
+	 * 一块处理完成后继续读取下一块，默认直接继续
+	 */
+	virtual void ReadNext(bool offline);
+
 public:
 	SlabChainReader(const std::shared_ptr<SlabFileManager> & oSlabFileManager_,
 			const std::shared_ptr<SlabServerData>& serverdata_, const std::shared_ptr<SlabFile> & oSlabFile_,
 			const std::shared_ptr<asio_server_tcp_connection>& conn_, off_t offset_, size_t read_size_,
 			const std::vector<uint32_t>& oBlockOffsetIds_);
 
-	~SlabChainReader();
+	virtual ~SlabChainReader();
 
 	/**
 	 * 异步读取数据，内部函数调用链
@@ -106,35 +310,200 @@ public:
 };
 
 /**
- * 局部自引用对象，无多线程使用
+ * 局部自引用对象，流式读取，不受 MAX_REQUEST_SIZE 限制，无多线程使用
+ * 按窗口分批获取元数据，每块数据读取后立即作为一帧发送，内存中只保留当前一块
+ */
+class SlabChainStreamer: public SlabChainReader {
+private:
+	off_t stream_end { 0 }; //读取结束位置
+	off_t stream_pos { 0 }; //已发送数据的结束位置
+	uint32_t iNextBlockOffsetId { 0 }; //下一个窗口的开头一块编号
+	int8_t readonly { 0 };
+
+	std::mutex mtx_frames;
+	int nFrames { 0 }; //已投递连接未写完的帧数，mtx_frames 保护
+	bool bWaiting { false }; //帧数达到 STREAM_WRITE_FRAMES，等待写完后继续读取，mtx_frames 保护
+	bool bWaitingOffline { false };
+
+protected:
+	void ReadSlabData(uint32_t block_offset_id, const std::shared_ptr<SlabBlock> & oSlabBlock);
+
+	/**
+	 * 未写完的帧数达到 STREAM_WRITE_FRAMES 时，由帧写完的回调继续读取
+	 */
+	void ReadNext(bool offline);
+
+	/**
+	 * 一帧已由连接写完并释放
+	 */
+	void FrameDone();
+
+	void ReadBlocksDone(bool offline);
+
+	void Finish(int state, const std::string & message);
+
+	/**
+	 * 发送一帧数据，last = 1 为最后一帧
+	 */
+	void SendFrame(int8_t last, off_t data_offset, const char * data, size_t size);
+
+public:
+	SlabChainStreamer(const std::shared_ptr<SlabFileManager> & oSlabFileManager_,
+			const std::shared_ptr<SlabServerData>& serverdata_, const std::shared_ptr<SlabFile> & oSlabFile_,
+			const std::shared_ptr<asio_server_tcp_connection>& conn_, off_t offset_, size_t read_size_,
+			int8_t readonly_);
+
+	~SlabChainStreamer();
+
+	/**
+	 * 获取下一个窗口的元数据并读取，全部读取完成后发送最后一帧
+	 */
+	void NextWindow(bool offline);
+};
+
+/**
+ * 局部自引用对象，一次读取多个区间，各块并行读取，回调来自多个线程
+ */
+class SlabChainVReader: public SlabChainOp {
+private:
+	std::vector<std::pair<off_t, size_t> > oRanges; //待读取的区间
+
+	std::mutex mtx;
+	std::map<uint32_t, std::shared_ptr<SlabBlock> > oSlabBlocks; //已经读取的块，会被多线程修改
+
+	std::atomic<int> nPending { 0 }; //未完成的块数
+	std::atomic<bool> bFailed { false };
+public:
+	SlabChainVReader(const std::shared_ptr<SlabFileManager> & oSlabFileManager_,
+			const std::shared_ptr<SlabServerData>& serverdata_, const std::shared_ptr<SlabFile> & oSlabFile_,
+			const std::shared_ptr<asio_server_tcp_connection>& conn_,
+			const std::vector<std::pair<off_t, size_t> > & ranges_, const std::vector<uint32_t>& oBlockOffsetIds_);
+
+	~SlabChainVReader();
+
+	/**
+	 * 所有块同时开始读取
+	 */
+	void ReadAsync(bool offline);
+
+	/**
+	 * 读取一块，完成后调用 Done
+	 */
+	void ReadOneSlab(uint32_t block_offset_id, bool offline);
+
+	/**
+	 * 一块读取完成，全部完成后返回数据，第一个错误直接返回
+	 */
+	void Done(uint32_t block_offset_id, int state, const std::string & message,
+			const std::shared_ptr<SlabBlock> & oSlabBlock);
+
+	/**
+	 * 按区间顺序组装数据返回
+	 */
+	void Response();
+};
+
+/**
+ * 局部自引用对象，各块并行写入，回调来自多个线程
  */
 class SlabChainWriter: public SlabChainOp {
 private:
-	ssize_t bytes_done { 0 }; //成功写入数据数
+	std::atomic<ssize_t> bytes_done { 0 }; //成功写入数据数
+	std::atomic<int> nPending { 0 }; //未完成的块数
+	std::atomic<bool> bFailed { false };
+	std::atomic<bool> bSucceeded { false };
 	bool async_write { true };
-	std::string data_to_write; //待写入的数据，对于读取无效
+	bool append { false }; //追加写入，offset 由 SlabFile::ReserveAppend 预留，失败时归还
+
+	WritePolicy policy { WritePolicy::wpClient }; //文件所在前缀的写入策略
+	bool bWriteAround { false };
+	time_t start_usec { 0 };
+	uint64_t nJournalSeq { 0 }; //异步写入在写缓存块之前预留的日志序号，析构时释放
+
+	std::mutex mtx_written;
+	std::map<uint32_t, std::shared_ptr<SlabBlock> > oWrittenBlocks; //已写入、待确认元数据的块
+	std::map<uint32_t, int32_t> oAroundVersions; //绕写的块的新版本，mtx_written 保护
+	int nFailedState { tsSuccess }; //第一个失败块的错误，所有块结束后返回，mtx_written 保护
+	std::string sFailedMessage;
+	const std::string data_to_write; //待写入的数据，由请求移交，各块直接从中写入
 
 public:
 	SlabChainWriter(const std::shared_ptr<SlabFileManager> & oSlabFileManager_,
 			const std::shared_ptr<SlabServerData>& serverdata_, const std::shared_ptr<SlabFile> & oSlabFile_,
-			const std::shared_ptr<asio_server_tcp_connection>& conn_, off_t offset_, const std::string & write_data_,
-			bool async_write_, const std::vector<uint32_t>& oBlockOffsetIds_);
+			const std::shared_ptr<asio_server_tcp_connection>& conn_, off_t offset_, std::string && write_data_,
+			bool async_write_, const std::vector<uint32_t>& oBlockOffsetIds_, bool append_ = false);
 
 	~SlabChainWriter();
 
 	void WriteAsync(bool offline);
 
+	/**
+	 * 所有块同时开始写入
+	 */
 	void Write(bool offline);
 
+	/**
+	 * 一块写入完成，全部完成后返回写入字节数，第一个错误直接返回
+	 */
+	void Done(uint32_t block_offset_id, int state, const std::string & message, int slab_length, bool offline);
+
+	/**
+	 * 全部块完成后，一次确认所有写入成功的块的元数据
+	 */
+	void PutSlabMetas(bool offline);
+
+	/**
+	 * 全部写入完成，更新文件属性并返回
+	 */
+	void Finish(bool offline);
+
+	/**
+	 * 日志记录写入完成后返回，日志失败时先刷新到后端
+	 */
+	void JournalDone(ssize_t bytes, bool bOk);
+
+	/**
+	 * 返回客户端，追加写入成功时附加写入位置
+	 */
+	void Respond(ssize_t bytes_state, const std::string & message);
+
+	/**
+	 * 所有块结束后返回第一个失败块的错误
+	 */
+	void RespondFailed();
+
 	/**
 	 *  修改一块
 	 */
 	void WriteOneSlab(uint32_t block_offset_id, bool offline);
 
 	/**
-	 * 分配一个新内存，写入数据
+	 * 分配一个新内存，写入数据，bPartial 为 true 时没有加载原有数据，块中只有写入的区间
+	 */
+	void SaveDataToNewSlab(uint32_t block_offset_id, int32_t mVersion, bool offline, bool bPartial = false);
+
+	/**
+	 * 异步写入且后端存储是该块唯一的数据来源（元数据中没有邻居）时，不读取原有数据，直接写入部分块
+	 * 读取时再合并后端数据，返回 false 说明需要先加载数据
+	 */
+	bool SaveDataToPartialSlab(uint32_t block_offset_id, int32_t mVersion, bool offline);
+
+	/**
+	 * 绕写：直接写入后端存储，不缓存
+	 */
+	void WriteAroundSlab(uint32_t block_offset_id, int32_t mVersion, bool offline);
+
+	/**
+	 * 绕写的后端写入完成，在 io_service 中调用
+	 */
+	void WriteAroundDone(uint32_t block_offset_id, int32_t mVersion, bool offline, int bytes, int e_code,
+			const std::string & e_message);
+
+	/**
+	 * 块起始位置不小于已知的文件结束位置，后端存储中没有数据，不读取直接写入新块
+	 * 返回 false 说明文件结束位置未知或块在文件范围内
 	 */
-	void SaveDataToNewSlab(uint32_t block_offset_id, int32_t mVersion, bool offline);
+	bool SaveDataBeyondEnd(uint32_t block_offset_id, int32_t mVersion, bool offline);
 
 	/**
 	 * 寻找内存块，更新数据到内存块
@@ -30,6 +30,11 @@ SlabFileManager::SlabFileManager(const std::shared_ptr<SlabFactory> & oSlabFacto
 	timer_Trush = std::make_shared<boost::asio::deadline_timer>(*io_service);
 
 	oSlabMessager = std::make_shared<TcpMessager>();
+
+	if (oServerData->journal_path.empty() == false) {
+		oSlabJournal = std::make_shared<SlabJournal>(oServerData->journal_path, oServerData->journal_sync,
+				(uint64_t) oServerData->journal_segment_mb * 1024 * 1024);
+	}
 }
 
 SlabFileManager::~SlabFileManager() {
@@ -50,26 +55,30 @@ SlabFileManager::~SlabFileManager() {
  * 一种解决方案，在 SlabBlock 里面 加锁单例任务进行回调读取，其他读取任务等待
  */
 
-bool SlabFileManager::Write(const std::string & filename, off_t offset, const std::string & data_to_write,
-		bool write_async, const std::shared_ptr<asio_server_tcp_connection> & conn) {
+bool SlabFileManager::Write(const std::string & filename, off_t offset, std::string && data_to_write,
+		bool write_async, const std::shared_ptr<asio_server_tcp_connection> & conn, bool append) {
+
+	int8_t resp_action = append == true ? CacheAction::caClientAppendResp : CacheAction::caClientWriteResp;
 
 	if (oBackendManager->IsValid(filename) == false) {
-		this->ResponseEcho(CacheAction::caClientWriteResp, - EINVAL, strerror(EINVAL), conn);
+		this->ResponseEcho(resp_action, - EINVAL, strerror(EINVAL), conn);
 		return true;
 	}
 
 	bool bMemoryFile = oBackendManager->IsMemory(filename);
 	if (bMemoryFile == false) {
 		if (oBackendManager->IsReadOnly(filename) == true) {
-			this->ResponseEcho(CacheAction::caClientWriteResp, - EROFS, strerror(EROFS), conn);
+			this->ResponseEcho(resp_action, - EROFS, strerror(EROFS), conn);
 			return true;
 		}
+
+		oBackendManager->ClearNegative(filename);
 	}
 
 	size_t size = data_to_write.size();
 	std::vector<uint32_t> BlockOffsetIds;
 	if (size == 0 || CalcOffsetBlocks(offset, size, BlockOffsetIds) == 0) {
-		this->ResponseEcho(CacheAction::caClientWriteResp, tsSuccess, "", conn);
+		this->ResponseEcho(resp_action, tsSuccess, "", conn);
 		return true;
 	}
 
@@ -82,7 +91,7 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 		});
 
 	if (oSlabFile.get() == NULL) {
-		this->ResponseEcho(CacheAction::caClientWriteResp, - EIO, strerror(EIO), conn);
+		this->ResponseEcho(resp_action, - EIO, strerror(EIO), conn);
 		return true;
 	}
 
@@ -97,7 +106,7 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 	oSlabFile->ClearMeta();
 
 	std::shared_ptr<SlabChainWriter> oSlabChainWriter = std::make_shared<SlabChainWriter>(self, oServerData, oSlabFile,
-			conn, offset, data_to_write, write_async, BlockOffsetIds);
+			conn, offset, std::move(data_to_write), write_async, BlockOffsetIds, append);
 
 	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caSlabGetMeta);
 	//获取所有块在元数据中的版本信息，存在一个风险，取回版本后，数据还保存完，元数据端被别人改了
@@ -116,10 +125,10 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 	}
 
 	LOGGER_TRACE(
-			"#" << __LINE__ << ", SlabFileManager::Write: " << filename << ", offset: " << offset << ", size: " << data_to_write.size());
+			"#" << __LINE__ << ", SlabFileManager::Write: " << filename << ", offset: " << offset << ", size: " << size);
 
 	message->callback =
-			[ this, self, conn, data_to_write, nBlocks, filename, oSlabChainWriter, oSlabFile]( std::shared_ptr<stringbuffer> input,
+			[ this, self, conn, nBlocks, filename, oSlabChainWriter, oSlabFile, resp_action ]( std::shared_ptr<stringbuffer> input,
 					const boost::system::error_code & ec, std::shared_ptr<base_connection> conn1 ) {
 
 				//网络故障处理，当发送不接受任务后，服务端会关闭连接
@@ -135,7 +144,7 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 						return;
 					}
 
-					this->ResponseEcho( CacheAction::caClientWriteResp, - EIO , ec.message(), conn);
+					this->ResponseEcho( resp_action, - EIO , ec.message(), conn);
 					return;
 				}
 
@@ -147,7 +156,7 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 						|| input->read_uint32( nBlocksResp ) == false || action != CacheAction::caSlabGetMetaResp) {
 
 					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Write: " << filename << ", Error: Invalid response");
-					this->ResponseEcho(CacheAction::caClientWriteResp, - EIO , strerror(EIO) , conn);
+					this->ResponseEcho(resp_action, - EIO , strerror(EIO) , conn);
 
 					return;
 				}
@@ -166,7 +175,7 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 							|| input->read_uint32( nPeers ) == false ) {
 
 						LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Write: " << filename << ", Error: Invalid response");
-						this->ResponseEcho(CacheAction::caClientReadResp, - EIO , strerror(EIO) , conn);
+						this->ResponseEcho(resp_action, - EIO , strerror(EIO) , conn);
 
 						return;
 					}
@@ -201,6 +210,75 @@ bool SlabFileManager::Write(const std::string & filename, off_t offset, const st
 	return true;
 }
 
+/**
+ * 追加写入：文件结束位置已知时直接预留写入位置，未知时先获取文件属性（后端长度），然后按普通写入处理
+ * 预留的位置超过后端长度时，写入的块不需要从后端加载
+ */
+bool SlabFileManager::Append(const std::string & filename, std::string && data, bool write_async,
+		const std::shared_ptr<asio_server_tcp_connection> & conn) {
+
+	if (oBackendManager->IsValid(filename) == false) {
+		this->ResponseEcho(CacheAction::caClientAppendResp, - EINVAL, strerror(EINVAL), conn);
+		return true;
+	}
+
+	bool bMemoryFile = oBackendManager->IsMemory(filename);
+	if (bMemoryFile == false && oBackendManager->IsReadOnly(filename) == true) {
+		this->ResponseEcho(CacheAction::caClientAppendResp, - EROFS, strerror(EROFS), conn);
+		return true;
+	}
+
+	auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
+
+	std::shared_ptr<SlabFile> oSlabFile;
+	oSlabFiles_m.get_or_create(filename, oSlabFile, 0, [ this , self, filename, bMemoryFile ]( ) {
+		return std::make_shared<SlabFile>( this, oSlabFactory, filename , bMemoryFile );
+	});
+
+	if (oSlabFile.get() == NULL) {
+		this->ResponseEcho(CacheAction::caClientAppendResp, - EIO, strerror(EIO), conn);
+		return true;
+	}
+
+	oSlabFile->Update();
+
+	size_t size = data.size();
+	off_t offset = oSlabFile->ReserveAppend(size, oServerData->stat_ttl);
+	if (offset >= 0) {
+		LOGGER_TRACE(
+				"#" << __LINE__ << ", SlabFileManager::Append: " << filename << ", offset: " << offset << ", size: " << size);
+		return this->Write(filename, offset, std::move(data), write_async, conn, true);
+	}
+
+	std::shared_ptr<std::string> oData = std::make_shared<std::string>(std::move(data));
+
+	this->EnsureGetAttr(oSlabFile,
+			[this, self, oSlabFile, filename, oData, write_async, conn ]( time_t stat_mtime, off_t stat_size, int e_code, const std::string & e_message ) {
+
+				if ( e_code < 0 ) {
+					this->ResponseEcho(CacheAction::caClientAppendResp, e_code, e_message, conn);
+					return;
+				}
+
+				/**
+				 * 文件不存在，从 0 开始写入
+				 */
+				size_t size = oData->size();
+				off_t offset = oSlabFile->ReserveAppend( size, oServerData->stat_ttl );
+				if ( offset < 0 ) {
+					oSlabFile->SetBackendEnd( stat_mtime < 0 ? 0 : stat_size );
+					offset = oSlabFile->ReserveAppend( size, oServerData->stat_ttl );
+				}
+
+				LOGGER_TRACE(
+						"#" << __LINE__ << ", SlabFileManager::Append: " << filename << ", offset: " << offset << ", size: " << size);
+
+				this->Write( filename, offset, std::move( *oData ), write_async, conn, true );
+			});
+
+	return true;
+}
+
 /**
  * 读取数据过程:
  * 1、获取文件块的分布信息：如果本地文件对象缓存具有这次度取需要的所有块信息，直接使用缓存块分布信息，否则从元数据服务器获取
@@ -261,110 +339,18 @@ bool SlabFileManager::Read(const std::string & filename, int8_t readonly, off_t
 	std::shared_ptr<SlabChainReader> oSlabChainReader = std::make_shared<SlabChainReader>(self, oServerData, oSlabFile,
 			conn, offset, bytes_to_read, BlockOffsetIds);
 
-	//只读模式 如果本地缓存具有所需的元数据，缓存有效时间：60s，直接读取数据
-	if (readonly == 1 && oSlabChainReader->GetMetaFromCache() == true) {
+	//只读模式或持有租约 如果本地缓存具有所需的元数据，直接读取数据
+	if (UseCachedMeta(readonly, oSlabFile, oSlabChainReader) == true) {
 		//		LOGGER_TRACE("#" << __LINE__ << ", SlabFileManager::Read, Cached SlabMeta: " << filename);
 		oSlabChainReader->ReadAsync(false);
 		return true;
 	}
 
-	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caSlabGetMeta);
-	//获取所有块在元数据中的版本信息，存在一个风险，取回版本后，数据还保存完，元数据端被别人改了
-
-	size_t nBlocks = BlockOffsetIds.size();
-
-	int32_t uuid = oSlabFile->GetUuid();
-	message->output->write_int32(uuid);
-	message->output->write_str(filename);
-
-	message->output->write_uint32(nBlocks);
-	message->output->write_uint16(slab_port); /* 本地服务端口 */
-
-	for (uint32_t block_offset_id : BlockOffsetIds) {
-		message->output->write_uint32(block_offset_id);
-	}
-
-	message->callback =
-			[ this, self, conn, nBlocks, filename, oSlabChainReader, oSlabFile ]( std::shared_ptr<stringbuffer> input,
-					const boost::system::error_code & ec, std::shared_ptr<base_connection> conn1 ) {
-
-				if(ec) {
-					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Read: " << filename << ", Error: " << ec.message() << ", " << meta_addr << ":" << meta_port );
-					/**
-					 * 到元数据服务器，网络故障处理逻辑
-					 * 可能元数据服务器断线了
-					 */
-					if(oServerData->enable_offline == true ) {
-						LOGGER_WARN( "#" << __LINE__ << ", SlabFileManager::Read, Enter offline mode: " << filename );
-						/**
-						 * 切换到 offline 模式
-						 */
-						oSlabChainReader->ReadAsync( true );
-						return;
-					}
-
-					this->ResponseEcho(CacheAction::caClientReadResp, - EIO , ec.message(), conn);
-					return;
-				}
-
-				/**
-				 * 正常网络通讯处理逻辑
-				 */
-
-				int8_t action;
-				int32_t iMetaUuid;
-				uint32_t nBlocksResp;
-
-				if ( input->read_int8( action ) == false || input->read_int32( iMetaUuid ) == false || input->read_uint32( nBlocksResp ) == false || action != CacheAction::caSlabGetMetaResp ) {
-					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Read: " << filename << ", Error: Invalid response");
-					this->ResponseEcho(CacheAction::caClientReadResp, - EIO , strerror(EIO) , conn);
-					return;
-				}
-
-				/**
-				 * 检查本地文件是否有效，比对 UUID
-				 */
-				this-> CheckFileUuid(iMetaUuid, oSlabFile );
-
-				for( uint32_t idx = 0; idx < nBlocksResp; idx ++) {
-					uint32_t block_offset_id;
-					int32_t version;
-					uint32_t nPeers;
-
-					if ( input->read_uint32( block_offset_id ) == false || input->read_int32( version ) == false
-							|| input->read_uint32( nPeers ) == false ) {
-						LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Read: " << filename << ", Error: Invalid response");
-						this->ResponseEcho(CacheAction::caClientReadResp, - EIO , strerror(EIO) , conn);
-						return;
-					}
-
-					oSlabChainReader->PutVersion( block_offset_id, version );
-
-					/**
-					 * 获取所有邻居节点信息，放入列表，然后逐步尝试读取
-					 */
-					for ( uint32_t idx = 0; idx < nPeers; idx ++ ) {
-						std::string peer;
-						if( input->read_str( peer ) == false ) {
-							break;
-						}
-
-						const std::shared_ptr<SlabPeer> & oSlabPeer = std::make_shared< SlabPeer >( peer );
-						if ( oSlabPeer->getPort() == 0) {
-							continue;
-						}
-						oSlabChainReader->PutPeer( block_offset_id, oSlabPeer);
-					}
-				}
-
-				oSlabChainReader->PutMetaToCache();
-				/**
-				 * 放入一个 任务chain 中进行处理，任务 chain 完成后往 conn 返回数据，同时 自己销毁
-				 */
-				oSlabChainReader->ReadAsync(false);
-			};
+	GetSlabMeta(oSlabFile, BlockOffsetIds, oSlabChainReader, CacheAction::caClientReadResp, conn,
+			[ oSlabChainReader ]( bool offline ) {
+				oSlabChainReader->ReadAsync( offline );
+			});
 
-	this->PostMessage(message);
 	return true;
 }
 
@@ -421,63 +407,184 @@ bool SlabFileManager::Read2(const std::string & filename, int8_t readonly, int32
 	std::shared_ptr<SlabChainReader> oSlabChainReader = std::make_shared<SlabChainReader>(self, oServerData, oSlabFile,
 			conn, offset, bytes_to_read, BlockOffsetIds);
 
-//只读模式 如果本地缓存具有所需的元数据，缓存有效时间：60s，直接读取数据
-	if (readonly == 1 && oSlabChainReader->GetMetaFromCache() == true) {
+//只读模式或持有租约 如果本地缓存具有所需的元数据，直接读取数据
+	if (UseCachedMeta(readonly, oSlabFile, oSlabChainReader) == true) {
 		//		LOGGER_TRACE("#" << __LINE__ << ", SlabFileManager::Read, Cached SlabMeta: " << filename);
 		oSlabChainReader->ReadAsync(false);
 		return true;
 	}
 
+	GetSlabMeta(oSlabFile, BlockOffsetIds, oSlabChainReader, CacheAction::caClientReadResp, conn,
+			[ oSlabChainReader ]( bool offline ) {
+				oSlabChainReader->ReadAsync( offline );
+			});
+
+	return true;
+}
+
+/**
+ * 一次读取多个区间
+ * 所有区间所需块取并集，只获取一次元数据，各块并行读取，全部完成后按区间顺序一次返回
+ */
+bool SlabFileManager::ReadV(const std::string & filename, int8_t readonly,
+		const std::vector<std::pair<off_t, size_t> > & ranges, const std::shared_ptr<asio_server_tcp_connection> & conn) {
+
+	if (oBackendManager->IsValid(filename) == false) {
+		this->ResponseEcho(CacheAction::caClientReadVResp, - EINVAL, strerror(EINVAL), conn);
+		return true;
+	}
+
+	auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
+	bool bMemoryFile = oBackendManager->IsMemory(filename);
+
+	std::shared_ptr<SlabFile> oSlabFile;
+	oSlabFiles_m.get_or_create(filename, oSlabFile, 0, [ this , self, filename, bMemoryFile ]( ) {
+		return std::make_shared<SlabFile>(this, oSlabFactory, filename, bMemoryFile );
+	});
+
+	if (oSlabFile.get() == NULL) {
+		this->ResponseEcho(CacheAction::caClientReadVResp, - EIO, strerror(EIO), conn);
+		return true;
+	}
+
+	if (oBackendManager->IsReadOnly(filename) == true) {
+		readonly = 1;
+	}
+
+	/**
+	 * 更新访问时间
+	 */
+	oSlabFile->Update();
+
+	std::set<uint32_t> oBlockIds;
+	for (const auto & range : ranges) {
+		std::vector<uint32_t> RangeOffsetIds;
+		CalcOffsetBlocks(range.first, range.second, RangeOffsetIds);
+		oBlockIds.insert(RangeOffsetIds.begin(), RangeOffsetIds.end());
+	}
+
+	std::vector<uint32_t> BlockOffsetIds(oBlockIds.begin(), oBlockIds.end());
+
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", SlabFileManager::ReadV: " << filename << ", Ranges: " << ranges.size() << ", Blocks: " << BlockOffsetIds.size());
+
+	std::shared_ptr<SlabChainVReader> oSlabChainVReader = std::make_shared<SlabChainVReader>(self, oServerData,
+			oSlabFile, conn, ranges, BlockOffsetIds);
+
+	//只读模式或持有租约 如果本地缓存具有所需的元数据，直接读取数据
+	if (BlockOffsetIds.empty() == true || UseCachedMeta(readonly, oSlabFile, oSlabChainVReader) == true) {
+		oSlabChainVReader->ReadAsync(false);
+		return true;
+	}
+
+	GetSlabMeta(oSlabFile, BlockOffsetIds, oSlabChainVReader, CacheAction::caClientReadVResp, conn,
+			[ oSlabChainVReader ]( bool offline ) {
+				oSlabChainVReader->ReadAsync( offline );
+			});
+
+	return true;
+}
+
+bool SlabFileManager::ReadStream(const std::string & filename, int8_t readonly, off_t offset, size_t bytes_to_read,
+		const std::shared_ptr<asio_server_tcp_connection> & conn) {
+
+	if (oBackendManager->IsValid(filename) == false) {
+		this->ResponseEcho(CacheAction::caClientReadStreamResp, - EINVAL, strerror(EINVAL), conn);
+		return true;
+	}
+
+	auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
+	bool bMemoryFile = oBackendManager->IsMemory(filename);
+
+	std::shared_ptr<SlabFile> oSlabFile;
+	oSlabFiles_m.get_or_create(filename, oSlabFile, 0, [ this , self, filename, bMemoryFile ]( ) {
+		return std::make_shared<SlabFile>(this, oSlabFactory, filename, bMemoryFile );
+	});
+
+	if (oSlabFile.get() == NULL) {
+		this->ResponseEcho(CacheAction::caClientReadStreamResp, - EIO, strerror(EIO), conn);
+		return true;
+	}
+
+	if (oBackendManager->IsReadOnly(filename) == true) {
+		readonly = 1;
+	}
+
+	/**
+	 * 更新访问时间
+	 */
+	oSlabFile->Update();
+
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", SlabFileManager::ReadStream: " << filename << ", offset: " << offset << ", size: " << bytes_to_read);
+
+	std::shared_ptr<SlabChainStreamer> oSlabChainStreamer = std::make_shared<SlabChainStreamer>(self, oServerData,
+			oSlabFile, conn, offset, bytes_to_read, readonly);
+
+	oSlabChainStreamer->NextWindow(false);
+	return true;
+}
+
+bool SlabFileManager::UseCachedMeta(int8_t readonly, const std::shared_ptr<SlabFile>& oSlabFile,
+		const std::shared_ptr<SlabChainOp> & oSlabChainOp) {
+	if (readonly == 1) {
+		return oSlabChainOp->GetMetaFromCache();
+	}
+
+	if (oSlabFile->HasLease() == true && oSlabChainOp->GetMetaFromCache() == true) {
+		nLeaseReads++;
+		return true;
+	}
+	return false;
+}
+
+void SlabFileManager::GetSlabMeta(const std::shared_ptr<SlabFile>& oSlabFile,
+		const std::vector<uint32_t> & BlockOffsetIds, const std::shared_ptr<SlabChainOp> & oSlabChainOp,
+		int8_t resp_action, const std::shared_ptr<asio_server_tcp_connection> & conn,
+		const std::function<void(bool offline)> & fStart) {
+
+	auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
+
 	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caSlabGetMeta);
-//获取所有块在元数据中的版本信息，存在一个风险，取回版本后，数据还保存完，元数据端被别人改了
 
-	size_t nBlocks = BlockOffsetIds.size();
+	const std::string & filename = oSlabFile->GetFilename();
 
-	int32_t uuid = oSlabFile->GetUuid();
-	message->output->write_int32(uuid);
+	message->output->write_int32(oSlabFile->GetUuid());
 	message->output->write_str(filename);
 
-	message->output->write_uint32(nBlocks);
+	message->output->write_uint32(BlockOffsetIds.size());
 	message->output->write_uint16(slab_port); /* 本地服务端口 */
 
 	for (uint32_t block_offset_id : BlockOffsetIds) {
 		message->output->write_uint32(block_offset_id);
 	}
 
+	uint64_t epoch = oSlabFile->GetLeaseEpoch();
+
 	message->callback =
-			[ this, self, conn, nBlocks, filename, oSlabChainReader, oSlabFile ]( std::shared_ptr<stringbuffer> input,
+			[ this, self, conn, filename, oSlabChainOp, oSlabFile, resp_action, fStart, epoch ]( std::shared_ptr<stringbuffer> input,
 					const boost::system::error_code & ec, std::shared_ptr<base_connection> conn1 ) {
 
 				if(ec) {
-					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Read: " << filename << ", Error: " << ec.message() << ", " << meta_addr << ":" << meta_port );
-					/**
-					 * 到元数据服务器，网络故障处理逻辑
-					 * 可能元数据服务器断线了
-					 */
+					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::GetSlabMeta: " << filename << ", Error: " << ec.message() << ", " << meta_addr << ":" << meta_port );
+
 					if(oServerData->enable_offline == true ) {
-						LOGGER_WARN( "#" << __LINE__ << ", SlabFileManager::Read, Enter offline mode: " << filename );
-						/**
-						 * 切换到 offline 模式
-						 */
-						oSlabChainReader->ReadAsync( true );
+						LOGGER_WARN( "#" << __LINE__ << ", SlabFileManager::GetSlabMeta, Enter offline mode: " << filename );
+						fStart( true );
 						return;
 					}
 
-					this->ResponseEcho(CacheAction::caClientReadResp, - EIO , ec.message(), conn);
+					this->ResponseEcho(resp_action, - EIO , ec.message(), conn);
 					return;
 				}
 
-				/**
-				 * 正常网络通讯处理逻辑
-				 */
-
 				int8_t action;
 				int32_t iMetaUuid;
 				uint32_t nBlocksResp;
 
 				if ( input->read_int8( action ) == false || input->read_int32( iMetaUuid ) == false || input->read_uint32( nBlocksResp ) == false || action != CacheAction::caSlabGetMetaResp ) {
-					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Read: " << filename << ", Error: Invalid response");
-					this->ResponseEcho(CacheAction::caClientReadResp, - EIO , strerror(EIO) , conn);
+					LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::GetSlabMeta: " << filename << ", Error: Invalid response");
+					this->ResponseEcho(resp_action, - EIO , strerror(EIO) , conn);
 					return;
 				}
 
@@ -493,16 +600,13 @@ bool SlabFileManager::Read2(const std::string & filename, int8_t readonly, int32
 
 					if ( input->read_uint32( block_offset_id ) == false || input->read_int32( version ) == false
 							|| input->read_uint32( nPeers ) == false ) {
-						LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::Read: " << filename << ", Error: Invalid response");
-						this->ResponseEcho(CacheAction::caClientReadResp, - EIO , strerror(EIO) , conn);
+						LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::GetSlabMeta: " << filename << ", Error: Invalid response");
+						this->ResponseEcho(resp_action, - EIO , strerror(EIO) , conn);
 						return;
 					}
 
-					oSlabChainReader->PutVersion( block_offset_id, version );
+					oSlabChainOp->PutVersion( block_offset_id, version );
 
-					/**
-					 * 获取所有邻居节点信息，放入列表，然后逐步尝试读取
-					 */
 					for ( uint32_t idx = 0; idx < nPeers; idx ++ ) {
 						std::string peer;
 						if( input->read_str( peer ) == false ) {
@@ -514,19 +618,26 @@ bool SlabFileManager::Read2(const std::string & filename, int8_t readonly, int32
 							continue;
 						}
 
-						oSlabChainReader->PutPeer( block_offset_id, oSlabPeer);
+						oSlabChainOp->PutPeer( block_offset_id, oSlabPeer);
 					}
 				}
 
-				oSlabChainReader->PutMetaToCache();
 				/**
-				 * 放入一个 任务chain 中进行处理，任务 chain 完成后往 conn 返回数据，同时 自己销毁
+				 * 租约时间，旧版本元数据服务没有该字段
 				 */
-				oSlabChainReader->ReadAsync( false );
+				int32_t lease_ttl = 0;
+				if ( input->read_int32( lease_ttl ) == false || lease_ttl < 0 ) {
+					lease_ttl = 0;
+				}
+
+				oSlabFile->CommitLease( epoch, lease_ttl, [ oSlabChainOp ]() {
+							oSlabChainOp->PutMetaToCache();
+						});
+
+				fStart( false );
 			};
 
 	this->PostMessage(message);
-	return true;
 }
 
 ResultType SlabFileManager::PeerReadSlab(const std::string& filename, int32_t iMetaUuid, uint32_t block_offset_id,
@@ -588,21 +699,26 @@ ResultType SlabFileManager::PeerReadSlab(const std::string& filename, int32_t iM
 			"#" << __LINE__ << ", SlabFileManager::PeerReadSlab, GotIt: " << filename << ": " << block_offset_id << ", Version: " << mVersion);
 
 	if (lVersion > 0 && lVersion >= mVersion) { //本地版本大于等于对方，返回本地数据
-		size_t size = oSlabBlock->GetUsedSize();
-
-		std::string data;
-		int bytes_readed = oSlabBlock->Read(0, size, data);
-
-		if (bytes_readed > 0) {
-			output->write_int32(1); //有数据
-			output->write_str(data.c_str(), bytes_readed);
-
-			//更新元数据版本到本地一致
-			LOGGER_TRACE(
-					"#" << __LINE__ << ", SlabFileManager::PeerReadSlab, Update Peer: " << filename << ":" << block_offset_id << ", " << mVersion << " --> " << lVersion);
+		if (oSlabBlock->IsPartial() == true) {
+			/**
+			 * 只有部分数据的块先异步合并后端数据，完成后再返回，合并失败时保留本地修改，对方从后端读取
+			 */
+			auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
+			oSlabFile->MergeBackend(block_offset_id, oSlabBlock,
+					[ this, self, oSlabFile, block_offset_id, oSlabBlock, conn ]( int e_code, const std::string & e_message ) {
+						std::shared_ptr<stringbuffer> response = std::make_shared<stringbuffer>();
+						response->write_int8(CacheAction::caSlabPeerReadResp);
+
+						if ( e_code != 0 || this->PeerReadData( oSlabFile, block_offset_id, oSlabBlock, response ) == false ) {
+							response->write_int32( 0 ); //无数据
+						}
 
-			UpdateSlabMeta(block_offset_id, oSlabFile, oSlabBlock);
+						conn->async_write( response );
+					});
+			return ResultType::rtNothing;
+		}
 
+		if (PeerReadData(oSlabFile, block_offset_id, oSlabBlock, output) == true) {
 			return ResultType::rtSuccess;
 		}
 	}
@@ -620,6 +736,29 @@ ResultType SlabFileManager::PeerReadSlab(const std::string& filename, int32_t iM
 	return ResultType::rtSuccess;
 }
 
+bool SlabFileManager::PeerReadData(const std::shared_ptr<SlabFile> & oSlabFile, uint32_t block_offset_id,
+		const std::shared_ptr<SlabBlock> & oSlabBlock, const std::shared_ptr<stringbuffer> & output) {
+
+	size_t size = oSlabBlock->GetUsedSize();
+
+	std::string data;
+	int bytes_readed = oSlabBlock->Read(0, size, data);
+
+	if (bytes_readed <= 0) {
+		return false;
+	}
+
+	output->write_int32(1); //有数据
+	output->write_str(data.c_str(), bytes_readed);
+
+	//更新元数据版本到本地一致
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", SlabFileManager::PeerReadData, Update Peer: " << oSlabFile->GetFilename() << ":" << block_offset_id << ", Version: " << oSlabBlock->GetVersion());
+
+	UpdateSlabMeta(block_offset_id, oSlabFile, oSlabBlock);
+	return true;
+}
+
 bool SlabFileManager::Unlink(const std::string& filename, const std::shared_ptr<asio_server_tcp_connection> & conn) {
 
 	if (oBackendManager->IsValid(filename) == false) {
@@ -655,6 +794,13 @@ bool SlabFileManager::Unlink(const std::string& filename, const std::shared_ptr<
 
 	oSlabFiles_m.erase(filename);
 
+	/**
+	 * 缓存中未刷新的修改随文件一起丢弃，重启时不再重放
+	 */
+	if (bMemoryFile == false && oSlabJournal.get() != NULL) {
+		oSlabJournal->Discard(filename);
+	}
+
 	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caClientUnlink);
 	message->output->write_str(filename);
 
@@ -857,6 +1003,13 @@ bool SlabFileManager::Truncate(const std::string& filename, off_t newsize,
 	message->output->write_int64(newsize);
 
 	oSlabFiles_m.erase(filename); //简化处理，删除本地缓存，删除服务器缓存
+
+	/**
+	 * 缓存中未刷新的修改随文件一起丢弃，重启时不再重放
+	 */
+	if (oSlabJournal.get() != NULL) {
+		oSlabJournal->Discard(filename);
+	}
 	message->callback =
 			[ this, self, conn, filename ]( std::shared_ptr<stringbuffer> input, const boost::system::error_code & ec,
 					std::shared_ptr<base_connection> conn1 ) {
@@ -969,57 +1122,149 @@ bool SlabFileManager::Flush(const std::string& filename, const std::shared_ptr<a
 void SlabFileManager::UpdateSlabMeta(uint32_t block_offset_id, const std::shared_ptr<SlabFile> & oSlabFile,
 		const std::shared_ptr<SlabBlock> & oSlabBlock) {
 
-	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caSlabPutMeta);
+	std::map<uint32_t, int32_t> versions;
+	versions[block_offset_id] = oSlabBlock->GetVersion();
+
+	UpdateSlabMetas(oSlabFile, versions);
+}
+
+void SlabFileManager::UpdateSlabMetas(const std::shared_ptr<SlabFile> & oSlabFile,
+		const std::map<uint32_t, int32_t> & versions) {
+
+	if (versions.empty() == true) {
+		return;
+	}
 
-	int32_t uuid = oSlabFile->GetUuid();
 	std::string filename = oSlabFile->GetFilename();
 
-	message->output->write_int32(uuid);
-	message->output->write_str(filename);
+	LOGGER_TRACE(
+			"#" << __LINE__ << ", SlabFileManager::UpdateSlabMetas: " << filename << ", Blocks: " << versions.size());
 
-	message->output->write_uint32(block_offset_id);
-	message->output->write_int32(oSlabBlock->GetVersion());
+	auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
 
-	message->output->write_uint16(slab_port); /* 本地服务端口 */
+	//不覆盖节点信息
+	PutSlabMetas(oSlabFile, versions, 0, [ this, self, oSlabFile, filename ]( const std::string & error, int32_t iMetaUuid ) {
+		if ( error.empty() == false ) {
+			LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::UpdateSlabMetas: " << filename << ", Error: " << error );
+			return;
+		}
 
-	message->output->write_int8(0); //不覆盖节点信息
+		this->CheckFileUuid( iMetaUuid, oSlabFile );
+	});
+}
 
-	time_t mtime = oSlabFile->GetStatMtime();
-	message->output->write_int64(mtime);
+void SlabFileManager::PutSlabMetas(const std::shared_ptr<SlabFile> & oSlabFile,
+		const std::map<uint32_t, int32_t> & versions, int8_t overwrite,
+		const std::function<void(const std::string & error, int32_t iMetaUuid)> & callback) {
 
-	off_t msize = oSlabFile->GetStatSize();
-	message->output->write_int64(msize);
+	std::vector<std::shared_ptr<TcpMessage> > messages;
+	int8_t resp_action;
 
-	LOGGER_TRACE(
-			"#" << __LINE__ << ", SlabFileManager::UpdateSlabMeta: " << oSlabFile->GetFilename() << ", BlockId: " << block_offset_id << ", Version: " << oSlabBlock->GetVersion()
-//			<< ", mtime:" << mtime << ", size: " << size
-			);
+	if (bMetaBatch == true) {
+		messages.push_back(NewPutMetaBatch(oSlabFile, versions, overwrite));
+		resp_action = CacheAction::caSlabPutMetaBatchResp;
+	} else {
+		/**
+		 * 旧版本不支持绕写（overwrite = 2），按 1 处理，记录的本节点读取失败后会从后端读取
+		 */
+		for (const auto & version : versions) {
+			messages.push_back(NewPutMeta(oSlabFile, version.first, version.second, overwrite == 2 ? 1 : overwrite));
+		}
+		resp_action = CacheAction::caSlabPutMetaResp;
+	}
+
+	std::shared_ptr<PutMetaWaiting> oWaiting = std::make_shared<PutMetaWaiting>();
+	oWaiting->nPending = messages.size();
 
 	auto self = this->shared_from_this();    //异步函数，通过自引用传递保持生命周期
 
-	message->callback = [ this, self, oSlabFile, filename ]( std::shared_ptr<stringbuffer> input,
-			const boost::system::error_code & ec, std::shared_ptr<base_connection> conn1 ) {
-		//网络故障处理，当发送不接受任务后，服务端会关闭连接
+	for (const auto & message : messages) {
+		message->callback = [ this, self, oWaiting, resp_action, callback ]( std::shared_ptr<stringbuffer> input,
+				const boost::system::error_code & ec, std::shared_ptr<base_connection> conn1 ) {
+			//网络故障处理，当发送不接受任务后，服务端会关闭连接
+			std::string error;
+			int8_t action;
+			int32_t iMetaUuid = 0;
 
 			if(ec) {
-				LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::UpdateSlabMeta: " << ec.message() );
-				return;
+				error = ec.message();
+			} else if ( input->read_int8( action ) == false || input->read_int32( iMetaUuid ) == false || action != resp_action ) {
+				error = FAILED_INVALID_RESPONSE;
 			}
 
-			int8_t action;
-			int32_t iMetaUuid;
-			int32_t state;
-
-			if ( input->read_int8( action ) == false || input->read_int32( iMetaUuid ) == false || input->read_int32( state ) == false ||
-					action != CacheAction::caSlabPutMetaResp ) {
-				LOGGER_INFO( "#" << __LINE__ << ", SlabFileManager::UpdateSlabMeta: " << filename << ", Error: Invalid response");
-				return;
+			{
+				std::lock_guard<std::mutex> lock(oWaiting->mtx);
+				if ( error.empty() == false && oWaiting->error.empty() == true ) {
+					oWaiting->error = error;
+				}
+				if ( error.empty() == true ) {
+					oWaiting->iMetaUuid = iMetaUuid;
+				}
+				if ( --oWaiting->nPending > 0 ) {
+					return;
+				}
 			}
 
-			this->CheckFileUuid( iMetaUuid, oSlabFile );
+			callback( oWaiting->error, oWaiting->iMetaUuid );
 		};
 
-	this->PostMessage(message);
+		this->PostMessage(message);
+	}
+}
+
+/**
+ * 格式: uuid, filename, block_offset_id, version, port, overwrite, mtime, size
+ */
+std::shared_ptr<TcpMessage> SlabFileManager::NewPutMeta(const std::shared_ptr<SlabFile> & oSlabFile,
+		uint32_t block_offset_id, int32_t version, int8_t overwrite) {
+
+	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caSlabPutMeta);
+
+	message->output->write_int32(oSlabFile->GetUuid());
+	message->output->write_str(oSlabFile->GetFilename());
+
+	message->output->write_uint32(block_offset_id);
+	message->output->write_int32(version);
+	message->output->write_uint16(slab_port); /* 本地服务端口 */
+	message->output->write_int8(overwrite);
+
+	time_t mtime = oSlabFile->GetStatMtime();
+	message->output->write_int64(mtime);
+
+	off_t msize = oSlabFile->GetStatSize();
+	message->output->write_int64(msize);
+
+	return message;
+}
+
+/**
+ * 格式: uuid, filename, port, overwrite, mtime, size, n, n * (block_offset_id, version)
+ * overwrite: 0 追加本节点，1 只保留本节点，2 清除所有节点（绕写）
+ */
+std::shared_ptr<TcpMessage> SlabFileManager::NewPutMetaBatch(const std::shared_ptr<SlabFile> & oSlabFile,
+		const std::map<uint32_t, int32_t> & versions, int8_t overwrite) {
+
+	std::shared_ptr<TcpMessage> message = NewMetaMessage(CacheAction::caSlabPutMetaBatch);
+
+	message->output->write_int32(oSlabFile->GetUuid());
+	message->output->write_str(oSlabFile->GetFilename());
+
+	message->output->write_uint16(slab_port); /* 本地服务端口 */
+	message->output->write_int8(overwrite);
+
+	time_t mtime = oSlabFile->GetStatMtime();
+	message->output->write_int64(mtime);
+
+	off_t msize = oSlabFile->GetStatSize();
+	message->output->write_int64(msize);
+
+	message->output->write_uint32(versions.size());
+	for (const auto & version : versions) {
+		message->output->write_uint32(version.first);
+		message->output->write_int32(version.second);
+	}
+
+	return message;
 }
 
 /**
@@ -1131,7 +1376,118 @@ ResultType SlabFileManager::CheckItSlab(const std::shared_ptr<stringbuffer>& inp
 	return ResultType::rtSuccess;
 }
 
+/**
+ * 元数据服务器推送的失效通知，删除缓存的元数据，后续读取重新获取
+ */
+ResultType SlabFileManager::InvalidateSlab(const std::shared_ptr<stringbuffer>& input,
+		std::shared_ptr<stringbuffer>& output, const std::shared_ptr<asio_server_tcp_connection>& conn) {
+
+	int32_t iMetaUuid;
+	std::string filename;
+	uint32_t nBlocks = 0;
+
+	if (input->read_int32(iMetaUuid) == false || input->read_str(filename) == false
+			|| input->read_uint32(nBlocks) == false) {
+		return ResultType::rtFailed;
+	}
+
+	std::vector<uint32_t> block_ids;
+	for (uint32_t i = 0; i < nBlocks; i++) {
+		uint32_t block_id;
+		if (input->read_uint32(block_id) == false) {
+			return ResultType::rtFailed;
+		}
+		block_ids.push_back(block_id);
+	}
+
+	output->write_int8(CacheAction::caMasterInvalidateResp);
+
+	nLeaseInvalidations++;
+
+	std::shared_ptr<SlabFile> oSlabFile;
+	oSlabFiles_m.get(filename, oSlabFile);
+
+	if (oSlabFile.get() == NULL) {
+		return ResultType::rtSuccess;
+	}
+
+	LOGGER_TRACE("#" << __LINE__ << ", SlabFileManager::InvalidateSlab: " << filename << ", Blocks: " << nBlocks);
+
+	/**
+	 * uuid 不一致，整个文件的元数据失效
+	 */
+	if (oSlabFile->GetUuid() != iMetaUuid) {
+		block_ids.clear();
+	}
+
+	oSlabFile->InvalidateMeta(block_ids);
+	return ResultType::rtSuccess;
+}
+
 void SlabFileManager::start() {
+	if (oSlabJournal.get() != NULL) {
+		/**
+		 * 上次运行没有刷新到后端的异步写入数据，直接写入后端存储，短写时继续写入剩余部分
+		 * 重放过的后端在删除日志段之前全部落盘
+		 */
+		std::map<std::string, std::shared_ptr<Backend> > oBackends;
+
+		const auto & fReplay = [ this, &oBackends ]( const std::string & filename, off_t offset, const std::string & data ) {
+			std::shared_ptr<Backend> & oBackend = oBackends[filename];
+			if ( oBackend.get() == NULL ) {
+				oBackend = oBackendManager->Open( filename, true );
+			}
+			if ( oBackend.get() == NULL ) {
+				LOGGER_WARN( "#" << __LINE__ << ", SlabFileManager::start, Journal, Invalid: " << filename );
+				oBackends.erase( filename );
+				return true;
+			}
+
+			oBackendManager->ClearNegative( filename );
+
+			size_t written = 0;
+			while ( written < data.size() ) {
+				int bytes = oBackend->Write( (void *) ( data.c_str() + written ), data.size() - written, offset + written );
+				if ( bytes <= 0 ) {
+					LOGGER_ERROR( "#" << __LINE__ << ", SlabFileManager::start, Journal: " << filename << ", Offset: " << offset + written << ", Error: " << oBackend->message );
+					return false;
+				}
+				written += bytes;
+			}
+			return true;
+		};
+
+		const auto & fSync = [ &oBackends ]() {
+			for ( const auto & backend : oBackends ) {
+				if ( backend.second->Flush() == false ) {
+					LOGGER_ERROR( "#" << __LINE__ << ", SlabFileManager::start, Journal, Flush: " << backend.first << ", Error: " << backend.second->message );
+					return false;
+				}
+			}
+			return true;
+		};
+
+		/**
+		 * 后端暂时不可用时退避重试，最后一次失败时保留日志段继续启动，下次启动再重放
+		 */
+		const int nRetries = 6;
+		for (int i = 0; i < nRetries; i++) {
+			oBackends.clear();
+			if (oSlabJournal->Replay(fReplay, fSync, i + 1 == nRetries) == true) {
+				break;
+			}
+
+			if (i + 1 == nRetries) {
+				LOGGER_ERROR("#" << __LINE__ << ", SlabFileManager::start, Journal replay failed, segments kept: " << oServerData->journal_path);
+				SYSLOG_ERROR("#" << __LINE__ << ", SlabFileManager::start, Journal replay failed, segments kept: " << oServerData->journal_path);
+				break;
+			}
+
+			LOGGER_WARN("#" << __LINE__ << ", SlabFileManager::start, Journal replay failed, retry in " << (1 << i) << "s: " << oServerData->journal_path);
+			sleep(1 << i);
+		}
+	}
+
 	ReportStatus();
 	TraceTrushes(1.0);
 }
@@ -1243,6 +1599,10 @@ void SlabFileManager::ReportStatus() {
 		size_t nFiles = oSlabFiles_m.size();
 		message->output->write_uint64( nFiles ); /* 总文件块数 */
 
+		WriteMetrics( message->output ); /* 运行计数器 */
+
+		oBackendManager->SweepBackends(); /* 关闭空闲的后端句柄 */
+
 		message->callback = [ this, self ]( std::shared_ptr<stringbuffer> input, const boost::system::error_code & ec,
 				std::shared_ptr<base_connection> conn ) {
 
@@ -1261,6 +1621,15 @@ void SlabFileManager::ReportStatus() {
 			}
 
 			if (action == CacheAction::caSlabStatusResp) {
+				/**
+				 * 旧版本元数据服务器没有功能字段，不支持批量确认
+				 */
+				uint32_t features = 0;
+				if ( input->read_uint32( features ) == false ) {
+					features = 0;
+				}
+				bMetaBatch = ( features & META_FEATURE_PUTMETA_BATCH ) != 0;
+
 				ReportStatus();
 				return;
 			}
@@ -1275,6 +1644,64 @@ void SlabFileManager::ReportStatus() {
 	});
 }
 
+void SlabFileManager::WriteMetrics(const std::shared_ptr<stringbuffer> & output) {
+	std::map<std::string, uint64_t> metrics;
+
+	metrics["peer_reads"] = nPeerReads;
+	metrics["peer_hedges"] = nPeerHedges;
+	metrics["peer_hedge_wins"] = nPeerHedgeWins;
+	metrics["peer_hedge_delay_usec"] = oPeerLatency.Percentile(oServerData->hedge_percentile);
+	metrics["lease_reads"] = nLeaseReads;
+	metrics["lease_invalidations"] = nLeaseInvalidations;
+	metrics["flush_writes"] = nFlushWrites;
+	metrics["flush_blocks"] = nFlushBlocks;
+	metrics["flush_bytes"] = nFlushBytes;
+	metrics["partial_writes"] = nPartialWrites;
+	metrics["partial_merges"] = nPartialMerges;
+	metrics["read_merges"] = nReadMerges;
+	metrics["read_merge_blocks"] = nReadMergeBlocks;
+	metrics["beyond_end_writes"] = nBeyondEndWrites;
+
+	for (int i = 0; i < WritePolicy::wpCount; i++) {
+		WritePolicyStats & oStats = oWritePolicyStats[i];
+		if (oStats.nWrites == 0) {
+			continue;
+		}
+
+		std::string name = BackendManager::GetWritePolicyName((WritePolicy) i);
+		metrics["write_" + name + "_requests"] = oStats.nWrites;
+		metrics["write_" + name + "_bytes"] = oStats.nBytes;
+		metrics["write_" + name + "_p50_usec"] = oStats.oLatency.Percentile(50, 0);
+		metrics["write_" + name + "_p99_usec"] = oStats.oLatency.Percentile(99, 0);
+	}
+
+	if (oSlabJournal.get() != NULL) {
+		metrics["journal_appends"] = oSlabJournal->nAppends;
+		metrics["journal_bytes"] = oSlabJournal->nAppendBytes;
+		metrics["journal_segments"] = oSlabJournal->GetNumSegments();
+	}
+
+	/**
+	 * 到各邻居的读取数和总耗时，name@host:port
+	 */
+	std::map<std::string, PeerReadStat> oPeerReads;
+	metrics["peer_read_window_usec"] = oPeerReadStats.Take(oPeerReads);
+	for (const auto & iter : oPeerReads) {
+		metrics["peer_read_count@" + iter.first] = iter.second.count;
+		metrics["peer_read_usec@" + iter.first] = iter.second.total_usec;
+	}
+
+	oBackendManager->GetNegativeMetrics(metrics);
+	oBackendManager->GetQueueMetrics(metrics);
+	oBackendManager->GetHandleMetrics(metrics);
+
+	output->write_uint32(metrics.size());
+	for (const auto & iter : metrics) {
+		output->write_str(iter.first);
+		output->write_uint64(iter.second);
+	}
+}
+
 void SlabFileManager::CheckFileUuid(int32_t iMetaUuid, const std::shared_ptr<SlabFile>& oSlabFile) {
 	/**
 	 * 如果元数据端没有当前文件，则 iMetaUuid == 0 同时 nBlocksResp == 0，stat_mtime == 0, stat_size == 0
@@ -1287,6 +1714,7 @@ void SlabFileManager::CheckFileUuid(int32_t iMetaUuid, const std::shared_ptr<Sla
 		//本文件的 内存数据清空，重构一个
 		oSlabFile->ClearMeta();
 		oSlabFile->ClearBlocks();
+		oSlabFile->ResetEnd();
 
 		std::string filename = oSlabFile->GetFilename();
 		oBackendManager->Close(filename);
@@ -1346,10 +1774,15 @@ void SlabFileManager::EnsureGetAttr(const std::shared_ptr<SlabFile>& oSlabFile,
 	 * 对于有 backend 的文件，直接从 backend 获取，同时在本地缓存
 	 */
 	if (bMemoryFile == false) {
-		const std::shared_ptr<mtsafe::CallBarrier<bool>> & oSlabBarrier = oSlabFile->GetBarrier();
+		std::shared_ptr<mtsafe::CallBarrier<bool>> oSlabBarrier = oSlabFile->GetBarrier();
+
+		/**
+		 * 后端属性获取失败的错误码和信息，在后端线程中设置，io_service 中返回
+		 */
+		std::shared_ptr<std::pair<int, std::string> > oError = std::make_shared<std::pair<int, std::string> >(0, "");
 
 		const auto & fSyncCallback =
-				[ this, self, filename, oSlabFile, callback]() {
+				[ this, self, filename, oSlabFile, oError ]() {
 
 					if (oSlabFile->StatValid(oServerData->stat_ttl) == true ) {
 						return true;
@@ -1370,14 +1803,14 @@ void SlabFileManager::EnsureGetAttr(const std::shared_ptr<SlabFile>& oSlabFile,
 							 */
 							oSlabFile->SetStatMtime( -ENOENT );
 							oSlabFile->StatUpdate();
-							callback( -ENOENT , 0, tsSuccess, "");
-							return false;
+							oSlabFile->SetBackendEnd( 0 );
+						} else {
+							LOGGER_INFO(
+									"#" << __LINE__ << ", SlabFileManager::EnsureGetAttr, Backend GetAttr: " << filename << ", Error: " << e_message);
 						}
 
-						LOGGER_INFO(
-								"#" << __LINE__ << ", SlabFileManager::EnsureGetAttr, Backend GetAttr: " << filename << ", Error: " << e_message);
-
-						callback( 0 , 0, -abs(e_code), e_message);
+						oError->first = e_code == 0 ? EIO : e_code;
+						oError->second = e_message;
 						return false;
 					}
 
@@ -1387,6 +1820,7 @@ void SlabFileManager::EnsureGetAttr(const std::shared_ptr<SlabFile>& oSlabFile,
 					oSlabFile->SetStatMtime(st.st_mtim.tv_sec);
 					oSlabFile->SetStatSize(st.st_size);
 					oSlabFile->StatUpdate();
+					oSlabFile->SetBackendEnd(st.st_size);
 
 					/**
 					 * 更新服务器上文件长度
@@ -1397,13 +1831,23 @@ void SlabFileManager::EnsureGetAttr(const std::shared_ptr<SlabFile>& oSlabFile,
 
 		/**
 		 * 获取文件属性，针对相同文件采用加锁方式读取，避免相同文件多线程访问造成不必要访问后端
-		 * oBackendManager->GetAttr 失败，已经返回错误信息到client，这里只需要返回 true
+		 * 后端调用在后端线程池中进行，结果在 io_service 中返回
 		 */
-		if (oSlabBarrier->CallSync(fSyncCallback) == false) {
-			return;
-		}
+		RunBackend(filename, [ oSlabBarrier, fSyncCallback ]() {
+			oSlabBarrier->CallSync( fSyncCallback );
+		}, [ oSlabFile, oError, callback ]() {
+			if ( oError->first == ENOENT ) {
+				callback( -ENOENT , 0, tsSuccess, "");
+				return;
+			}
 
-		callback(oSlabFile->GetStatMtime(), oSlabFile->GetStatSize(), tsSuccess, "");
+			if ( oError->first != 0 ) {
+				callback( 0 , 0, -abs(oError->first), oError->second);
+				return;
+			}
+
+			callback(oSlabFile->GetStatMtime(), oSlabFile->GetStatSize(), tsSuccess, "");
+		});
 		return;
 	}
 
@@ -1452,12 +1896,14 @@ void SlabFileManager::EnsureGetAttr(const std::shared_ptr<SlabFile>& oSlabFile,
 
 				oSlabFile->ClearMeta();
 				oSlabFile->ClearBlocks();
+				oSlabFile->ResetEnd();
 				oBackendManager->Close( filename );
 			}
 
 			oSlabFile->SetStatMtime( stat_mtime );
 			oSlabFile->SetStatSize( stat_size );
 			oSlabFile->StatUpdate();
+			oSlabFile->SetBackendEnd( stat_size );
 
 			callback(stat_mtime, stat_size, tsSuccess, "");
 		};
@@ -1496,3 +1942,18 @@ void SlabFileManager::PostMessage(const std::shared_ptr<TcpMessage> & message) {
 	oSlabMessager->PostMessage(message);
 }
 
+void SlabFileManager::RunBackend(const std::string & filename, const std::function<void(void)> & fWork,
+		const std::function<void(void)> & fDone) {
+	auto self = this->shared_from_this();
+
+	bool bSubmitted = oBackendManager->Submit(filename, [ this, self, fWork, fDone ]() {
+		fWork();
+		io_service->post( fDone );
+	});
+
+	if (bSubmitted == false) {
+		fWork();
+		fDone();
+	}
+}
+
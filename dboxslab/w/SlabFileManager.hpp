@@ -13,6 +13,10 @@
 #include <memory>
 #include <set>
 #include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <algorithm>
 
 #include <databox/filesystemutils.hpp>
 #include <databox/mtsafe_object.hpp>
@@ -22,6 +26,7 @@
 
 #include "backend/BackendManager.hpp"
 #include "memory/SlabMemManager.hpp"
+#include "SlabJournal.hpp"
 
 #define META_CACHE_MAX   512 * 1024
 #define BLOCK_CACHE_MAX  512 * 1024
@@ -35,6 +40,26 @@
  */
 #define TIMER_TRUSH_TTL  60
 
+/**
+ * 流式读取时每次获取元数据的块数
+ */
+#define STREAM_WINDOW_BLOCKS ( MAX_REQUEST_SIZE / SIZEOFBLOCK )
+
+/**
+ * 流式读取时已投递连接但还未写完的最多帧数，达到后等待写完再读取下一块
+ */
+#define STREAM_WRITE_FRAMES  4
+
+/**
+ * 刷新脏块时，相邻块合并为一次后端写入的最大块数
+ */
+#define FLUSH_MERGE_BLOCKS ( MAX_REQUEST_SIZE / SIZEOFBLOCK )
+
+/**
+ * 读取时，相邻的未命中块合并为一次后端读取的最大块数
+ */
+#define READ_MERGE_BLOCKS ( MAX_REQUEST_SIZE / SIZEOFBLOCK )
+
 class SlabChainOp;
 class SlabFileManager;
 
@@ -88,6 +113,106 @@ public:
 	}
 };
 
+/**
+ * 邻居读取块耗时统计，用于计算对冲等待时间，多线程访问
+ */
+#define PEER_LATENCY_SAMPLES   256
+#define PEER_LATENCY_MIN_COUNT 16
+#define PEER_LATENCY_DEFAULT   200000 //样本不足时的对冲等待时间，微秒
+
+class PeerLatency {
+private:
+	std::mutex mtx;
+	time_t used_tm_usec[PEER_LATENCY_SAMPLES] { 0 };
+
+	int index { 0 };
+	int count { 0 };
+public:
+	static time_t NowUsec() {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec * 1000000 + tv.tv_usec;
+	}
+
+	void Add(time_t usec) {
+		std::lock_guard<std::mutex> lock(mtx);
+		used_tm_usec[index++] = usec;
+		if (index >= PEER_LATENCY_SAMPLES) {
+			index = 0;
+		}
+		if (count < PEER_LATENCY_SAMPLES) {
+			count++;
+		}
+	}
+
+	/**
+	 * 最近样本的百分位耗时，percentile 取值 1 - 100，样本不足时返回 default_usec
+	 */
+	time_t Percentile(uint32_t percentile, time_t default_usec = PEER_LATENCY_DEFAULT) {
+		std::vector<time_t> samples;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (count < PEER_LATENCY_MIN_COUNT) {
+				return default_usec;
+			}
+			samples.assign(used_tm_usec, used_tm_usec + count);
+		}
+
+		size_t n = (samples.size() * std::min<uint32_t>(percentile, 100)) / 100;
+		if (n >= samples.size()) {
+			n = samples.size() - 1;
+		}
+
+		std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+		return samples[n];
+	}
+};
+
+/**
+ * 按邻居统计一个汇报周期内本节点发出的邻居读取数和总耗时，汇报后清零，多线程访问
+ * 元数据节点由总耗时除以周期长度得到到该邻居的平均在途读取数
+ */
+struct PeerReadStat {
+	uint64_t count { 0 };
+	uint64_t total_usec { 0 };
+};
+
+class PeerReadStats {
+private:
+	std::mutex mtx;
+	std::map<std::string, PeerReadStat> oStats;
+	time_t nSinceUsec { PeerLatency::NowUsec() };
+public:
+	void Add(const std::string & peer, time_t usec) {
+		std::lock_guard<std::mutex> lock(mtx);
+		PeerReadStat & stat = oStats[peer];
+		stat.count++;
+		stat.total_usec += usec;
+	}
+
+	/**
+	 * 取出本周期的统计并开始新周期，返回本周期长度，微秒
+	 */
+	time_t Take(std::map<std::string, PeerReadStat> & stats) {
+		time_t now = PeerLatency::NowUsec();
+		std::lock_guard<std::mutex> lock(mtx);
+		stats.swap(oStats);
+		oStats.clear();
+		time_t window_usec = now - nSinceUsec;
+		nSinceUsec = now;
+		return window_usec;
+	}
+};
+
+/**
+ * 一种写入策略的统计：请求数、写入字节数、最近请求的耗时
+ */
+struct WritePolicyStats {
+	std::atomic<uint64_t> nWrites { 0 };
+	std::atomic<uint64_t> nBytes { 0 };
+	PeerLatency oLatency;
+};
+
 /**
  * 每个缓存块对象的元数据信息
  * 在本地缓存 METACACHETTL s
@@ -109,6 +234,67 @@ public:
 	}
 };
 
+/**
+ * 一次刷新的状态，相邻脏块合并后的写入列表，由多个写入任务并行取出
+ */
+class SlabFlush {
+public:
+	typedef std::function<void(ssize_t state, const std::string & message)> FlushCallback;
+
+	std::mutex mtx;
+	std::list<std::pair<uint64_t, std::string> > oRuns; //待写入的偏移和数据，mtx 保护
+
+	std::vector<FlushCallback> oCallbacks;
+
+	/**
+	 * 本轮取出的一个脏块，失败时放回修改区间和日志序号
+	 */
+	struct FlushBlock {
+		size_t block_offset_id;
+		std::shared_ptr<SlabBlock> oSlabBlock;
+		std::vector<std::pair<uint32_t, uint32_t> > ranges;
+		std::vector<uint64_t> seqs; //块上的日志记录序号
+	};
+	std::vector<FlushBlock> oBlocks;
+
+	std::atomic<int> nWorkers { 0 }; //未结束的写入任务数
+	std::atomic<bool> bFailed { false };
+
+	ssize_t state { 0 }; //第一个错误，mtx 保护
+	std::string message;
+
+	/**
+	 * 取出下一段，没有或已经失败时返回 false
+	 */
+	bool Next(std::pair<uint64_t, std::string> & run) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (bFailed == true || oRuns.empty() == true) {
+			return false;
+		}
+		run.first = oRuns.front().first;
+		run.second.swap(oRuns.front().second);
+		oRuns.pop_front();
+		return true;
+	}
+
+	/**
+	 * 短写时把未写入的部分放回队首，由下一次写入继续
+	 */
+	void PutBack(uint64_t offset, std::string && data) {
+		std::lock_guard<std::mutex> lock(mtx);
+		oRuns.push_front(std::make_pair(offset, std::string()));
+		oRuns.front().second.swap(data);
+	}
+
+	void Fail(int code, const std::string & message_) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (bFailed.exchange(true) == false) {
+			state = -abs(code);
+			message = message_;
+		}
+	}
+};
+
 /**
  * 每个缓存块对象所在的文件对象
  * 相同文件在多线程调用，需要考虑线程安全问题
@@ -149,14 +335,73 @@ private:
 	std::atomic<time_t> stat_mtime { 0 };  // 会被多线程修改
 	std::atomic<off_t> stat_size { 0 }; // 会被多线程修改
 
+	/**
+	 * 文件结束位置，写入时不会清除，用于跳过文件结束位置之后的后端读取和确定追加写入位置
+	 */
+	std::mutex mtx_end;
+	off_t nBackendEnd { -1 }; //最近从后端获取的文件长度，-1 为未知，mtx_end 保护
+	time_t nBackendEndUpdated { 0 };
+	off_t nWriteEnd { 0 }; //本节点写入数据的结束位置，包括未刷新的数据，mtx_end 保护
+
+	/**
+	 * 元数据租约，租约期内元数据服务器会推送失效通知，可以直接使用缓存的元数据
+	 */
+	std::mutex mtx_lease;
+	std::atomic<time_t> nLeaseExpire { 0 }; //租约到期时间
+	uint64_t nLeaseEpoch { 0 }; //收到失效通知的次数，mtx_lease 保护
+
 	/**
 	 * 检查文件是否超时
 	 */
 	std::shared_ptr<boost::asio::deadline_timer> timer_Flush;
 	std::mutex mtx_flush;
+
+	/**
+	 * 正在进行的刷新，期间到达的刷新请求等待其完成后再处理新的脏块
+	 */
+	std::mutex mtx_flushing;
+	std::shared_ptr<SlabFlush> oFlushing;
+	std::vector<SlabFlush::FlushCallback> oFlushWaiters;
+
+	/**
+	 * 异步写入的日志记录：写入请求持有一次引用直到追加完成，每个脏块持有一次引用直到刷新成功
+	 * 引用全部释放的记录数据已经在后端，按最小的未释放序号通知日志
+	 */
+	std::mutex mtx_journal;
+	std::map<size_t, std::set<uint64_t> > oJournalBlocks; //脏块上的日志序号，mtx_journal 保护
+	std::map<uint64_t, size_t> oJournalSeqs; //未释放的日志序号和引用数，mtx_journal 保护
+	uint64_t nJournalMaxSeq { 0 }; //mtx_journal 保护
+	uint64_t nJournalReleased { 0 }; //已通知日志的序号，mtx_journal 保护
+
+	/**
+	 * 正在进行的后端块读取，相同块的其他读取等待其完成后重试
+	 */
+	std::mutex mtx_reading;
+	std::map<size_t, std::vector<std::function<void(void)> > > oBackendReadings;
 protected:
 
-	void FlushDirtyOne(const std::function<void(ssize_t state, const std::string & message)> & callback = nullptr);
+	/**
+	 * 取出全部脏块的修改区间，按文件偏移排序，首尾相接的区间合并后并行写入后端
+	 */
+	void FlushDirtyRuns(const std::vector<SlabFlush::FlushCallback> & callbacks);
+
+	/**
+	 * 一个写入任务，依次取出合并后的数据异步写入后端，最后一个任务结束时调用 FlushDone
+	 */
+	void FlushNextRun(const std::shared_ptr<SlabFlush> & oFlush, const std::shared_ptr<Backend> & oBackend,
+			bool admitted = false);
+
+	void FlushDone(const std::shared_ptr<SlabFlush> & oFlush);
+
+	/**
+	 * 刷新失败，本轮取出的块放回修改区间和日志序号，重新标记为脏块，稍后重试
+	 */
+	void RestoreDirty(const std::shared_ptr<SlabFlush> & oFlush);
+
+	/**
+	 * 取出块上的日志序号，交给本轮刷新
+	 */
+	void TakeJournalSeqs(size_t block_offset_id, std::vector<uint64_t> & seqs);
 
 	void ClearDirty();
 
@@ -180,6 +425,78 @@ public:
 		return used_time < ttl;
 	}
 
+	/**
+	 * 从后端获取了文件长度（属性或读取到文件结束位置）
+	 */
+	void SetBackendEnd(off_t size) {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		nBackendEnd = size;
+		nBackendEndUpdated = SystemUtils::now();
+	}
+
+	/**
+	 * 写入成功后扩展本节点写入的结束位置
+	 */
+	void ExtendWriteEnd(off_t end) {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		nWriteEnd = std::max(nWriteEnd, end);
+	}
+
+	/**
+	 * 文件被替换，已知长度作废
+	 */
+	void ResetEnd() {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		nBackendEnd = -1;
+		nWriteEnd = 0;
+	}
+
+	/**
+	 * 已知的文件结束位置，后端长度未知或超过 ttl 时返回 -1
+	 * 其他节点在 ttl 内直接写入后端存储的数据不可见，与属性缓存相同
+	 */
+	off_t GetDataEnd(uint32_t ttl) {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		if (nBackendEnd < 0 || (size_t) (SystemUtils::now() - nBackendEndUpdated) >= ttl) {
+			return -1;
+		}
+		return std::max(nBackendEnd, nWriteEnd);
+	}
+
+	/**
+	 * 已知的后端文件长度，不包括本节点未刷新的写入，未知或超过 ttl 时返回 -1
+	 */
+	off_t GetBackendEnd(uint32_t ttl) {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		if (nBackendEnd < 0 || (size_t) (SystemUtils::now() - nBackendEndUpdated) >= ttl) {
+			return -1;
+		}
+		return nBackendEnd;
+	}
+
+	/**
+	 * 追加写入预留 size 字节，返回写入位置，文件结束位置未知时返回 -1
+	 */
+	off_t ReserveAppend(size_t size, uint32_t ttl) {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		if (nBackendEnd < 0 || (size_t) (SystemUtils::now() - nBackendEndUpdated) >= ttl) {
+			return -1;
+		}
+		off_t offset = std::max(nBackendEnd, nWriteEnd);
+		nWriteEnd = offset + size;
+		return offset;
+	}
+
+	/**
+	 * 追加写入失败，之后没有其他预留时归还预留的空间，避免下一次追加留下空洞
+	 */
+	void CancelAppend(off_t offset, size_t size) {
+		std::lock_guard<std::mutex> lock(mtx_end);
+		if (nWriteEnd == (off_t) (offset + size)) {
+			nWriteEnd = offset;
+		}
+	}
+
 	void StatUpdate() {
 		nLastStatUpdated = SystemUtils::now();
 	}
@@ -197,6 +514,10 @@ public:
 		return nLastActivity;
 	}
 
+	bool HasLease() {
+		return SystemUtils::now() < nLeaseExpire;
+	}
+
 public:
 	SlabFile(SlabFileManager * pManager_, const std::shared_ptr<SlabFactory>& oSlabFactory_,
 			const std::string & filename_, bool memory_);
@@ -233,6 +554,21 @@ public:
 	 */
 	std::shared_ptr<mtsafe::CallBarrier<bool>> GetBarrier();
 
+	/**
+	 * 在块的串行调用中使用，返回 true 由调用者发起后端读取，否则 fRetry 在进行中的读取结束后投递到 io_service
+	 */
+	bool BeginBackendRead(size_t block_offset_id, const std::function<void(void)> & fRetry);
+
+	/**
+	 * 合并读取时认领相邻块，已有读取在进行时返回 false，不等待
+	 */
+	bool TryBeginBackendRead(size_t block_offset_id);
+
+	/**
+	 * 后端读取结束，数据已经加载到缓存块，投递等待的读取
+	 */
+	void EndBackendRead(size_t block_offset_id);
+
 	///////////////////////////
 	void PutMeta(size_t block_offset_id, const SlabMeta & oSlabMeta, uint32_t ttl);
 
@@ -244,15 +580,54 @@ public:
 
 	void ClearAttr();
 
+	/**
+	 * 发出元数据请求前获取，用于判断请求期间是否收到失效通知
+	 */
+	uint64_t GetLeaseEpoch();
+
+	/**
+	 * 请求期间没有收到失效通知，调用 fPutMeta 缓存元数据，并更新租约，lease_ttl 为 0 时没有租约
+	 * 收到过失效通知，元数据可能已经过时，不缓存，返回 false
+	 */
+	bool CommitLease(uint64_t epoch, uint32_t lease_ttl, const std::function<void()> & fPutMeta);
+
+	/**
+	 * 元数据服务器推送的失效通知，删除相应块的缓存元数据，block_ids 为空时整个文件失效并放弃租约
+	 */
+	void InvalidateMeta(const std::vector<uint32_t> & block_ids);
+
 	///////////////////////////
 	void AddBlock(size_t block_offset_id, const std::shared_ptr<SlabBlock>& oSlabBlock);
 
 	std::shared_ptr<SlabBlock> GetBlock(size_t block_offset_id);
 
 	/**
-	 * 异步写入时候，标记块为 弄需要写入后端
+	 * 异步写入时候，标记块为 弄需要写入后端，journal_seq 为该次写入预留的日志序号，块刷新成功后释放
 	 */
-	void AddDirty(size_t block_offset_id, const std::shared_ptr<SlabBlock>& oSlabBlock);
+	void AddDirty(size_t block_offset_id, const std::shared_ptr<SlabBlock>& oSlabBlock, uint64_t journal_seq = 0);
+
+	/**
+	 * 写入请求开始时持有预留的日志序号，追加完成或请求结束时释放
+	 */
+	void HoldJournalSeq(uint64_t seq);
+
+	/**
+	 * 释放日志序号的一次引用，序号之前的记录都已释放时通知日志
+	 */
+	void ReleaseJournalSeqs(const std::vector<uint64_t> & seqs);
+
+	/**
+	 * 异步写入时没有读取后端的部分块，读取之前合并后端存储中的块数据
+	 * 后端异步读取，完成后在 io_service 中回调，code 为 0 代表成功，不是部分块直接回调
+	 */
+	void MergeBackend(size_t block_offset_id, const std::shared_ptr<SlabBlock>& oSlabBlock,
+			const std::function<void(int code, const std::string & message)> & callback);
+
+	/**
+	 * 合并读取到的后端数据，ptr 为 NULL 时后端没有数据
+	 */
+	void MergeBackendDone(size_t block_offset_id, const std::shared_ptr<SlabBlock>& oSlabBlock, const char * ptr,
+			int bytes_readed, const std::function<void(int code, const std::string & message)> & callback);
 
 	/**
 	 * 手动刷新或定时刷新
@@ -308,11 +683,24 @@ public:
 
 #include "SlabChainOp.h"
 
+/**
+ * PutSlabMetas 的等待状态，所有块的确认共用一个计数，最后一个返回的请求回调
+ */
+class PutMetaWaiting {
+public:
+	std::mutex mtx;
+	size_t nPending { 0 };
+	std::string error; //第一个错误
+	int32_t iMetaUuid { 0 };
+};
+
 class SlabFileManager: public std::enable_shared_from_this<SlabFileManager> {
 public:
 	friend class SlabChainOp;
 	friend class SlabChainReader;
 	friend class SlabChainWriter;
+	friend class SlabChainVReader;
+	friend class SlabChainStreamer;
 	friend class SlabFile;
 private:
 	std::shared_ptr<SlabServerData> oServerData;
@@ -323,6 +711,11 @@ private:
 
 	std::shared_ptr<TcpMessager> oSlabMessager;
 
+	/**
+	 * 异步写入的本地预写日志，没有配置时为空
+	 */
+	std::shared_ptr<SlabJournal> oSlabJournal;
+
 	/**
 	 * 定时汇报节点状态
 	 */
@@ -341,6 +734,33 @@ private:
 	unsigned short int meta_port;
 
 	NetworkSpeed oNetworkSpeed;
+
+	/**
+	 * 邻居读取耗时和对冲读取统计
+	 */
+	PeerLatency oPeerLatency;
+
+	std::atomic<uint64_t> nPeerReads { 0 }; //邻居读取次数
+	std::atomic<uint64_t> nPeerHedges { 0 }; //启动对冲次数
+	std::atomic<uint64_t> nPeerHedgeWins { 0 }; //对冲先完成次数
+	PeerReadStats oPeerReadStats; //按邻居统计的邻居读取耗时，随状态汇报给元数据节点
+
+	std::atomic<bool> bMetaBatch { false }; //元数据服务器支持 caSlabPutMetaBatch，由状态汇报返回
+	std::atomic<uint64_t> nLeaseReads { 0 }; //持有租约，没有访问元数据服务器的读取次数
+	std::atomic<uint64_t> nLeaseInvalidations { 0 }; //收到的元数据失效通知数
+
+	std::atomic<uint64_t> nFlushWrites { 0 }; //刷新脏块的后端写入次数
+	std::atomic<uint64_t> nFlushBlocks { 0 }; //刷新的脏块数
+	std::atomic<uint64_t> nFlushBytes { 0 }; //刷新写入后端的修改区间字节数
+
+	std::atomic<uint64_t> nPartialWrites { 0 }; //没有读取后端直接写入的部分块数
+	std::atomic<uint64_t> nPartialMerges { 0 }; //部分块读取时合并后端数据次数
+
+	std::atomic<uint64_t> nReadMerges { 0 }; //合并多块的后端读取次数
+	std::atomic<uint64_t> nReadMergeBlocks { 0 }; //合并读取中附带加载的块数
+	std::atomic<uint64_t> nBeyondEndWrites { 0 }; //写入文件结束位置之后的块，跳过后端读取的次数
+
+	WritePolicyStats oWritePolicyStats[WritePolicy::wpCount]; //按写入策略统计
 public:
 	typedef std::function<void(time_t stat_mtime, off_t stat_size, int e_code, const std::string & e_message)> GetAttrCallback;
 
@@ -348,6 +768,11 @@ protected:
 
 	void ReportStatus();
 
+	/**
+	 * 状态汇报中附带的计数器，name = value 列表
+	 */
+	void WriteMetrics(const std::shared_ptr<stringbuffer> & output);
+
 	void TraceTrushes(float factor);
 
 	std::shared_ptr<TcpMessage> NewMetaMessage(int action);
@@ -359,12 +784,43 @@ protected:
 
 	void PostMessage(const std::shared_ptr<TcpMessage> & message);
 
+	/**
+	 * 阻塞的后端调用 fWork 在文件所在前缀的后端线程池中执行，完成后 fDone 投递到 io_service
+	 * 没有可用的线程池时在当前线程执行
+	 */
+	void RunBackend(const std::string & filename, const std::function<void(void)> & fWork,
+			const std::function<void(void)> & fDone);
+
 	/**
 	 * 修改文件的元数据：version, mtime & size
 	 */
 	void UpdateSlabMeta(uint32_t block_offset_id, const std::shared_ptr<SlabFile> & oSlabFile,
 			const std::shared_ptr<SlabBlock> & oSlabBlock);
 
+	/**
+	 * 一个请求修改文件多块的元数据，versions 为块编号和版本
+	 */
+	void UpdateSlabMetas(const std::shared_ptr<SlabFile> & oSlabFile, const std::map<uint32_t, int32_t> & versions);
+
+	/**
+	 * 构建 caSlabPutMetaBatch 请求，overwrite = 1 时清除其他节点信息
+	 */
+	std::shared_ptr<TcpMessage> NewPutMetaBatch(const std::shared_ptr<SlabFile> & oSlabFile,
+			const std::map<uint32_t, int32_t> & versions, int8_t overwrite);
+
+	/**
+	 * 构建单块 caSlabPutMeta 请求，用于不支持批量请求的旧元数据服务器
+	 */
+	std::shared_ptr<TcpMessage> NewPutMeta(const std::shared_ptr<SlabFile> & oSlabFile, uint32_t block_offset_id,
+			int32_t version, int8_t overwrite);
+
+	/**
+	 * 确认多块版本，元数据服务器支持时发送一个 caSlabPutMetaBatch，否则每块一个 caSlabPutMeta
+	 * 全部返回后回调，error 为空代表成功，iMetaUuid 为元数据端的文件 uuid
+	 */
+	void PutSlabMetas(const std::shared_ptr<SlabFile> & oSlabFile, const std::map<uint32_t, int32_t> & versions,
+			int8_t overwrite, const std::function<void(const std::string & error, int32_t iMetaUuid)> & callback);
+
 	/**
 	 * 修改文件的属性：mtime & size
 	 */
@@ -381,6 +837,20 @@ protected:
 	 * 与服务器文件不一致，需要重置
 	 */
 	void CheckFileUuid(int32_t iMetaUuid, const std::shared_ptr<SlabFile>& oSlabFile);
+
+	/**
+	 * 只读模式或持有租约时，本地缓存具有所需的全部元数据，返回 true，不需要访问元数据服务器
+	 */
+	bool UseCachedMeta(int8_t readonly, const std::shared_ptr<SlabFile>& oSlabFile,
+			const std::shared_ptr<SlabChainOp> & oSlabChainOp);
+
+	/**
+	 * 从元数据服务器获取所需块的版本和邻居信息，放入 oSlabChainOp，然后调用 fStart 开始处理
+	 * 元数据服务器故障时，离线模式下 fStart( true )，否则返回 resp_action 错误
+	 */
+	void GetSlabMeta(const std::shared_ptr<SlabFile>& oSlabFile, const std::vector<uint32_t> & BlockOffsetIds,
+			const std::shared_ptr<SlabChainOp> & oSlabChainOp, int8_t resp_action,
+			const std::shared_ptr<asio_server_tcp_connection> & conn, const std::function<void(bool offline)> & fStart);
 public:
 
 	SlabFileManager(const std::shared_ptr<SlabFactory> & oSlabFactory_,
@@ -399,8 +869,18 @@ public:
 	 * 写入数据，会先清除状态缓存
 	 *
 	 * 往相同文件同时写入无法保证数据准确性
+	 *
+	 * data 直接移交给写入任务，不再复制
 	 */
-	bool Write(const std::string & filename, off_t offset, const std::string & data, bool write_async,
+	bool Write(const std::string & filename, off_t offset, std::string && data, bool write_async,
+			const std::shared_ptr<asio_server_tcp_connection> & conn, bool append = false);
+
+	/**
+	 * 追加写入，写入位置为已知的文件结束位置（后端长度与本节点写入结束位置的较大者），未知时先获取文件属性
+	 * 同一节点上的追加按到达顺序排列，多个节点同时追加相同文件不保证顺序
+	 * 返回 caClientAppendResp，成功时附带写入位置
+	 */
+	bool Append(const std::string & filename, std::string && data, bool write_async,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
 	/**
@@ -413,6 +893,18 @@ public:
 	bool Read(const std::string & filename, int8_t readonly, off_t offset, size_t size,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
+	/**
+	 * 一次读取多个区间，所需块合并后只获取一次元数据，各块并行读取，全部完成后一次返回
+	 */
+	bool ReadV(const std::string & filename, int8_t readonly, const std::vector<std::pair<off_t, size_t> > & ranges,
+			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
+	/**
+	 * 流式读取，不受 MAX_REQUEST_SIZE 限制，每块数据就绪后立即作为一帧返回，最后一帧 last = 1
+	 */
+	bool ReadStream(const std::string & filename, int8_t readonly, off_t offset, size_t size,
+			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
 	/**
 	 * Read2 函数实现，读取单独一块数据，在client进行组装
 	 */
@@ -469,6 +961,12 @@ public:
 	ResultType PeerReadSlab(const std::string& filename, int32_t iMetaUuid, uint32_t block_offset_id, int32_t mVersion,
 			std::shared_ptr<stringbuffer> & output, const std::shared_ptr<asio_server_tcp_connection> & conn);
 
+	/**
+	 * 写入块数据到邻居读取的返回，并更新元数据，没有数据返回 false
+	 */
+	bool PeerReadData(const std::shared_ptr<SlabFile> & oSlabFile, uint32_t block_offset_id,
+			const std::shared_ptr<SlabBlock> & oSlabBlock, const std::shared_ptr<stringbuffer> & output);
+
 	/**
 	 * 元数据服务主动来检查文件的块是否有效，如果无效，本地删除同时反馈元数据进行删除
 	 */
@@ -476,6 +974,12 @@ public:
 	ResultType CheckItSlab(const std::shared_ptr<stringbuffer>& input, std::shared_ptr<stringbuffer>& output,
 			const std::shared_ptr<asio_server_tcp_connection>& conn);
 
+	/**
+	 * 元数据服务器推送的失效通知，其他节点修改了数据块版本，或文件被删除、截取
+	 */
+	ResultType InvalidateSlab(const std::shared_ptr<stringbuffer>& input, std::shared_ptr<stringbuffer>& output,
+			const std::shared_ptr<asio_server_tcp_connection>& conn);
+
 	void start();
 
 	void stop();
@@ -72,6 +72,10 @@ ResultType SlabFileService::hb_request(const std::shared_ptr<stringbuffer>& inpu
 		return DoClientWrite(input, output, worker_conn);
 	}
 
+	if (action == CacheAction::caClientAppend) { // 追加写入缓存数据
+		return DoClientAppend(input, output, worker_conn);
+	}
+
 	if (action == CacheAction::caClientRead) { // 读取缓存数据
 		return DoClientRead(input, output, worker_conn);
 	}
@@ -80,6 +84,14 @@ ResultType SlabFileService::hb_request(const std::shared_ptr<stringbuffer>& inpu
 		return DoClientRead2(input, output, worker_conn);
 	}
 
+	if (action == CacheAction::caClientReadV) { // 读取多个区间
+		return DoClientReadV(input, output, worker_conn);
+	}
+
+	if (action == CacheAction::caClientReadStream) { // 流式读取
+		return DoClientReadStream(input, output, worker_conn);
+	}
+
 	if (action == CacheAction::caSlabPeerRead) { //读取邻居缓存数据
 		return DoSlabPeerRead(input, output, worker_conn);
 	}
@@ -120,6 +132,10 @@ ResultType SlabFileService::hb_request(const std::shared_ptr<stringbuffer>& inpu
 		return DoMasterCheckIt(input, output, worker_conn);
 	}
 
+	if (action == CacheAction::caMasterInvalidate) {
+		return DoMasterInvalidate(input, output, worker_conn);
+	}
+
 	return ResultType::rtFailed;
 }
 
@@ -159,6 +175,95 @@ ResultType SlabFileService::DoClientRead(const std::shared_ptr<stringbuffer> & i
 	return ResultType::rtNothing;
 }
 
+/**
+ * 一次读取文件的多个区间，区间总长度不超过 MAX_REQUEST_SIZE
+ */
+ResultType SlabFileService::DoClientReadV(const std::shared_ptr<stringbuffer> & input,
+		std::shared_ptr<stringbuffer> & output, const std::shared_ptr<asio_server_tcp_connection> & conn) {
+
+	std::string filename;
+	int8_t readonly;
+	uint32_t nRanges;
+
+	if (input->read_str(filename) == false || input->read_int8(readonly) == false
+			|| input->read_uint32(nRanges) == false) {
+		return ResultType::rtFailed;
+	}
+
+	if (nRanges > MAX_READV_RANGES) {
+		output->write_int8(CacheAction::caClientReadVResp);
+		output->write_int32(tsFailed);
+		output->write_str("Too many ranges");
+		return ResultType::rtSuccess;
+	}
+
+	std::vector<std::pair<off_t, size_t> > ranges;
+	size_t total_size = 0;
+
+	for (uint32_t idx = 0; idx < nRanges; idx++) {
+		off_t offset;
+		size_t buffer_size;
+
+		if (input->read_int64(offset) == false || input->read_uint64(buffer_size) == false) {
+			return ResultType::rtFailed;
+		}
+
+		if (offset < 0) {
+			output->write_int8(CacheAction::caClientReadVResp);
+			output->write_int32(tsFailed);
+			output->write_str("Invalid offset");
+			return ResultType::rtSuccess;
+		}
+
+		total_size += buffer_size;
+		if (buffer_size > MAX_REQUEST_SIZE || total_size > MAX_REQUEST_SIZE) {
+			output->write_int8(CacheAction::caClientReadVResp);
+			output->write_int32(tsFailed);
+			output->write_str("Request too large");
+			return ResultType::rtSuccess;
+		}
+
+		ranges.push_back(std::make_pair(offset, buffer_size));
+	}
+
+	if (oSlabFileManager->ReadV(filename, readonly, ranges, conn) == false) {
+		return ResultType::rtFailed;
+	}
+
+	return ResultType::rtNothing;
+}
+
+/**
+ * 流式读取，不限制长度，数据按块分帧返回
+ */
+ResultType SlabFileService::DoClientReadStream(const std::shared_ptr<stringbuffer> & input,
+		std::shared_ptr<stringbuffer> & output, const std::shared_ptr<asio_server_tcp_connection> & conn) {
+
+	std::string filename;
+
+	int8_t readonly;
+	off_t offset;
+	size_t buffer_size;
+
+	if (input->read_str(filename) == false || input->read_int8(readonly) == false
+			|| input->read_int64(offset) == false || input->read_uint64(buffer_size) == false) {
+		return ResultType::rtFailed;
+	}
+
+	if (offset < 0 || (off_t) buffer_size < 0 || offset + (off_t) buffer_size < offset) {
+		output->write_int8(CacheAction::caClientReadStreamResp);
+		output->write_int32(tsFailed);
+		output->write_str("Invalid offset");
+		return ResultType::rtSuccess;
+	}
+
+	if (oSlabFileManager->ReadStream(filename, readonly, offset, buffer_size, conn) == false) {
+		return ResultType::rtFailed;
+	}
+
+	return ResultType::rtNothing;
+}
+
 /**
  * Read2 函数实现，读取单独一块数据，在client进行组装
  */
@@ -216,7 +321,32 @@ ResultType SlabFileService::DoClientWrite(const std::shared_ptr<stringbuffer> &
 	 * 异步写入
 	 */
 
-	if (oSlabFileManager->Write(filename, offset, data, write_async, conn) == false) {
+	if (oSlabFileManager->Write(filename, offset, std::move(data), write_async, conn) == false) {
+		return ResultType::rtFailed;
+	}
+
+	return ResultType::rtNothing;
+}
+
+ResultType SlabFileService::DoClientAppend(const std::shared_ptr<stringbuffer> & input,
+		std::shared_ptr<stringbuffer> & output, const std::shared_ptr<asio_server_tcp_connection> & conn) {
+
+	std::string filename;
+	int8_t readonly;
+	std::string data;
+
+	if (input->read_str(filename) == false || input->read_int8(readonly) == false || input->read_str(data) == false) {
+		return ResultType::rtFailed;
+	}
+
+	bool write_async = false;
+	int8_t iasync = 0;
+
+	if (input->read_int8(iasync) == true && iasync == 1) {
+		write_async = true;
+	}
+
+	if (oSlabFileManager->Append(filename, std::move(data), write_async, conn) == false) {
 		return ResultType::rtFailed;
 	}
 
@@ -362,6 +492,13 @@ ResultType SlabFileService::DoMasterCheckIt(const std::shared_ptr<stringbuffer>&
 
 }
 
+ResultType SlabFileService::DoMasterInvalidate(const std::shared_ptr<stringbuffer>& input,
+		std::shared_ptr<stringbuffer>& output, const std::shared_ptr<asio_server_tcp_connection>& conn) {
+
+	return oSlabFileManager->InvalidateSlab(input, output, conn);
+
+}
+
 void SlabFileService::run_server() {
 	LOGGER_TRACE(
 			"#" << __LINE__ << ", SlabFileService::run_server, Port: " << oServerData->slab_port << ", max_slabs: " << oServerData->max_memory_slabs << ", Worker: " << oServerData->workers);
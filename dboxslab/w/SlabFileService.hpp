@@ -49,12 +49,21 @@ protected:
 	ResultType DoClientRead(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer> & output,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
+	ResultType DoClientReadV(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer> & output,
+			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
+	ResultType DoClientReadStream(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer> & output,
+			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
 	ResultType DoClientRead2(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer> & output,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
 	ResultType DoClientWrite(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer> & output,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
+	ResultType DoClientAppend(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer> & output,
+			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
 	ResultType DoClientUnlink(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer>& output,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
@@ -85,6 +94,9 @@ protected:
 	ResultType DoMasterCheckIt(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer>& output,
 			const std::shared_ptr<asio_server_tcp_connection> & conn);
 
+	ResultType DoMasterInvalidate(const std::shared_ptr<stringbuffer> & input, std::shared_ptr<stringbuffer>& output,
+			const std::shared_ptr<asio_server_tcp_connection> & conn);
+
 public:
 
 	SlabFileService(const std::shared_ptr<SlabServerData>& serverdata_, const ConfReader & conf_);
@@ -0,0 +1,535 @@
+/*
+ * SlabJournal.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <databox/stringutils.hpp>
+
+#include "SlabJournal.hpp"
+
+/**
+ * 记录头: magic, 数据长度, 校验和，数据: type, seq, filename, offset, data
+ */
+struct JournalHeader {
+	uint32_t magic;
+	uint32_t length;
+	uint32_t checksum;
+};
+
+static uint32_t JournalChecksum(const char * data, size_t size) {
+	uint32_t hash = 2166136261u; // FNV-1a
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (uint8_t) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static bool WriteFully(int fd, const char * data, size_t size) {
+	while (size > 0) {
+		ssize_t bytes = write(fd, data, size);
+		if (bytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += bytes;
+		size -= bytes;
+	}
+	return true;
+}
+
+static bool ReadFully(int fd, char * data, size_t size) {
+	while (size > 0) {
+		ssize_t bytes = read(fd, data, size);
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes <= 0) {
+			return false;
+		}
+		data += bytes;
+		size -= bytes;
+	}
+	return true;
+}
+
+SlabJournal::SlabJournal(const std::string& path, bool sync, uint64_t segment_size) :
+		sPath(path), bSync(sync), nSegmentSize(segment_size) {
+	LOGGER_TRACE("#" << __LINE__ << ", SlabJournal::SlabJournal, " << sPath << ", sync: " << bSync);
+
+	oThread = std::thread([ this ]() {
+		this->Run();
+	});
+}
+
+SlabJournal::~SlabJournal() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		bStopping = true;
+	}
+	cond.notify_all();
+
+	if (oThread.joinable() == true) {
+		oThread.join();
+	}
+
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+}
+
+std::string SlabJournal::SegmentPath(uint64_t id) const {
+	return sPath + "/journal." + StringUtils::ToString(id);
+}
+
+bool SlabJournal::OpenSegment(uint64_t id) {
+	if (fd >= 0) {
+		/**
+		 * 当前段中本批已写入的记录还没有同步
+		 */
+		if (bSync == true && fdatasync(fd) != 0) {
+			LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::OpenSegment, Sync: " << oSegments.back().path << ", Error: " << strerror(errno));
+			return false;
+		}
+		close(fd);
+		fd = -1;
+	}
+
+	JournalSegment oSegment;
+	oSegment.id = id;
+	oSegment.path = SegmentPath(id);
+
+	fd = open(oSegment.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::OpenSegment: " << oSegment.path << ", Error: " << strerror(errno));
+		return false;
+	}
+
+	nActiveSize = 0;
+	oSegments.push_back(oSegment);
+
+	/**
+	 * 每段以启动记录开头，标明所属的运行
+	 */
+	if (WriteRecord(JournalRecordType::jrStart, nRunId, "", 0, "", 0) == false) {
+		return false;
+	}
+	nStartSize = nActiveSize;
+	return WriteKeptDiscards();
+}
+
+/**
+ * 先读取所有刷新和丢弃记录，再按顺序重放没有被覆盖的数据记录
+ *
+ * 每段开头的启动记录标明该段属于哪一次运行，序号在每次运行中各自分配：
+ * 刷新记录只覆盖同一次运行的记录，丢弃记录同时覆盖之前运行保留下来的全部记录
+ */
+bool SlabJournal::Replay(
+		const std::function<bool(const std::string & filename, off_t offset, const std::string & data)> & callback,
+		const std::function<bool()> & fSync, bool bForce) {
+
+	if (FileSystemUtils::MakeDirs(sPath) == false) {
+		LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::Replay, Not Exist: " << sPath);
+		return false;
+	}
+
+	std::vector<uint64_t> ids;
+
+	DIR * dir = opendir(sPath.c_str());
+	if (dir == NULL) {
+		LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::Replay: " << sPath << ", Error: " << strerror(errno));
+		return false;
+	}
+
+	struct dirent * entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const std::string name = entry->d_name;
+		if (name.find("journal.") != 0) {
+			continue;
+		}
+
+		long id = StringUtils::ToLong(name.substr(8), -1);
+		if (id >= 0) {
+			ids.push_back(id);
+		}
+	}
+	closedir(dir);
+
+	std::sort(ids.begin(), ids.end());
+
+	std::map<std::pair<uint64_t, std::string>, uint64_t> flushed_seqs; //(运行, 文件) 已刷新的序号
+	std::map<std::string, std::pair<uint64_t, uint64_t> > discard_seqs; //文件最后一次丢弃的 (运行, 序号)
+
+	for (uint64_t id : ids) {
+		uint64_t run = 0; //没有启动记录的段来自旧版本
+		ReadSegment(SegmentPath(id),
+				[ &run, &flushed_seqs, &discard_seqs ](int8_t type, uint64_t seq, const std::string & filename, off_t offset, const std::string & data ) {
+					if ( type == JournalRecordType::jrStart ) {
+						run = seq;
+					} else if ( type == JournalRecordType::jrFlushed ) {
+						uint64_t & flushed = flushed_seqs[std::make_pair( run, filename )];
+						flushed = std::max( flushed, seq );
+					} else if ( type == JournalRecordType::jrDiscard ) {
+						std::pair<uint64_t, uint64_t> & discard = discard_seqs[filename];
+						discard = std::max( discard, std::make_pair( run, seq ) );
+					}
+					return true;
+				});
+	}
+
+	size_t nRecords = 0;
+	bool bOk = true;
+	for (uint64_t id : ids) {
+		uint64_t run = 0;
+		bOk = ReadSegment(SegmentPath(id),
+				[ &run, &flushed_seqs, &discard_seqs, &nRecords, callback ](int8_t type, uint64_t seq, const std::string & filename, off_t offset, const std::string & data ) {
+					if ( type == JournalRecordType::jrStart ) {
+						run = seq;
+						return true;
+					}
+
+					if ( type != JournalRecordType::jrData ) {
+						return true;
+					}
+
+					auto flushed = flushed_seqs.find( std::make_pair( run, filename ) );
+					if ( flushed != flushed_seqs.end() && flushed->second >= seq ) {
+						return true;
+					}
+
+					auto discard = discard_seqs.find( filename );
+					if ( discard != discard_seqs.end() && discard->second >= std::make_pair( run, seq ) ) {
+						return true;
+					}
+
+					nRecords++;
+					return callback( filename, offset, data );
+				});
+
+		if (bOk == false) {
+			break;
+		}
+	}
+
+	/**
+	 * 重放的数据落盘后才能删除旧段
+	 */
+	if (bOk == true && fSync && fSync() == false) {
+		bOk = false;
+	}
+
+	if (bOk == true) {
+		LOGGER_INFO("#" << __LINE__ << ", SlabJournal::Replay: " << sPath << ", Segments: " << ids.size() << ", Records: " << nRecords);
+
+		for (uint64_t id : ids) {
+			unlink(SegmentPath(id).c_str());
+		}
+	} else if (bForce == true) {
+		bKept = true;
+		LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::Replay, Failed, keep segments: " << sPath << ", Segments: " << ids.size());
+	} else {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx_segments);
+	nRunId = ids.empty() ? 1 : ids.back() + 1;
+	return OpenSegment(nRunId) == true && bOk == true;
+}
+
+/**
+ * 读到不完整或校验失败的记录时结束，说明该记录写入时发生了崩溃，没有返回给客户端
+ * callback 返回 false 时返回 false
+ */
+bool SlabJournal::ReadSegment(const std::string & path, const RecordCallback & callback) {
+
+	int rfd = open(path.c_str(), O_RDONLY);
+	if (rfd < 0) {
+		LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::ReadSegment: " << path << ", Error: " << strerror(errno));
+		return true;
+	}
+
+	JournalHeader header;
+
+	while (ReadFully(rfd, (char *) &header, sizeof(header)) == true) {
+		if (header.magic != JOURNAL_MAGIC) {
+			break;
+		}
+
+		std::string payload(header.length, '\0');
+		if (ReadFully(rfd, &payload[0], header.length) == false
+				|| JournalChecksum(payload.c_str(), payload.size()) != header.checksum) {
+			break;
+		}
+
+		stringbuffer s_val;
+		s_val.str(payload);
+
+		int8_t type;
+		uint64_t seq;
+		std::string filename;
+		int64_t offset;
+		std::string data;
+
+		if (s_val.read_int8(type) == false || s_val.read_uint64(seq) == false || s_val.read_str(filename) == false
+				|| s_val.read_int64(offset) == false || s_val.read_str(data) == false) {
+			break;
+		}
+
+		if (callback(type, seq, filename, offset, data) == false) {
+			close(rfd);
+			return false;
+		}
+	}
+
+	close(rfd);
+	return true;
+}
+
+bool SlabJournal::WriteRecord(int8_t type, uint64_t seq, const std::string & filename, off_t offset,
+		const char * data, size_t size) {
+	if (fd < 0) {
+		return false;
+	}
+
+	if (nActiveSize >= (off_t) nSegmentSize) {
+		if (OpenSegment(oSegments.back().id + 1) == false) {
+			return false;
+		}
+	}
+
+	stringbuffer s_val;
+	s_val.write_int8(type);
+	s_val.write_uint64(seq);
+	s_val.write_str(filename);
+	s_val.write_int64(offset);
+	s_val.write_str(data, size);
+
+	const std::string & payload = s_val.str();
+
+	JournalHeader header;
+	header.magic = JOURNAL_MAGIC;
+	header.length = payload.size();
+	header.checksum = JournalChecksum(payload.c_str(), payload.size());
+
+	if (WriteFully(fd, (const char *) &header, sizeof(header)) == false
+			|| WriteFully(fd, payload.c_str(), payload.size()) == false) {
+		LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::WriteRecord: " << filename << ", Error: " << strerror(errno));
+		return false;
+	}
+
+	nActiveSize += sizeof(header) + payload.size();
+	return true;
+}
+
+void SlabJournal::Post(const std::shared_ptr<JournalRecord> & oRecord) {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		oPendings.push_back(oRecord);
+	}
+	cond.notify_one();
+}
+
+uint64_t SlabJournal::Reserve() {
+	std::lock_guard<std::mutex> lock(mtx);
+	return ++nSeq;
+}
+
+/**
+ * 序号在写入缓存块之前预留，记录按完成顺序入队，序号不一定递增
+ */
+void SlabJournal::Append(const std::string & filename, uint64_t seq, off_t offset, const char * data, size_t size,
+		const std::function<void(bool bOk)> & callback) {
+
+	std::shared_ptr<JournalRecord> oRecord = std::make_shared<JournalRecord>();
+	oRecord->type = JournalRecordType::jrData;
+	oRecord->seq = seq;
+	oRecord->filename = filename;
+	oRecord->offset = offset;
+	oRecord->data.assign(data, size);
+	oRecord->callback = callback;
+
+	Post(oRecord);
+}
+
+uint64_t SlabJournal::Mark() {
+	std::lock_guard<std::mutex> lock(mtx);
+	return nSeq;
+}
+
+/**
+ * 追加刷新记录，重启时不再重放该文件 seq 之前的数据
+ */
+void SlabJournal::Flushed(const std::string & filename, uint64_t seq) {
+	std::shared_ptr<JournalRecord> oRecord = std::make_shared<JournalRecord>();
+	oRecord->type = JournalRecordType::jrFlushed;
+	oRecord->seq = seq;
+	oRecord->filename = filename;
+
+	Post(oRecord);
+}
+
+/**
+ * 追加丢弃记录，重启时不再重放该文件当前序号之前的数据
+ */
+void SlabJournal::Discard(const std::string & filename) {
+	std::shared_ptr<JournalRecord> oRecord = std::make_shared<JournalRecord>();
+	oRecord->type = JournalRecordType::jrDiscard;
+	oRecord->seq = Mark();
+	oRecord->filename = filename;
+
+	Post(oRecord);
+}
+
+void SlabJournal::Run() {
+	while (true) {
+		std::list<std::shared_ptr<JournalRecord> > records;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cond.wait(lock, [ this ]() {
+				return bStopping == true || oPendings.empty() == false;
+			});
+
+			if (oPendings.empty() == true) { //退出前写完全部记录
+				return;
+			}
+			records.swap(oPendings);
+		}
+
+		/**
+		 * 一批记录中任何一条写入或同步失败，本批数据记录都按失败回调，由写入请求先刷新到后端
+		 */
+		bool bOk = true;
+		{
+			std::lock_guard<std::mutex> lock(mtx_segments);
+
+			for (const auto & oRecord : records) {
+				if (oRecord->type != JournalRecordType::jrData) {
+					ReleaseRecords(oRecord->type, oRecord->filename, oRecord->seq);
+					continue;
+				}
+
+				if (bOk == false) {
+					continue;
+				}
+
+				if (WriteRecord(oRecord->type, oRecord->seq, oRecord->filename, oRecord->offset,
+						oRecord->data.c_str(), oRecord->data.size()) == false) {
+					bOk = false;
+					continue;
+				}
+
+				uint64_t & last_seq = oSegments.back().oLastSeqs[oRecord->filename];
+				last_seq = std::max(last_seq, oRecord->seq);
+			}
+
+			if (bOk == true && bSync == true && fd >= 0 && fdatasync(fd) != 0) {
+				LOGGER_ERROR("#" << __LINE__ << ", SlabJournal::Run, Sync Error: " << strerror(errno));
+				bOk = false;
+			}
+		}
+
+		for (const auto & oRecord : records) {
+			if (oRecord->type != JournalRecordType::jrData) {
+				continue;
+			}
+
+			if (bOk == true) {
+				nAppends++;
+				nAppendBytes += oRecord->data.size();
+			}
+
+			if (oRecord->callback) {
+				oRecord->callback(bOk);
+			}
+		}
+	}
+}
+
+void SlabJournal::ReleaseRecords(int8_t type, const std::string & filename, uint64_t seq) {
+	/**
+	 * 有保留的旧段时，丢弃记录还要覆盖旧段中该文件的记录，总是写入
+	 */
+	bool bKeptDiscard = type == JournalRecordType::jrDiscard && bKept == true;
+
+	uint64_t & flushed = oFlushedSeqs[filename];
+	if (seq <= flushed && bKeptDiscard == false) {
+		return;
+	}
+	flushed = std::max(flushed, seq);
+
+	bool bPending = false;
+	for (const JournalSegment & oSegment : oSegments) {
+		if (oSegment.oLastSeqs.count(filename) > 0) {
+			bPending = true;
+			break;
+		}
+	}
+
+	if (bKeptDiscard == true) {
+		oKeptDiscards[filename] = seq;
+	}
+
+	if (bPending == true || bKeptDiscard == true) {
+		WriteRecord(type, seq, filename, 0, "", 0);
+	}
+
+	RemoveFlushedSegments();
+}
+
+/**
+ * 删除全部记录都已刷新的旧段，当前段的记录全部刷新后截断
+ */
+void SlabJournal::RemoveFlushedSegments() {
+	for (JournalSegment & oSegment : oSegments) {
+		for (auto iter = oSegment.oLastSeqs.begin(); iter != oSegment.oLastSeqs.end();) {
+			auto flushed = oFlushedSeqs.find(iter->first);
+			if (flushed != oFlushedSeqs.end() && flushed->second >= iter->second) {
+				iter = oSegment.oLastSeqs.erase(iter);
+			} else {
+				iter++;
+			}
+		}
+	}
+
+	while (oSegments.size() > 1 && oSegments.front().oLastSeqs.empty() == true) {
+		LOGGER_TRACE("#" << __LINE__ << ", SlabJournal::RemoveFlushedSegments: " << oSegments.front().path);
+		unlink(oSegments.front().path.c_str());
+		oSegments.pop_front();
+	}
+
+	if (oSegments.size() == 1 && oSegments.back().oLastSeqs.empty() == true && nActiveSize > nKeptSize && fd >= 0) {
+		/**
+		 * 没有未刷新的记录，当前段从启动记录之后重新开始
+		 */
+		if (ftruncate(fd, nStartSize) == 0) {
+			nActiveSize = nStartSize;
+			oFlushedSeqs.clear();
+			WriteKeptDiscards();
+		}
+	}
+}
+
+bool SlabJournal::WriteKeptDiscards() {
+	for (const auto & discard : oKeptDiscards) {
+		if (WriteRecord(JournalRecordType::jrDiscard, discard.second, discard.first, 0, "", 0) == false) {
+			return false;
+		}
+	}
+	nKeptSize = nActiveSize;
+	return true;
+}
@@ -0,0 +1,179 @@
+/*
+ * SlabJournal.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#ifndef W_SLABJOURNAL_HPP_
+#define W_SLABJOURNAL_HPP_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <functional>
+
+#include <databox/stringbuffer.hpp>
+#include <databox/filesystemutils.hpp>
+#include <databox/cpl_debug.h>
+
+#define JOURNAL_MAGIC 0x314A4244 // DBJ1
+
+enum JournalRecordType {
+	jrData = 0, //写入的数据
+	jrFlushed = 1, //文件刷新完成，该文件序号之前的数据记录不再需要
+	jrDiscard = 2, //文件删除或截断，缓存数据已丢弃，该文件序号之前以及之前运行保留的数据记录不再重放
+	jrStart = 3 //段的第一条记录，seq 为本次运行的编号
+};
+
+/**
+ * 等待日志线程写入的记录，callback 在日志线程中调用
+ */
+struct JournalRecord {
+	int8_t type { JournalRecordType::jrData };
+	uint64_t seq { 0 };
+	std::string filename;
+	off_t offset { 0 };
+	std::string data;
+	std::function<void(bool bOk)> callback;
+};
+
+/**
+ * 一个日志段文件，记录其中每个文件最后一条记录的序号
+ */
+struct JournalSegment {
+	uint64_t id { 0 };
+	std::string path;
+	std::map<std::string, uint64_t> oLastSeqs;
+};
+
+/**
+ * 异步写入的本地预写日志，追加写入到快速磁盘
+ *
+ * 写入请求返回前追加一条记录 (filename, offset, data)，脏块刷新到后端后追加刷新记录，
+ * 段内所有记录都已刷新的旧段被删除；重启时按顺序把未刷新的记录重放到后端存储
+ *
+ * 记录由专门的日志线程按顺序写入，一批记录只 fdatasync 一次（组提交），同步完成后回调
+ */
+class SlabJournal {
+private:
+	std::string sPath;
+	bool bSync { true }; //每批记录后 fdatasync
+	uint64_t nSegmentSize { 64 * 1024 * 1024 };
+
+	std::mutex mtx;
+	std::condition_variable cond;
+	uint64_t nSeq { 0 }; //最后一条记录的序号，mtx 保护
+	std::list<std::shared_ptr<JournalRecord> > oPendings; //等待写入的记录，mtx 保护
+	bool bStopping { false };
+	std::thread oThread;
+
+	std::mutex mtx_segments;
+	int fd { -1 }; //当前段，mtx_segments 保护，以下同
+	off_t nActiveSize { 0 };
+	off_t nStartSize { 0 }; //当前段启动记录之后的位置
+	off_t nKeptSize { 0 }; //当前段重写的丢弃记录之后的位置，之后没有记录时不再截断
+	uint64_t nRunId { 0 }; //本次运行的编号，为打开的第一个段的编号，之后递增
+	bool bKept { false }; //重放失败，保留了之前运行的旧段
+	std::map<std::string, uint64_t> oKeptDiscards; //保留旧段时的丢弃记录，截断和换段后重写，一直覆盖旧段
+	std::list<JournalSegment> oSegments; //最后一个为当前段
+	std::map<std::string, uint64_t> oFlushedSeqs; //每个文件已刷新到后端的记录序号
+
+protected:
+	typedef std::function<bool(int8_t type, uint64_t seq, const std::string & filename, off_t offset,
+			const std::string & data)> RecordCallback;
+
+	/**
+	 * 打开新段，按配置先同步当前段
+	 */
+	bool OpenSegment(uint64_t id);
+
+	/**
+	 * 追加一条记录，不同步，mtx_segments 保护
+	 */
+	bool WriteRecord(int8_t type, uint64_t seq, const std::string & filename, off_t offset, const char * data,
+			size_t size);
+
+	/**
+	 * 日志线程，每次取出全部等待的记录写入，同步一次后回调
+	 */
+	void Run();
+
+	/**
+	 * 放入等待队列，由日志线程写入
+	 */
+	void Post(const std::shared_ptr<JournalRecord> & oRecord);
+
+	/**
+	 * 文件 seq 之前的记录不再需要，有未刷新记录时写入 type 记录，mtx_segments 保护
+	 */
+	void ReleaseRecords(int8_t type, const std::string & filename, uint64_t seq);
+
+	void RemoveFlushedSegments();
+
+	/**
+	 * 在当前段的启动记录之后重写保留旧段时的丢弃记录
+	 */
+	bool WriteKeptDiscards();
+
+	std::string SegmentPath(uint64_t id) const;
+
+	bool ReadSegment(const std::string & path, const RecordCallback & callback);
+
+public:
+	std::atomic<uint64_t> nAppends { 0 };
+	std::atomic<uint64_t> nAppendBytes { 0 };
+
+	SlabJournal(const std::string & path, bool sync, uint64_t segment_size);
+
+	~SlabJournal();
+
+	/**
+	 * 按顺序重放已有的日志段，全部成功并且 fSync 成功后删除旧段并打开新段
+	 * callback 或 fSync 返回 false 时保留旧段并返回 false，bForce 为 true 时仍然打开新段，旧段下次启动时再重放
+	 */
+	bool Replay(
+			const std::function<bool(const std::string & filename, off_t offset, const std::string & data)> & callback,
+			const std::function<bool()> & fSync = nullptr, bool bForce = false);
+
+	/**
+	 * 写入缓存块之前预留记录序号，脏块记下该序号，刷新后按块释放
+	 */
+	uint64_t Reserve();
+
+	/**
+	 * 追加一条记录，seq 由 Reserve 预留，写入并同步后在日志线程中回调，bOk 为 false 说明日志不可用，数据只在内存中
+	 */
+	void Append(const std::string & filename, uint64_t seq, off_t offset, const char * data, size_t size,
+			const std::function<void(bool bOk)> & callback);
+
+	/**
+	 * 当前最大的序号
+	 */
+	uint64_t Mark();
+
+	/**
+	 * 文件 seq 及之前的记录数据都已经写入后端，不再需要
+	 */
+	void Flushed(const std::string & filename, uint64_t seq);
+
+	/**
+	 * 文件被删除或截断，缓存中的修改已丢弃，之前的记录不再重放
+	 */
+	void Discard(const std::string & filename);
+
+	size_t GetNumSegments() {
+		std::lock_guard<std::mutex> lock(mtx_segments);
+		return oSegments.size();
+	}
+};
+
+#endif /* W_SLABJOURNAL_HPP_ */
@@ -0,0 +1,134 @@
+/*
+ * RadosAioQueue_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "rados_cc.hpp"
+
+/**
+ * 每个测试使用独立的替身目录，RADOS_STUB_DELAY_USEC 让请求同时在途
+ */
+class RadosAioQueueTest: public ::testing::Test {
+protected:
+	std::string sRoot;
+	std::shared_ptr<CephNode> oNode;
+	std::shared_ptr<RadosContext> ctx;
+	std::shared_ptr<RadosAioQueue> queue;
+
+	std::mutex mtx;
+	std::condition_variable cond;
+	int nDone { 0 };
+	size_t nMaxInflight { 0 }; //回调中观察到的最大在途数
+
+	void SetUp() override {
+		char root[] = "/tmp/rados_stub_test.XXXXXX";
+		ASSERT_TRUE(mkdtemp(root) != NULL);
+		sRoot = root;
+		setenv("RADOS_STUB_ROOT", root, 1);
+		setenv("RADOS_STUB_DELAY_USEC", "2000", 1);
+
+		oNode = std::make_shared<CephNode>("ceph0", "", "admin");
+		ASSERT_EQ(oNode->connect(), 0);
+		ctx = oNode->ctx("pool");
+		ASSERT_TRUE(ctx->ioctx() != NULL);
+	}
+
+	void TearDown() override {
+		queue.reset();
+		ctx.reset();
+		oNode.reset();
+
+		nftw(sRoot.c_str(), [](const char * path, const struct stat * st, int flag, struct FTW * ftw ) {
+			return remove( path );
+		}, 8, FTW_DEPTH | FTW_PHYS);
+	}
+
+	RadosAioRequest * NewRequest(bool write, const std::string & oid, char * buf, size_t len, uint64_t off,
+			int & result) {
+		RadosAioRequest * request = new RadosAioRequest();
+		request->write = write;
+		request->ctx = ctx;
+		request->oid = oid;
+		request->buf = buf;
+		request->len = len;
+		request->off = off;
+		request->callback = [ this, &result ]( int ret ) {
+			size_t inflight = 0, waiting = 0;
+			queue->GetDepth(inflight, waiting);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			nMaxInflight = std::max(nMaxInflight, inflight);
+			result = ret;
+			nDone++;
+			cond.notify_all();
+		};
+		return request;
+	}
+
+	void Wait(int count) {
+		std::unique_lock<std::mutex> lock(mtx);
+		cond.wait(lock, [ this, count ]() {
+			return nDone >= count;
+		});
+	}
+};
+
+TEST_F(RadosAioQueueTest, WriteThenRead) {
+	queue = std::make_shared<RadosAioQueue>(2);
+
+	const int count = 8;
+	std::vector<std::string> datas(count);
+	std::vector<int> results(count, 0);
+	for (int i = 0; i < count; i++) {
+		datas[i] = "object data " + std::to_string(i);
+		queue->Submit(NewRequest(true, "obj/" + std::to_string(i), (char *) datas[i].c_str(), datas[i].size(), 0, results[i]));
+	}
+	Wait(count);
+
+	for (int i = 0; i < count; i++) {
+		EXPECT_EQ(results[i], (int ) datas[i].size());
+	}
+
+	/**
+	 * 超过在途上限的请求进入等待列表，在途数不超过上限
+	 */
+	EXPECT_EQ(queue->nRequests, (uint64_t ) count);
+	EXPECT_GT(queue->nParked, (uint64_t ) 0);
+	EXPECT_LE(nMaxInflight, (size_t ) 2);
+
+	std::vector<std::string> buffers(count, std::string(64, '\0'));
+	for (int i = 0; i < count; i++) {
+		queue->Submit(NewRequest(false, "obj/" + std::to_string(i), (char *) buffers[i].c_str(), buffers[i].size(), 0, results[i]));
+	}
+	Wait(count * 2);
+
+	for (int i = 0; i < count; i++) {
+		ASSERT_EQ(results[i], (int ) datas[i].size());
+		EXPECT_EQ(buffers[i].substr(0, results[i]), datas[i]);
+	}
+}
+
+TEST_F(RadosAioQueueTest, ReadMissing) {
+	queue = std::make_shared<RadosAioQueue>(1);
+
+	char buffer[16];
+	int result = 0;
+	queue->Submit(NewRequest(false, "missing", buffer, sizeof(buffer), 0, result));
+	Wait(1);
+
+	EXPECT_EQ(result, -ENOENT);
+}
@@ -0,0 +1,161 @@
+/*
+ * RadosStripe_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+
+#include "rados_stripe.hpp"
+
+#define TEST_STRIPE_SIZE 16
+
+class RadosStripeTest: public ::testing::Test {
+protected:
+	std::string sRoot;
+	std::shared_ptr<CephNode> oNode;
+	std::shared_ptr<RadosContext> ctx;
+
+	void SetUp() override {
+		char root[] = "/tmp/rados_stripe_test.XXXXXX";
+		ASSERT_TRUE(mkdtemp(root) != NULL);
+		sRoot = root;
+		setenv("RADOS_STUB_ROOT", root, 1);
+		setenv("RADOS_STUB_DELAY_USEC", "0", 1);
+
+		oNode = std::make_shared<CephNode>("ceph0", "", "admin");
+		ASSERT_EQ(oNode->connect(), 0);
+		ctx = oNode->ctx("pool");
+		ASSERT_TRUE(ctx->ioctx() != NULL);
+	}
+
+	void TearDown() override {
+		ctx.reset();
+		oNode.reset();
+
+		nftw(sRoot.c_str(), [](const char * path, const struct stat * st, int flag, struct FTW * ftw ) {
+			return remove( path );
+		}, 8, FTW_DEPTH | FTW_PHYS);
+	}
+
+	/**
+	 * 直接读取远程清单
+	 */
+	bool ReadManifest(const std::string & dataid, RadosStripeManifest & manifest) {
+		int bytes = rados_read(ctx->ioctx(), RadosStripeLayout::ManifestOid(dataid).c_str(), (char *) &manifest,
+				sizeof(manifest), 0);
+		return manifest.Valid(bytes);
+	}
+};
+
+TEST_F(RadosStripeTest, SplitAndFill) {
+	RadosStripeLayout layout("file", TEST_STRIPE_SIZE, 0);
+
+	std::vector<RadosStripePiece> pieces;
+	layout.Split(40, 10, pieces);
+
+	ASSERT_EQ(pieces.size(), (size_t ) 4);
+	EXPECT_EQ(pieces[0].index, (uint64_t ) 0);
+	EXPECT_EQ(pieces[0].off, (uint64_t ) 10);
+	EXPECT_EQ(pieces[0].len, (size_t ) 6);
+	EXPECT_EQ(pieces[1].index, (uint64_t ) 1);
+	EXPECT_EQ(pieces[1].pos, (size_t ) 6);
+	EXPECT_EQ(pieces[3].index, (uint64_t ) 3);
+	EXPECT_EQ(pieces[3].len, (size_t ) 2);
+	EXPECT_EQ(layout.StripeOid(3), "file.0000000000000003");
+	EXPECT_EQ(layout.getStripeCount(33), (uint64_t ) 3);
+
+	/**
+	 * 文件长度 40：分片 1 缺失、分片 2 只读到 4 字节，长度以内补 0，之后不计入
+	 */
+	layout.Extend(40);
+	std::string buffer(40, 'x');
+	std::vector<int> results = { 6, -ENOENT, 4, 0 };
+	ASSERT_EQ(layout.Fill(&buffer[0], buffer.size(), 10, pieces, results), 30);
+	EXPECT_EQ(buffer.substr(6, 16), std::string(16, '\0'));
+	EXPECT_EQ(buffer.substr(22, 4), "xxxx");
+	EXPECT_EQ(buffer.substr(26, 4), std::string(4, '\0'));
+}
+
+TEST_F(RadosStripeTest, CommitMergesConcurrentExtend) {
+	std::shared_ptr<RadosStripeLayout> a = std::make_shared<RadosStripeLayout>("file", TEST_STRIPE_SIZE, 0);
+	std::shared_ptr<RadosStripeLayout> b = std::make_shared<RadosStripeLayout>("file", TEST_STRIPE_SIZE, 0);
+
+	a->Extend(100);
+	ASSERT_EQ(a->CommitSync(ctx->ioctx()), 0);
+
+	/**
+	 * b 不知道 a 的清单，独占创建失败后重新读取，取较大长度
+	 */
+	b->Extend(50);
+	ASSERT_EQ(b->CommitSync(ctx->ioctx()), 0);
+
+	RadosStripeManifest manifest;
+	ASSERT_TRUE(ReadManifest("file", manifest));
+	EXPECT_EQ(manifest.length, (uint64_t ) 100);
+	EXPECT_EQ(manifest.generation, (uint64_t ) 2);
+	EXPECT_EQ(b->GetLength(), (uint64_t ) 100);
+}
+
+TEST_F(RadosStripeTest, RemoteTruncateObserved) {
+	std::shared_ptr<RadosStripeLayout> a = std::make_shared<RadosStripeLayout>("file", TEST_STRIPE_SIZE, 0);
+	std::shared_ptr<RadosStripeLayout> b = std::make_shared<RadosStripeLayout>("file", TEST_STRIPE_SIZE, 0);
+
+	a->Extend(100);
+	ASSERT_EQ(a->CommitSync(ctx->ioctx()), 0);
+
+	RadosStripeManifest manifest;
+	ASSERT_EQ(b->Load(ctx->ioctx(), manifest), 0);
+	EXPECT_EQ(b->GetLength(), (uint64_t ) 100);
+
+	ASSERT_EQ(a->CommitSync(ctx->ioctx(), true, 10), 0);
+
+	/**
+	 * 更大代数的清单缩短长度，本地没有提交的写入仍然保留
+	 */
+	ASSERT_EQ(b->Load(ctx->ioctx(), manifest), 0);
+	EXPECT_EQ(b->GetLength(), (uint64_t ) 10);
+
+	b->Extend(30);
+	ASSERT_EQ(b->Load(ctx->ioctx(), manifest), 0);
+	EXPECT_EQ(b->GetLength(), (uint64_t ) 30);
+
+	/**
+	 * 旧的清单不能覆盖新的长度
+	 */
+	RadosStripeManifest old = manifest;
+	old.generation = 1;
+	old.length = 100;
+	ASSERT_EQ(b->Refresh(sizeof(old), old), 0);
+	EXPECT_EQ(b->GetLength(), (uint64_t ) 30);
+}
+
+TEST_F(RadosStripeTest, AsyncCommitRetriesOnConflict) {
+	std::shared_ptr<RadosStripeLayout> a = std::make_shared<RadosStripeLayout>("file", TEST_STRIPE_SIZE, 0);
+	std::shared_ptr<RadosStripeLayout> b = std::make_shared<RadosStripeLayout>("file", TEST_STRIPE_SIZE, 0);
+	std::shared_ptr<RadosAioQueue> queue = std::make_shared<RadosAioQueue>(4);
+
+	a->Extend(300);
+	ASSERT_EQ(a->CommitSync(ctx->ioctx()), 0);
+
+	std::promise<int> oPromise;
+	b->Commit(200, ctx, queue, [ &oPromise ]( int ret ) {
+		oPromise.set_value( ret );
+	});
+	ASSERT_EQ(oPromise.get_future().get(), 0);
+
+	RadosStripeManifest manifest;
+	ASSERT_TRUE(ReadManifest("file", manifest));
+	EXPECT_EQ(manifest.length, (uint64_t ) 300);
+	EXPECT_EQ(manifest.generation, (uint64_t ) 2);
+}
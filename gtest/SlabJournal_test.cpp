@@ -0,0 +1,292 @@
+/*
+ * SlabJournal_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+
+#include "w/SlabJournal.hpp"
+
+/**
+ * 重放得到的一条数据记录
+ */
+struct ReplayedRecord {
+	std::string filename;
+	off_t offset;
+	std::string data;
+};
+
+/**
+ * 每个测试使用独立的日志目录，段大小很小，记录跨多个段
+ */
+class SlabJournalTest: public ::testing::Test {
+protected:
+	std::string sRoot;
+
+	void SetUp() override {
+		char root[] = "/tmp/journal_test.XXXXXX";
+		ASSERT_TRUE(mkdtemp(root) != NULL);
+		sRoot = root;
+	}
+
+	void TearDown() override {
+		nftw(sRoot.c_str(), [](const char * path, const struct stat * st, int flag, struct FTW * ftw ) {
+			return remove( path );
+		}, 8, FTW_DEPTH | FTW_PHYS);
+	}
+
+	/**
+	 * 追加并等待日志线程回调，seq 为 0 时新预留
+	 */
+	bool Append(SlabJournal & oJournal, const std::string & filename, off_t offset, const std::string & data,
+			uint64_t seq = 0) {
+		std::shared_ptr<std::promise<bool> > oPromise = std::make_shared<std::promise<bool> >();
+		std::future<bool> oFuture = oPromise->get_future();
+		oJournal.Append(filename, seq == 0 ? oJournal.Reserve() : seq, offset, data.c_str(), data.size(),
+				[ oPromise ](bool bOk ) {
+					oPromise->set_value( bOk );
+				});
+		return oFuture.get();
+	}
+
+	bool Replay(SlabJournal & oJournal, std::vector<ReplayedRecord> & records) {
+		return oJournal.Replay([ &records ](const std::string & filename, off_t offset, const std::string & data ) {
+			records.push_back( {filename, offset, data});
+			return true;
+		});
+	}
+};
+
+TEST_F(SlabJournalTest, ReplayUnflushedInOrder) {
+	{
+		SlabJournal oJournal(sRoot, true, 256);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+		EXPECT_TRUE(records.empty());
+
+		for (int i = 0; i < 20; i++) {
+			ASSERT_TRUE(Append(oJournal, i % 2 == 0 ? "a" : "b", i * 10, "data" + std::to_string(i)));
+		}
+		EXPECT_GT(oJournal.GetNumSegments(), 1u);
+
+		/**
+		 * a 刷新到第 10 条记录为止，之后的记录仍需重放
+		 */
+		oJournal.Flushed("a", 10);
+	}
+
+	SlabJournal oJournal(sRoot, true, 256);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+
+	std::vector<int> expected;
+	for (int i = 0; i < 20; i++) {
+		if (i % 2 == 1 || i + 1 > 10) {
+			expected.push_back(i);
+		}
+	}
+
+	ASSERT_EQ(records.size(), expected.size());
+	for (size_t k = 0; k < expected.size(); k++) {
+		int i = expected[k];
+		EXPECT_EQ(records[k].filename, i % 2 == 0 ? "a" : "b");
+		EXPECT_EQ(records[k].offset, i * 10);
+		EXPECT_EQ(records[k].data, "data" + std::to_string(i));
+	}
+
+	/**
+	 * 重放成功后旧段被删除，只剩新打开的空段
+	 */
+	EXPECT_EQ(oJournal.GetNumSegments(), 1u);
+}
+
+TEST_F(SlabJournalTest, DiscardAndFlushedNotReplayed) {
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+
+		ASSERT_TRUE(Append(oJournal, "a", 0, "aaaa"));
+		ASSERT_TRUE(Append(oJournal, "b", 0, "bbbb"));
+		ASSERT_TRUE(Append(oJournal, "c", 0, "cccc"));
+
+		oJournal.Discard("a");
+		oJournal.Flushed("c", oJournal.Mark());
+	}
+
+	SlabJournal oJournal(sRoot, true, 64 * 1024);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+
+	ASSERT_EQ(records.size(), 1u);
+	EXPECT_EQ(records[0].filename, "b");
+	EXPECT_EQ(records[0].data, "bbbb");
+}
+
+TEST_F(SlabJournalTest, TornRecordIgnored) {
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+
+		ASSERT_TRUE(Append(oJournal, "a", 0, "0123"));
+		ASSERT_TRUE(Append(oJournal, "a", 4, "4567"));
+	}
+
+	/**
+	 * 模拟写入记录时崩溃：段尾只有半个记录头
+	 */
+	std::string path = sRoot + "/journal.1";
+	int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+	ASSERT_GE(fd, 0);
+	uint32_t magic = JOURNAL_MAGIC;
+	ASSERT_EQ(write(fd, &magic, sizeof(magic)), (ssize_t) sizeof(magic));
+	close(fd);
+
+	SlabJournal oJournal(sRoot, true, 64 * 1024);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+
+	ASSERT_EQ(records.size(), 2u);
+	EXPECT_EQ(records[0].data, "0123");
+	EXPECT_EQ(records[1].offset, 4);
+	EXPECT_EQ(records[1].data, "4567");
+}
+
+TEST_F(SlabJournalTest, FailedReplayKeepsJournal) {
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+
+		ASSERT_TRUE(Append(oJournal, "a", 0, "aaaa"));
+		ASSERT_TRUE(Append(oJournal, "b", 0, "bbbb"));
+	}
+
+	/**
+	 * 后端写入失败时停止重放，日志保留到下次启动
+	 */
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		size_t nCalls = 0;
+		EXPECT_FALSE(oJournal.Replay([ &nCalls ](const std::string & filename, off_t offset, const std::string & data ) {
+			nCalls++;
+			return false;
+		}));
+		EXPECT_EQ(nCalls, 1u);
+	}
+
+	SlabJournal oJournal(sRoot, true, 64 * 1024);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+	ASSERT_EQ(records.size(), 2u);
+	EXPECT_EQ(records[0].filename, "a");
+	EXPECT_EQ(records[1].filename, "b");
+}
+
+TEST_F(SlabJournalTest, ReservedSeqAppendedOutOfOrder) {
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+
+		/**
+		 * 先预留的写入后完成，刷新只释放前一条
+		 */
+		uint64_t first = oJournal.Reserve();
+		uint64_t second = oJournal.Reserve();
+		ASSERT_TRUE(Append(oJournal, "a", 4, "late", second));
+		ASSERT_TRUE(Append(oJournal, "a", 0, "early", first));
+
+		oJournal.Flushed("a", first);
+	}
+
+	SlabJournal oJournal(sRoot, true, 64 * 1024);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+
+	ASSERT_EQ(records.size(), 1u);
+	EXPECT_EQ(records[0].offset, 4);
+	EXPECT_EQ(records[0].data, "late");
+}
+
+TEST_F(SlabJournalTest, FailedSyncKeepsJournal) {
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+
+		ASSERT_TRUE(Append(oJournal, "a", 0, "aaaa"));
+	}
+
+	/**
+	 * 重放的数据没有落盘，不能删除日志段
+	 */
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		EXPECT_FALSE(oJournal.Replay([ &records ](const std::string & filename, off_t offset, const std::string & data ) {
+			records.push_back( {filename, offset, data});
+			return true;
+		}, []() {
+			return false;
+		}));
+		EXPECT_EQ(records.size(), 1u);
+	}
+
+	SlabJournal oJournal(sRoot, true, 64 * 1024);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+	ASSERT_EQ(records.size(), 1u);
+	EXPECT_EQ(records[0].data, "aaaa");
+}
+
+TEST_F(SlabJournalTest, KeptSegmentsReplayedAfterForcedStart) {
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		std::vector<ReplayedRecord> records;
+		ASSERT_TRUE(Replay(oJournal, records));
+
+		ASSERT_TRUE(Append(oJournal, "a", 0, "old"));
+		ASSERT_TRUE(Append(oJournal, "b", 0, "gone"));
+	}
+
+	/**
+	 * 重放失败仍然启动，本次运行的刷新记录不覆盖上次运行的同序号记录，丢弃覆盖之前所有运行
+	 */
+	{
+		SlabJournal oJournal(sRoot, true, 64 * 1024);
+		EXPECT_FALSE(oJournal.Replay([](const std::string & filename, off_t offset, const std::string & data ) {
+			return false;
+		}, nullptr, true));
+
+		uint64_t seq = oJournal.Reserve();
+		ASSERT_TRUE(Append(oJournal, "a", 4, "new", seq));
+		oJournal.Flushed("a", seq);
+		oJournal.Discard("b");
+		ASSERT_TRUE(Append(oJournal, "c", 0, "kept"));
+	}
+
+	SlabJournal oJournal(sRoot, true, 64 * 1024);
+	std::vector<ReplayedRecord> records;
+	ASSERT_TRUE(Replay(oJournal, records));
+
+	ASSERT_EQ(records.size(), 2u);
+	EXPECT_EQ(records[0].filename, "a");
+	EXPECT_EQ(records[0].data, "old");
+	EXPECT_EQ(records[1].filename, "c");
+	EXPECT_EQ(records[1].data, "kept");
+	EXPECT_EQ(oJournal.GetNumSegments(), 1u);
+}
@@ -0,0 +1,410 @@
+/*
+ * TierBackend_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#include <gtest/gtest.h>
+
+#include <ftw.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <fstream>
+
+#include "tier_backend.hpp"
+
+/**
+ * 内存中的文件，Flush 之前的写入在 durable 中不可见，用于模拟重启丢失未落盘的数据
+ */
+class MemStore {
+public:
+	std::mutex mtx;
+	std::map<std::string, std::string> files;
+	std::map<std::string, std::string> durable;
+	bool bLazyCreate { false }; //isValid(true) 不创建文件，第一次写入才创建（如 rados）
+	size_t nFlushes { 0 };
+};
+
+class MemBackend: public Backend {
+private:
+	std::shared_ptr<MemStore> oStore;
+	std::string filename;
+
+public:
+	MemBackend(const std::shared_ptr<MemStore> & oStore_, const std::string & filename_) :
+			oStore(oStore_), filename(filename_) {
+	}
+
+	int Read(void * buffer, size_t size, off_t offset) {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		auto iter = oStore->files.find(filename);
+		if (iter == oStore->files.end()) {
+			code = ENOENT;
+			return -1;
+		}
+
+		code = 0;
+		if ((size_t) offset >= iter->second.size()) {
+			return 0;
+		}
+		size_t bytes = std::min<size_t>(size, iter->second.size() - offset);
+		memcpy(buffer, iter->second.data() + offset, bytes);
+		return bytes;
+	}
+
+	int Write(void * buffer, size_t size, off_t offset) {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		std::string & data = oStore->files[filename];
+		if (data.size() < offset + size) {
+			data.resize(offset + size, '\0');
+		}
+		data.replace(offset, size, (const char *) buffer, size);
+		code = 0;
+		return size;
+	}
+
+	bool Flush() {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		oStore->durable[filename] = oStore->files[filename];
+		oStore->nFlushes++;
+		code = 0;
+		return true;
+	}
+
+	bool isValid(bool create_if_not_exists) {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		if (oStore->files.count(filename) > 0) {
+			code = 0;
+			return true;
+		}
+
+		if (create_if_not_exists == false) {
+			code = ENOENT;
+			return false;
+		}
+
+		if (oStore->bLazyCreate == false) {
+			oStore->files[filename];
+		}
+		code = 0;
+		return true;
+	}
+
+	bool GetAttr(const std::string & filename_, struct stat * st) {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		auto iter = oStore->files.find(filename_);
+		if (iter == oStore->files.end()) {
+			code = ENOENT;
+			return false;
+		}
+
+		memset(st, 0, sizeof(struct stat));
+		st->st_mode = S_IFREG | S_IRUSR | S_IWUSR;
+		st->st_size = iter->second.size();
+		code = 0;
+		return true;
+	}
+
+	bool Truncate(const std::string & filename_, off_t length) {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		auto iter = oStore->files.find(filename_);
+		if (iter == oStore->files.end()) {
+			code = ENOENT;
+			return false;
+		}
+		iter->second.resize(length, '\0');
+		code = 0;
+		return true;
+	}
+
+	bool Unlink(const std::string & filename_) {
+		std::lock_guard<std::mutex> lock(oStore->mtx);
+		if (oStore->files.erase(filename_) == 0) {
+			code = ENOENT;
+			return false;
+		}
+		oStore->durable.erase(filename_);
+		code = 0;
+		return true;
+	}
+
+	bool MkDir(const std::string & filename_) {
+		return true;
+	}
+
+	bool RmDir(const std::string & filename_) {
+		return true;
+	}
+};
+
+class MemBackendFactory: public BackendFactory {
+public:
+	std::shared_ptr<MemStore> oStore { std::make_shared<MemStore>() };
+
+	std::shared_ptr<Backend> Open(const std::string & filename) {
+		return std::make_shared<MemBackend>(oStore, filename);
+	}
+};
+
+/**
+ * 每个测试使用独立的状态目录，片为 4KB，write-back，上传只在 Stop 时进行
+ */
+class TierBackendTest: public ::testing::Test {
+protected:
+	std::string sRoot;
+	std::string sConf;
+	std::shared_ptr<MemBackendFactory> oUpper;
+	std::shared_ptr<MemBackendFactory> oLower;
+
+	void SetUp() override {
+		char root[] = "/tmp/tier_test.XXXXXX";
+		ASSERT_TRUE(mkdtemp(root) != NULL);
+		sRoot = root;
+
+		/**
+		 * 不调用 Start 的测试也能写状态文件
+		 */
+		ASSERT_EQ(mkdir((sRoot + "/state").c_str(), S_IRWXU), 0);
+
+		sConf = sRoot + "/tier.conf";
+		std::ofstream out(sConf.c_str());
+		out << "prefix = tier" << std::endl;
+		out << "state_dir = " << sRoot << "/state" << std::endl;
+		out << "chunk_kb = 4" << std::endl;
+		out << "write_mode = write-back" << std::endl;
+		out << "upload_delay = 3600" << std::endl;
+		out.close();
+
+		oUpper = std::make_shared<MemBackendFactory>();
+		oLower = std::make_shared<MemBackendFactory>();
+	}
+
+	void TearDown() override {
+		nftw(sRoot.c_str(), [](const char * path, const struct stat * st, int flag, struct FTW * ftw ) {
+			return remove( path );
+		}, 8, FTW_DEPTH | FTW_PHYS);
+	}
+
+	std::shared_ptr<TierStore> NewStore() {
+		ConfReader cr;
+		cr.load(sConf);
+		return std::make_shared<TierStore>(cr, oUpper, oLower);
+	}
+
+	/**
+	 * 状态文件中一片的状态，-1 为读取失败
+	 */
+	int MapChunk(const std::string & name, uint64_t index) {
+		int fd = open((sRoot + "/state/" + name + ".map").c_str(), O_RDONLY);
+		if (fd < 0) {
+			return -1;
+		}
+		uint8_t state = 0;
+		ssize_t bytes = pread(fd, &state, 1, sizeof(TierMapHeader) + index);
+		close(fd);
+		return bytes == 1 ? state : -1;
+	}
+};
+
+TEST_F(TierBackendTest, ReadFillsUpperFromLower) {
+	oLower->oStore->files["a.dat"] = std::string(6000, 'x');
+
+	std::shared_ptr<TierStore> oStore = NewStore();
+	oStore->Start();
+
+	TierBackend backend(oStore, "a.dat");
+	ASSERT_TRUE(backend.isValid(false));
+
+	char buffer[6000];
+	ASSERT_EQ(backend.Read(buffer, sizeof(buffer), 0), 6000);
+	EXPECT_EQ(std::string(buffer, 6000), std::string(6000, 'x'));
+	EXPECT_EQ(oStore->nFills, 1u);
+	EXPECT_EQ(oUpper->oStore->files["a.dat"], std::string(6000, 'x'));
+
+	/**
+	 * 第二次读取全部来自上层
+	 */
+	ASSERT_EQ(backend.Read(buffer, sizeof(buffer), 0), 6000);
+	EXPECT_EQ(oStore->nFills, 1u);
+	EXPECT_EQ(oStore->nHitBytes, 6000u);
+
+	oStore->Stop();
+}
+
+TEST_F(TierBackendTest, NewFileMissingInLower) {
+	oLower->oStore->bLazyCreate = true;
+
+	std::shared_ptr<TierStore> oStore = NewStore();
+	oStore->Start();
+
+	TierBackend missing(oStore, "missing.dat");
+	EXPECT_FALSE(missing.isValid(false));
+	EXPECT_EQ(missing.code, ENOENT);
+
+	TierBackend backend(oStore, "new.dat");
+	ASSERT_TRUE(backend.isValid(true));
+
+	std::string data(5000, 'n');
+	ASSERT_EQ(backend.Write((void *) data.data(), data.size(), 0), 5000);
+
+	/**
+	 * 只在上层的文件，长度以状态为准
+	 */
+	struct stat st;
+	ASSERT_TRUE(backend.GetAttr("new.dat", &st));
+	EXPECT_EQ(st.st_size, 5000);
+	EXPECT_EQ(oLower->oStore->files.count("new.dat"), 0u);
+
+	oStore->Stop();
+	EXPECT_EQ(oLower->oStore->files["new.dat"], data);
+}
+
+TEST_F(TierBackendTest, WriteBackDurableBeforeReturn) {
+	std::shared_ptr<TierStore> oStore = NewStore();
+
+	TierBackend backend(oStore, "w.dat");
+	ASSERT_TRUE(backend.isValid(true));
+
+	std::string data(4096, 'w');
+	ASSERT_EQ(backend.Write((void *) data.data(), data.size(), 0), 4096);
+
+	EXPECT_GE(oUpper->oStore->nFlushes, 1u);
+	EXPECT_EQ(oUpper->oStore->durable["w.dat"], data);
+	EXPECT_EQ(MapChunk("w.dat", 0), TierChunk::tcDirty);
+}
+
+TEST_F(TierBackendTest, RecoverUploadsUpperOnlyFile) {
+	oLower->oStore->bLazyCreate = true;
+	std::string data(8192, 'r');
+
+	/**
+	 * 写入后不停止，模拟上传前重启
+	 */
+	{
+		std::shared_ptr<TierStore> oStore = NewStore();
+		TierBackend backend(oStore, "dir/r.dat");
+		ASSERT_TRUE(backend.isValid(true));
+		ASSERT_EQ(backend.Write((void *) data.data(), data.size(), 0), 8192);
+	}
+	EXPECT_EQ(oLower->oStore->files.count("dir/r.dat"), 0u);
+
+	std::shared_ptr<TierStore> oStore = NewStore();
+	oStore->Start();
+
+	size_t dirty_files = 0;
+	size_t open_files = 0;
+	oStore->GetDepth(dirty_files, open_files);
+	EXPECT_EQ(dirty_files, 1u);
+
+	oStore->Stop();
+	EXPECT_EQ(oLower->oStore->files["dir/r.dat"], data);
+	EXPECT_EQ(MapChunk("dir%2Fr.dat", 0), TierChunk::tcClean);
+	EXPECT_EQ(MapChunk("dir%2Fr.dat", 1), TierChunk::tcClean);
+}
+
+TEST_F(TierBackendTest, UnlinkBeforeFirstUpload) {
+	oLower->oStore->bLazyCreate = true;
+
+	std::shared_ptr<TierStore> oStore = NewStore();
+	oStore->Start();
+
+	TierBackend backend(oStore, "u.dat");
+	ASSERT_TRUE(backend.isValid(true));
+
+	std::string data(5000, 'u');
+	ASSERT_EQ(backend.Write((void *) data.data(), data.size(), 0), 5000);
+
+	/**
+	 * 下层还不存在，删除仍然成功，上层文件和状态一起删除
+	 */
+	ASSERT_TRUE(backend.Unlink("u.dat"));
+	EXPECT_EQ(oUpper->oStore->files.count("u.dat"), 0u);
+	EXPECT_EQ(MapChunk("u.dat", 0), -1);
+
+	size_t dirty_files = 0;
+	size_t open_files = 0;
+	oStore->GetDepth(dirty_files, open_files);
+	EXPECT_EQ(dirty_files, 0u);
+
+	oStore->Stop();
+	EXPECT_EQ(oLower->oStore->files.count("u.dat"), 0u);
+}
+
+TEST_F(TierBackendTest, TruncateBeforeFirstUpload) {
+	oLower->oStore->bLazyCreate = true;
+
+	std::shared_ptr<TierStore> oStore = NewStore();
+	oStore->Start();
+
+	TierBackend backend(oStore, "t.dat");
+	ASSERT_TRUE(backend.isValid(true));
+
+	std::string data(8192, 't');
+	ASSERT_EQ(backend.Write((void *) data.data(), data.size(), 0), 8192);
+
+	/**
+	 * 下层还不存在，只截取上层和状态，之后的片不再上传
+	 */
+	ASSERT_TRUE(backend.Truncate("t.dat", 100));
+
+	struct stat st;
+	ASSERT_TRUE(backend.GetAttr("t.dat", &st));
+	EXPECT_EQ(st.st_size, 100);
+	EXPECT_EQ(MapChunk("t.dat", 0), TierChunk::tcDirty);
+	EXPECT_EQ(MapChunk("t.dat", 1), -1);
+
+	oStore->Stop();
+	EXPECT_EQ(oLower->oStore->files["t.dat"], data.substr(0, 100));
+}
+
+TEST_F(TierBackendTest, RecoverLongName) {
+	oLower->oStore->bLazyCreate = true;
+	std::string name = std::string(200, 'd') + "/" + std::string(200, 'f') + ".dat";
+	std::string data(4096, 'l');
+
+	/**
+	 * 转义后超过 NAME_MAX，写入后不停止，模拟上传前重启
+	 */
+	{
+		std::shared_ptr<TierStore> oStore = NewStore();
+		TierBackend backend(oStore, name);
+		ASSERT_TRUE(backend.isValid(true));
+		ASSERT_EQ(backend.Write((void *) data.data(), data.size(), 0), 4096);
+	}
+
+	size_t nNames = 0;
+	DIR * dir = opendir((sRoot + "/state").c_str());
+	ASSERT_TRUE(dir != NULL);
+	struct dirent * entry;
+	while ((entry = readdir(dir)) != NULL) {
+		std::string filename = entry->d_name;
+		EXPECT_LE(filename.size(), (size_t) NAME_MAX);
+		if (filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".name") == 0) {
+			nNames++;
+		}
+	}
+	closedir(dir);
+	EXPECT_EQ(nNames, 1u);
+
+	std::shared_ptr<TierStore> oStore = NewStore();
+	oStore->Start();
+
+	size_t dirty_files = 0;
+	size_t open_files = 0;
+	oStore->GetDepth(dirty_files, open_files);
+	EXPECT_EQ(dirty_files, 1u);
+
+	oStore->Stop();
+	EXPECT_EQ(oLower->oStore->files[name], data);
+}
@@ -0,0 +1,369 @@
+/*
+ * rados_stub.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: root
+ */
+
+#ifndef RADOS_STUB_HPP_
+#define RADOS_STUB_HPP_
+
+/**
+ * librados 的本地替身，只用于测试，测试程序定义 RADOS_STUB 后 rados_cc.hpp 使用该文件
+ *
+ * 只实现 rados 后端用到的接口，对象保存为本地文件 <root>/<pool>/<oid>，oid 中的 / 替换为 %2F，
+ * root 为环境变量 RADOS_STUB_ROOT，默认 /tmp/rados_stub；
+ * 异步读写在独立线程中执行后回调，可以同时有多个请求在途，RADOS_STUB_DELAY_USEC 可以模拟网络延迟
+ * xattr 保存为 <对象文件>.xattr.<name>，写入操作（rados_write_op_t）在全局锁内整体执行
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+struct rados_stub_cluster {
+	std::string root;
+	uint32_t delay_usec { 0 };
+};
+
+struct rados_stub_ioctx {
+	std::string path;
+	uint32_t delay_usec { 0 };
+
+	std::mutex mtx;
+	std::condition_variable cond;
+	int pending { 0 }; //在途的异步请求数，mtx 保护
+};
+
+typedef void (*rados_callback_t)(struct rados_stub_completion * comp, void * arg);
+
+struct rados_stub_completion {
+	void * arg { NULL };
+	rados_callback_t complete { NULL };
+	int ret { 0 };
+};
+
+typedef rados_stub_cluster * rados_t;
+typedef rados_stub_ioctx * rados_ioctx_t;
+typedef rados_stub_completion * rados_completion_t;
+
+inline std::string rados_stub_path(rados_ioctx_t io, const char * oid) {
+	std::string name;
+	for (const char * p = oid; *p != '\0'; p++) {
+		if (*p == '/') {
+			name.append("%2F");
+		} else {
+			name.push_back(*p);
+		}
+	}
+	return io->path + "/" + name;
+}
+
+inline int rados_create(rados_t * cluster, const char * id) {
+	*cluster = new rados_stub_cluster();
+
+	const char * root = getenv("RADOS_STUB_ROOT");
+	(*cluster)->root = root == NULL ? "/tmp/rados_stub" : root;
+
+	const char * delay = getenv("RADOS_STUB_DELAY_USEC");
+	(*cluster)->delay_usec = delay == NULL ? 0 : atoi(delay);
+	return 0;
+}
+
+inline int rados_conf_read_file(rados_t cluster, const char * path) {
+	return 0;
+}
+
+inline int rados_connect(rados_t cluster) {
+	if (mkdir(cluster->root.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+		return -errno;
+	}
+	return 0;
+}
+
+inline void rados_shutdown(rados_t cluster) {
+	delete cluster;
+}
+
+inline int rados_ioctx_create(rados_t cluster, const char * pool_name, rados_ioctx_t * io) {
+	std::string path = cluster->root + "/" + pool_name;
+	if (mkdir(path.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+		*io = NULL;
+		return -errno;
+	}
+
+	*io = new rados_stub_ioctx();
+	(*io)->path = path;
+	(*io)->delay_usec = cluster->delay_usec;
+	return 0;
+}
+
+inline int rados_aio_flush(rados_ioctx_t io) {
+	std::unique_lock<std::mutex> lock(io->mtx);
+	io->cond.wait(lock, [ io ]() {
+		return io->pending == 0;
+	});
+	return 0;
+}
+
+inline void rados_ioctx_destroy(rados_ioctx_t io) {
+	rados_aio_flush(io);
+	delete io;
+}
+
+inline int rados_read(rados_ioctx_t io, const char * oid, char * buf, size_t len, uint64_t off) {
+	int fd = open(rados_stub_path(io, oid).c_str(), O_RDONLY);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	ssize_t bytes = pread(fd, buf, len, off);
+	int err = errno;
+	close(fd);
+	return bytes < 0 ? -err : (int) bytes;
+}
+
+/**
+ * 与 librados 相同，成功返回 0
+ */
+inline int rados_write(rados_ioctx_t io, const char * oid, const char * buf, size_t len, uint64_t off) {
+	int fd = open(rados_stub_path(io, oid).c_str(), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	ssize_t bytes = pwrite(fd, buf, len, off);
+	int err = errno;
+	close(fd);
+	return bytes < 0 ? -err : 0;
+}
+
+inline int rados_trunc(rados_ioctx_t io, const char * oid, uint64_t size) {
+	std::string path = rados_stub_path(io, oid);
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	int state = ftruncate(fd, size);
+	int err = errno;
+	close(fd);
+	return state < 0 ? -err : 0;
+}
+
+inline int rados_remove(rados_ioctx_t io, const char * oid) {
+	std::string path = rados_stub_path(io, oid);
+	if (unlink(path.c_str()) != 0) {
+		return -errno;
+	}
+
+	std::string prefix = path.substr(io->path.size() + 1) + ".xattr.";
+	DIR * dir = opendir(io->path.c_str());
+	if (dir != NULL) {
+		struct dirent * entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0) {
+				unlink((io->path + "/" + entry->d_name).c_str());
+			}
+		}
+		closedir(dir);
+	}
+	return 0;
+}
+
+inline int rados_stat(rados_ioctx_t io, const char * o, uint64_t * psize, time_t * pmtime) {
+	struct stat st;
+	if (stat(rados_stub_path(io, o).c_str(), &st) != 0) {
+		return -errno;
+	}
+	*psize = st.st_size;
+	*pmtime = st.st_mtime;
+	return 0;
+}
+
+inline int rados_aio_create_completion(void * cb_arg, rados_callback_t cb_complete, rados_callback_t cb_safe,
+		rados_completion_t * pc) {
+	*pc = new rados_stub_completion();
+	(*pc)->arg = cb_arg;
+	(*pc)->complete = cb_complete;
+	return 0;
+}
+
+inline int rados_aio_get_return_value(rados_completion_t c) {
+	return c->ret;
+}
+
+inline void rados_aio_release(rados_completion_t c) {
+	delete c;
+}
+
+/**
+ * 在独立线程中执行 op 后回调 completion，模拟 librados 的回调线程
+ */
+inline void rados_stub_aio(rados_ioctx_t io, rados_completion_t c, const std::function<int(void)> & op) {
+	{
+		std::lock_guard<std::mutex> lock(io->mtx);
+		io->pending++;
+	}
+
+	std::thread([ io, c, op ]() {
+		if (io->delay_usec > 0) {
+			usleep(io->delay_usec);
+		}
+
+		c->ret = op();
+
+		/**
+		 * 回调前结束在途计数，回调中可能释放 ioctx
+		 */
+		{
+			std::lock_guard<std::mutex> lock(io->mtx);
+			if (--io->pending == 0) {
+				io->cond.notify_all();
+			}
+		}
+
+		if (c->complete != NULL) {
+			c->complete(c, c->arg);
+		}
+	}).detach();
+}
+
+inline int rados_aio_read(rados_ioctx_t io, const char * oid, rados_completion_t c, char * buf, size_t len,
+		uint64_t off) {
+	std::string name = oid;
+	rados_stub_aio(io, c, [ io, name, buf, len, off ]() {
+		return rados_read( io, name.c_str(), buf, len, off );
+	});
+	return 0;
+}
+
+inline int rados_aio_write(rados_ioctx_t io, const char * oid, rados_completion_t c, const char * buf, size_t len,
+		uint64_t off) {
+	std::string name = oid;
+	rados_stub_aio(io, c, [ io, name, buf, len, off ]() {
+		return rados_write( io, name.c_str(), buf, len, off );
+	});
+	return 0;
+}
+
+#define LIBRADOS_CREATE_EXCLUSIVE 1
+#define LIBRADOS_CMPXATTR_OP_EQ 1
+
+/**
+ * 只支持 rados 后端用到的步骤：独占创建、xattr 相等比较、设置 xattr、整体写入
+ */
+struct rados_stub_write_op {
+	bool exclusive { false };
+	std::vector<std::pair<std::string, std::string> > cmpxattrs;
+	std::vector<std::pair<std::string, std::string> > setxattrs;
+	bool write_full { false };
+	std::string data;
+};
+
+typedef rados_stub_write_op * rados_write_op_t;
+
+inline std::mutex & rados_stub_op_mutex() {
+	static std::mutex mtx;
+	return mtx;
+}
+
+inline rados_write_op_t rados_create_write_op() {
+	return new rados_stub_write_op();
+}
+
+inline void rados_release_write_op(rados_write_op_t op) {
+	delete op;
+}
+
+inline void rados_write_op_create(rados_write_op_t op, int exclusive, const char * category) {
+	op->exclusive = exclusive == LIBRADOS_CREATE_EXCLUSIVE;
+}
+
+inline void rados_write_op_cmpxattr(rados_write_op_t op, const char * name, uint8_t comparison_operator,
+		const char * value, size_t value_len) {
+	op->cmpxattrs.push_back(std::make_pair(std::string(name), std::string(value, value_len)));
+}
+
+inline void rados_write_op_setxattr(rados_write_op_t op, const char * name, const char * value, size_t value_len) {
+	op->setxattrs.push_back(std::make_pair(std::string(name), std::string(value, value_len)));
+}
+
+inline void rados_write_op_write_full(rados_write_op_t op, const char * buffer, size_t len) {
+	op->write_full = true;
+	op->data.assign(buffer, len);
+}
+
+inline int rados_stub_put(const std::string & path, const std::string & data) {
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	ssize_t bytes = write(fd, data.c_str(), data.size());
+	int err = errno;
+	close(fd);
+	return bytes < 0 ? -err : 0;
+}
+
+/**
+ * 与 librados 相同：对象已存在时独占创建返回 -EEXIST，xattr 不存在返回 -ENODATA，不相等返回 -ECANCELED
+ */
+inline int rados_write_op_operate(rados_write_op_t op, rados_ioctx_t io, const char * oid, time_t * mtime, int flags) {
+	std::lock_guard<std::mutex> lock(rados_stub_op_mutex());
+
+	std::string path = rados_stub_path(io, oid);
+	struct stat st;
+	if (op->exclusive == true && stat(path.c_str(), &st) == 0) {
+		return -EEXIST;
+	}
+
+	for (const auto & cmp : op->cmpxattrs) {
+		std::string value(cmp.second.size() + 1, '\0');
+		int fd = open((path + ".xattr." + cmp.first).c_str(), O_RDONLY);
+		if (fd < 0) {
+			return -ENODATA;
+		}
+		ssize_t bytes = read(fd, &value[0], value.size());
+		close(fd);
+		if (bytes != (ssize_t) cmp.second.size() || value.compare(0, bytes, cmp.second) != 0) {
+			return -ECANCELED;
+		}
+	}
+
+	for (const auto & attr : op->setxattrs) {
+		int state = rados_stub_put(path + ".xattr." + attr.first, attr.second);
+		if (state < 0) {
+			return state;
+		}
+	}
+
+	if (op->write_full == true) {
+		return rados_stub_put(path, op->data);
+	}
+	return 0;
+}
+
+inline int rados_aio_write_op_operate(rados_write_op_t op, rados_ioctx_t io, rados_completion_t c, const char * oid,
+		time_t * mtime, int flags) {
+	std::string name = oid;
+	rados_stub_aio(io, c, [ op, io, name ]() {
+		return rados_write_op_operate( op, io, name.c_str(), NULL, 0 );
+	});
+	return 0;
+}
+
+#endif /* RADOS_STUB_HPP_ */